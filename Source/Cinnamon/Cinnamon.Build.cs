@@ -9,6 +9,9 @@ public class Cinnamon : ModuleRules
 	{
 		PCHUsage = ModuleRules.PCHUsageMode.UseExplicitOrSharedPCHs;
 
+		// 64 bit node links, needed by volumes with more than 4M nodes in a layer
+		PublicDefinitions.Add("CINNAMON_WIDE_NODE_LINKS=0");
+
 		PublicIncludePaths.AddRange(
 			new string[] {
 				Path.Combine(ModuleDirectory, "Public"),
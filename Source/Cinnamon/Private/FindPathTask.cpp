@@ -3,7 +3,11 @@
 
 #include "FindPathTask.h"
 #include "TDPAStar.h"
+#include "TDPLazyThetaStar.h"
+#include "TDPHierarchicalAStar.h"
+#include "TDPTiledAStar.h"
 #include "TDPVolume.h"
+#include "Algo/Sort.h"
 
 
 FindPathTask::FindPathTask(UWorld* world, const ATDPVolume& volume, const FTDPPathFinderSettings& settings, ETDPPathFinder pathFinder, ETDPHeuristic heuristic,
@@ -15,14 +19,59 @@ FindPathTask::FindPathTask(UWorld* world, const ATDPVolume& volume, const FTDPPa
 {
 }
 
+FindPathTask::FindPathTask(UWorld* world, const TArray<const ATDPVolume*>& tiles, const FTDPPathFinderSettings& settings, ETDPHeuristic heuristic,
+	const TDPTileLink& startLink, const TDPTileLink& endLink, const FVector& startPosition, const FVector& endPosition,
+	TDPNavigationPath& path, FThreadSafeBool& complete) :
+	mWorld(world), mVolume(startLink.Volume), mSettings(&settings), mPathFinder(ETDPPathFinder::AStar), mHeuristic(heuristic),
+	mStartLink(startLink.Link), mEndLink(endLink.Link), mStartPosition(startPosition), mEndPosition(endPosition),
+	mPath(path), mComplete(complete), mTiles(tiles), mStartTileLink(startLink), mEndTileLink(endLink)
+{
+	// streaming a tile out waits until every query that gathered it is done
+	for (const ATDPVolume* tile : mTiles)
+	{
+		tile->AddTileQuery();
+	}
+}
+
 void FindPathTask::DoWork()
 {
+	if (mTiles.Num() > 0)
+	{
+		// portals are rebuilt under the octree lock of their tile, tiles are always locked in the same order
+		TArray<const ATDPVolume*> lockedTiles = mTiles;
+		Algo::Sort(lockedTiles);
+
+		for (const ATDPVolume* tile : lockedTiles)
+		{
+			tile->GetOctreeLock().ReadLock();
+		}
+
+		TDPTiledAStar pathFinder(*mVolume, mHeuristic, *mSettings);
+		pathFinder.FindPath(mTiles, mStartTileLink, mEndTileLink, mStartPosition, mEndPosition, mPath);
+		mPath.SetIsReady(true);
+
+		for (const ATDPVolume* tile : lockedTiles)
+		{
+			tile->GetOctreeLock().ReadUnlock();
+		}
+
+		ReleaseTiles();
+		mComplete = true;
+		return;
+	}
+
 	TSharedPtr<IPathFinder> pathFinder = nullptr;
 
 	switch (mPathFinder)
 	{
 	case ETDPPathFinder::AStar:
-		pathFinder = MakeShared<TDPAStar>(*mVolume, *PathHelper::Heuristics.Find(mHeuristic), *mSettings);
+		pathFinder = MakeShared<TDPAStar>(*mVolume, mHeuristic, *mSettings);
+		break;
+	case ETDPPathFinder::LazyThetaStar:
+		pathFinder = MakeShared<TDPLazyThetaStar>(*mVolume, mHeuristic, *mSettings);
+		break;
+	case ETDPPathFinder::HierarchicalAStar:
+		pathFinder = MakeShared<TDPHierarchicalAStar>(*mVolume, mHeuristic, *mSettings);
 		break;
 	default:
 		break;
@@ -30,6 +79,8 @@ void FindPathTask::DoWork()
 
 	if (pathFinder)
 	{
+		// the octree can be swapped by a background generation or changed by a dynamic update
+		FRWScopeLock lock(mVolume->GetOctreeLock(), SLT_ReadOnly);
 		pathFinder->FindPath(mStartLink, mEndLink, mStartPosition, mEndPosition, mPath);
 		mPath.SetIsReady(true);
 	}
@@ -42,7 +93,18 @@ bool FindPathTask::CanAbandon() const
 	return true;
 }
 
+void FindPathTask::ReleaseTiles()
+{
+	for (const ATDPVolume* tile : mTiles)
+	{
+		tile->RemoveTileQuery();
+	}
+
+	mTiles.Reset();
+}
+
 void FindPathTask::Abandon()
 {
+	ReleaseTiles();
 	mPath.Reset();
 }
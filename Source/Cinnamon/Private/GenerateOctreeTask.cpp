@@ -0,0 +1,29 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GenerateOctreeTask.h"
+#include "TDPVolume.h"
+
+
+GenerateOctreeTask::GenerateOctreeTask(ATDPVolume& volume, TDPTree& octree) :
+	mVolume(&volume), mOctree(octree)
+{
+}
+
+void GenerateOctreeTask::DoWork()
+{
+	if (!mVolume->RasterizeOctree(mOctree))
+	{
+		mOctree.Clear();
+	}
+}
+
+bool GenerateOctreeTask::CanAbandon() const
+{
+	return true;
+}
+
+void GenerateOctreeTask::Abandon()
+{
+	mOctree.Clear();
+}
@@ -9,40 +9,97 @@ IPathFinder::IPathFinder(const ATDPVolume& volume, const PathHelper::Heuristic&
 }
 
 void IPathFinder::BuildPath(const TMap<TDPNodeLink, TDPNodeLink>& trail, TDPNodeLink currentLink, const FVector& startPosition, const FVector& endPosition, TDPNavigationPath& path) const
+{
+	TArray<TDPTileLink> links;
+	links.Emplace(mVolume, currentLink);
+
+	while (const TDPNodeLink* link = trail.Find(currentLink))
+	{
+		links.Emplace(mVolume, *link);
+		currentLink = *link;
+	}
+
+	BuildPath(links, path);
+}
+
+void IPathFinder::BuildPath(const TDPSearchState& state, int32 slot, const FVector& startPosition, const FVector& endPosition, TDPNavigationPath& path) const
+{
+	BuildPath(state, slot, MakeArrayView(&mVolume, 1), startPosition, endPosition, path);
+}
+
+void IPathFinder::BuildPath(const TDPSearchState& state, int32 slot, TArrayView<const ATDPVolume* const> tiles, const FVector& startPosition, const FVector& endPosition, TDPNavigationPath& path) const
+{
+	TArray<TDPTileLink> links;
+
+	for (; slot != TDPSearchState::InvalidSlot; slot = state[slot].Parent)
+	{
+		links.Emplace(tiles[state[slot].Tile], state[slot].Link);
+	}
+
+	BuildPath(links, path);
+}
+
+TArrayView<const TDPNodeLink> IPathFinder::GetNeighbors(const TDPNodeLink& link, TArray<TDPNodeLink>& scratch) const
+{
+	return GetNeighbors(*mVolume, link, scratch);
+}
+
+TArrayView<const TDPNodeLink> IPathFinder::GetNeighbors(const ATDPVolume& volume, const TDPNodeLink& link, TArray<TDPNodeLink>& scratch)
+{
+	const TDPGraph& graph = volume.GetGraph();
+	if (graph.IsBuilt())
+	{
+		return graph.GetNeighbors(link);
+	}
+
+	scratch.Reset();
+
+	if (link.LayerIndex == 0 && volume.GetNodeFromLink(link).HasChildren())
+	{
+		volume.GetLeafNeighborsFromLink(link, scratch);
+	}
+	else
+	{
+		volume.GetNodeNeighborsFromLink(link, scratch);
+	}
+
+	return scratch;
+}
+
+void IPathFinder::BuildPath(const TArray<TDPTileLink>& links, TDPNavigationPath& path) const
 {
 	// build path from end to start
 	TArray<TDPPathPoint> points;
 
 	FVector position;
-	mVolume->GetNodePositionFromLink(currentLink, position);
-	points.Emplace(position, static_cast<LayerIndexType>(currentLink.LayerIndex), false);
+	links[0].Volume->GetNodePositionFromLink(links[0].Link, position);
+	points.Emplace(position, static_cast<LayerIndexType>(links[0].Link.LayerIndex), false);
 
-	while (const TDPNodeLink* link = trail.Find(currentLink))
+	for (int32 i = 1; i < links.Num(); ++i)
 	{
-		mVolume->GetNodePositionFromLink(*link, position);
+		const TDPNodeLink& link = links[i].Link;
+		links[i].Volume->GetNodePositionFromLink(link, position);
 
-		if (link->LayerIndex == 0)
+		if (link.LayerIndex == 0)
 		{
-			const auto& node = mVolume->GetNodeFromLink(*link);
-			if (!node->HasChildren())
+			const auto node = links[i].Volume->GetNodeFromLink(link);
+			if (!node.HasChildren())
 			{
-				points.Emplace(position, static_cast<LayerIndexType>(link->LayerIndex), false);
+				points.Emplace(position, static_cast<LayerIndexType>(link.LayerIndex), false);
 			}
 			else
 			{
-				points.Emplace(position, static_cast<LayerIndexType>(link->LayerIndex), true);
+				points.Emplace(position, static_cast<LayerIndexType>(link.LayerIndex), true);
 			}
 		}
 		else
 		{
-			points.Emplace(position, static_cast<LayerIndexType>(link->LayerIndex), false);
+			points.Emplace(position, static_cast<LayerIndexType>(link.LayerIndex), false);
 		}
-
-		currentLink = *link;
 	}
 
 	// redundant but clearer
-	//points.Emplace(startPosition, static_cast<LayerIndexType>(currentLink.LayerIndex), false);
+	//points.Emplace(startPosition, static_cast<LayerIndexType>(links.Last().LayerIndex), false);
 
 	// build real path from start to end
 	auto& outPoints = path.GetPath();
@@ -6,24 +6,35 @@
 
 const PathHelper::Heuristic PathHelper::ManhattanDistance = [](const TDPNodeLink& start, const TDPNodeLink& end, const ATDPVolume& volume) -> float
 {
-	FVector startPosition, endPosition;
-	volume.GetNodePositionFromLink(start, startPosition);
-	volume.GetNodePositionFromLink(end, endPosition);
-
-	return FMath::Abs(endPosition.X - startPosition.X) + FMath::Abs(endPosition.Y - startPosition.Y) + FMath::Abs(endPosition.Z - startPosition.Z);
+	return FManhattanDistance()(volume.GetLinkPosition(start), volume.GetLinkPosition(end));
 };
 
 const PathHelper::Heuristic PathHelper::EuclideanDistance = [](const TDPNodeLink& start, const TDPNodeLink& end, const ATDPVolume& volume) -> float
 {
-	FVector startPosition, endPosition;
-	volume.GetNodePositionFromLink(start, startPosition);
-	volume.GetNodePositionFromLink(end, endPosition);
+	return FEuclideanDistance()(volume.GetLinkPosition(start), volume.GetLinkPosition(end));
+};
 
-	return (endPosition - startPosition).Size();
+const PathHelper::Heuristic PathHelper::OctileDistance = [](const TDPNodeLink& start, const TDPNodeLink& end, const ATDPVolume& volume) -> float
+{
+	return FOctileDistance()(volume.GetLinkPosition(start), volume.GetLinkPosition(end));
 };
 
 const TMap<ETDPHeuristic, PathHelper::Heuristic> PathHelper::Heuristics = 
 {
 	{ ETDPHeuristic::ManhattanDistance, PathHelper::ManhattanDistance },
-	{ ETDPHeuristic::EuclideanDistance, PathHelper::EuclideanDistance }
+	{ ETDPHeuristic::EuclideanDistance, PathHelper::EuclideanDistance },
+	{ ETDPHeuristic::OctileDistance, PathHelper::OctileDistance }
 };
+
+float PathHelper::GetDistance(ETDPHeuristic heuristic, const FVector& start, const FVector& end)
+{
+	switch (heuristic)
+	{
+	case ETDPHeuristic::EuclideanDistance:
+		return FEuclideanDistance()(start, end);
+	case ETDPHeuristic::OctileDistance:
+		return FOctileDistance()(start, end);
+	default:
+		return FManhattanDistance()(start, end);
+	}
+}
@@ -2,138 +2,187 @@
 
 
 #include "TDPAStar.h"
+#include "TDPSearchState.h"
 #include <functional>
 
+TDPAStar::TDPAStar(const ATDPVolume& volume, ETDPHeuristic heuristic, const FTDPPathFinderSettings& settings) :
+	IPathFinder(volume, *PathHelper::Heuristics.Find(heuristic), settings), mHeuristicType(heuristic), mCustomHeuristic(false)
+{
+}
+
 TDPAStar::TDPAStar(const ATDPVolume& volume, const PathHelper::Heuristic& heuristic, const FTDPPathFinderSettings& settings) : IPathFinder(volume, heuristic, settings)
 {
 }
 
 void TDPAStar::FindPath(const TDPNodeLink startLink, const TDPNodeLink endLink, const FVector& startPosition, const FVector& endPosition, TDPNavigationPath& path) const
 {
-	TSet<TDPNodeLink> openSet;
-	TArray<TDPNodeLink> priorityQueue;
-	TSet<TDPNodeLink> closedSet;
-	TMap<TDPNodeLink, TDPNodeLink> breadcrumbTrail;
-	TMap<TDPNodeLink, float> hScores; // h(n)
-	TMap<TDPNodeLink, float> gScores; // g(n)
+	FindCorridorPath(startLink, endLink, startPosition, endPosition, nullptr, path);
+}
+
+bool TDPAStar::FindCorridorPath(const TDPNodeLink startLink, const TDPNodeLink endLink, const FVector& startPosition, const FVector& endPosition, const TSet<TDPNodeLink>* corridor, TDPNavigationPath& path) const
+{
+	if (mCustomHeuristic)
+	{
+		return FindPath(startLink, endLink, startPosition, endPosition, [this, endLink](const TDPNodeLink& link)
+		{
+			return mHeuristic(link, endLink, *mVolume);
+		}, corridor, path);
+	}
 
-	TDPNodeLink currentLink = startLink;
-	closedSet.Add(startLink);
+	// the end doesn't move during the query, only the node position is looked up
+	const FVector end = mVolume->GetLinkPosition(endLink);
 
-	gScores.Emplace(startLink, 0.0f);
-	hScores.Emplace(startLink, CalculateHeuristic(startLink, endLink));
+	switch (mHeuristicType)
+	{
+	case ETDPHeuristic::EuclideanDistance:
+		return FindPath(startLink, endLink, startPosition, endPosition, [this, end](const TDPNodeLink& link)
+		{
+			return PathHelper::FEuclideanDistance()(mVolume->GetLinkPosition(link), end);
+		}, corridor, path);
+	case ETDPHeuristic::OctileDistance:
+		return FindPath(startLink, endLink, startPosition, endPosition, [this, end](const TDPNodeLink& link)
+		{
+			return PathHelper::FOctileDistance()(mVolume->GetLinkPosition(link), end);
+		}, corridor, path);
+	default:
+		return FindPath(startLink, endLink, startPosition, endPosition, [this, end](const TDPNodeLink& link)
+		{
+			return PathHelper::FManhattanDistance()(mVolume->GetLinkPosition(link), end);
+		}, corridor, path);
+	}
+}
 
-	TArray<TDPNodeLink> neighbors;
+template<typename HeuristicType>
+bool TDPAStar::FindPath(const TDPNodeLink startLink, const TDPNodeLink endLink, const FVector& startPosition, const FVector& endPosition, const HeuristicType& heuristic, const TSet<TDPNodeLink>* corridor, TDPNavigationPath& path) const
+{
+	if (mSettings->UseUnitCost)
+	{
+		return Search(startLink, endLink, startPosition, endPosition, heuristic, PathHelper::FUnitCost(), corridor, path);
+	}
 
-	auto comparator = [&gScores, &hScores](const TDPNodeLink& left, const TDPNodeLink& right) 
-	{ 
-		return (gScores[left] + hScores[left]) < (gScores[right] + hScores[right]);
-	};
+	return Search(startLink, endLink, startPosition, endPosition, heuristic, PathHelper::FDistanceCost(), corridor, path);
+}
 
-	uint32 iterations = 0;
+template<typename HeuristicType, typename CostType>
+struct TDPAStar::FSearchSpace
+{
+	const TDPAStar& PathFinder;
+	const HeuristicType& Heuristic;
+	const CostType& Cost;
+	const FLayerFactors& Factors;
+	const TSet<TDPNodeLink>* Corridor;
+	TArray<TDPNodeLink>& Neighbors;
+
+	float GetHeuristic(uint16 tile, const TDPNodeLink& link) const
+	{
+		return Heuristic(link) * Factors.Heuristic;
+	}
 
-	while (currentLink != endLink)
+	template<typename VisitorType>
+	void ForEachNeighbor(uint16 tile, const TDPNodeLink& link, const VisitorType& visit) const
 	{
-		const auto currentNode = mVolume->GetNodeFromLink(currentLink);
-		if (currentNode)
+		const ATDPVolume& volume = *PathFinder.mVolume;
+		if (!volume.GetNodeFromLink(link).IsValid())
 		{
-#if WITH_EDITOR
-			/*if (iterations == 3)
-				mVolume->DrawVoxelFromLink(currentLink, FColor::White, FString::FromInt(iterations));*/
-#endif // WITH_EDITOR
-			if (currentLink.LayerIndex == 0 && currentNode->GetFirstChild().IsValid())
-			{
-				mVolume->GetLeafNeighborsFromLink(currentLink, neighbors);
-			}
-			else
+			return;
+		}
+
+		// a baked graph hands out the row as is, otherwise the neighbors are searched in the octree
+		const TArrayView<const TDPNodeLink> neighborRow = PathFinder.GetNeighbors(link, Neighbors);
+		TArrayView<const float> costRow;
+
+		if (CostType::UsesDistance && volume.GetGraph().IsBuilt())
+		{
+			costRow = volume.GetGraph().GetCosts(link);
+		}
+
+		const FVector position = CostType::UsesDistance && costRow.Num() == 0 ? volume.GetLinkPosition(link) : FVector::ZeroVector;
+		const float unitCost = PathFinder.mSettings->UnitCost;
+
+		for (int32 i = 0; i < neighborRow.Num(); ++i)
+		{
+			const auto& neighbor = neighborRow[i];
+
+			if (Corridor && !Corridor->Contains(volume.GetCoarseLink(neighbor)))
 			{
-				mVolume->GetNodeNeighborsFromLink(currentLink, neighbors);
+				continue;
 			}
 
-			for (const auto& neighbor : neighbors)
+			float distance = 0.0f;
+			if (CostType::UsesDistance)
 			{
-				if (!closedSet.Contains(neighbor))
-				{
-					float pathCost = gScores[currentLink] + GetCost(currentLink, neighbor);
-
-					if (openSet.Contains(neighbor))
-					{
-						if (pathCost < gScores[neighbor])
-						{
-							breadcrumbTrail[neighbor] = currentLink;
-							gScores[neighbor] = pathCost;
-							priorityQueue.Heapify(comparator);
-						}
-					}
-					else
-					{
-						breadcrumbTrail.Emplace(neighbor, currentLink);
-						hScores.Emplace(neighbor, CalculateHeuristic(neighbor, endLink));
-						gScores.Emplace(neighbor, pathCost);
-						openSet.Add(neighbor);
-						priorityQueue.HeapPush(neighbor, comparator);
-
-#if WITH_EDITOR
-						/*if (iterations == 3)
-							mVolume->DrawVoxelFromLink(neighbor, FColor::Black, FString::FromInt(iterations));*/
-#endif // WITH_EDITOR
-					}
-				}
+				distance = costRow.Num() > 0 ? costRow[i] : (volume.GetLinkPosition(neighbor) - position).Size();
 			}
 
-			neighbors.Reset();
+			visit(tile, neighbor, Cost(unitCost, distance) * Factors.Cost[neighbor.LayerIndex]);
 		}
+	}
+};
 
-		++iterations;
+template<typename HeuristicType, typename CostType>
+bool TDPAStar::Search(const TDPNodeLink startLink, const TDPNodeLink endLink, const FVector& startPosition, const FVector& endPosition, const HeuristicType& heuristic, const CostType& cost, const TSet<TDPNodeLink>* corridor, TDPNavigationPath& path) const
+{
+	FLayerFactors factors;
+	GetLayerFactors(endLink, factors);
 
-		if (openSet.Num() == 0)
-		{
-			break;
-		}
+	// open, closed, scores and breadcrumbs all live in the reused per thread state
+	TDPSearchState& state = TDPSearchState::Get();
+	state.Reset(mVolume->GetOctree());
 
-		priorityQueue.HeapPop(currentLink, comparator);
-		openSet.Remove(currentLink);
-		closedSet.Add(currentLink);
-	}
+	const FSearchSpace<HeuristicType, CostType> space{ *this, heuristic, cost, factors, corridor, state.GetNeighbors() };
+
+	auto& statistics = path.GetStatistics();
+	const int32 end = state.Search(space, 0, startLink, 0, endLink, statistics);
 
-	if (currentLink == endLink)
+	if (end != TDPSearchState::InvalidSlot)
 	{
-		BuildPath(breadcrumbTrail, currentLink, startPosition, endPosition, path);
+		BuildPath(state, end, startPosition, endPosition, path);
 #if WITH_EDITOR
-		UE_LOG(CinnamonLog, Display, TEXT("Pathfinding complete, iterations: %i"), iterations);
-		UE_LOG(CinnamonLog, Display, TEXT("Pathfinding complete, visited nodes: %i"), closedSet.Num());
-		UE_LOG(CinnamonLog, Display, TEXT("Pathfinding complete, frontier: %i"), openSet.Num());
+		UE_LOG(CinnamonLog, Display, TEXT("Pathfinding complete, iterations: %i"), statistics.Iterations);
+		UE_LOG(CinnamonLog, Display, TEXT("Pathfinding complete, visited nodes: %i"), statistics.VisitedNodes);
+		UE_LOG(CinnamonLog, Display, TEXT("Pathfinding complete, frontier: %i"), statistics.FrontierNodes);
 		UE_LOG(CinnamonLog, Display, TEXT("Pathfinding complete, path length: %i"), path.GetPath().Num());
-		UE_LOG(CinnamonLog, Display, TEXT("Pathfinding complete, path cost: %f"), gScores[endLink]);
+		UE_LOG(CinnamonLog, Display, TEXT("Pathfinding complete, path cost: %f"), statistics.Cost);
 #endif
-		return;
+		return true;
 	}
 
 #if WITH_EDITOR
-	UE_LOG(CinnamonLog, Warning, TEXT("Pathfinding failed, iterations: %i"), iterations);
-	UE_LOG(CinnamonLog, Warning, TEXT("Pathfinding failed, visited nodes: %i"), closedSet.Num());
-	UE_LOG(CinnamonLog, Warning, TEXT("Pathfinding failed, frontier: %i"), openSet.Num());
+	UE_LOG(CinnamonLog, Warning, TEXT("Pathfinding failed, iterations: %i"), statistics.Iterations);
+	UE_LOG(CinnamonLog, Warning, TEXT("Pathfinding failed, visited nodes: %i"), statistics.VisitedNodes);
+	UE_LOG(CinnamonLog, Warning, TEXT("Pathfinding failed, frontier: %i"), statistics.FrontierNodes);
 #endif
+	return false;
 }
 
 float TDPAStar::GetCost(const TDPNodeLink& start, const TDPNodeLink& end) const
 {
-	// assume unit cost
-	float cost = mSettings->UnitCost;
+	return GetCost(end, mSettings->UseUnitCost ? 0.0f : (mVolume->GetLinkPosition(start) - mVolume->GetLinkPosition(end)).Size());
+}
 
-	if (!mSettings->UseUnitCost)
-	{
-		FVector startPosition, endPosition;
-		mVolume->GetNodePositionFromLink(start, startPosition);
-		mVolume->GetNodePositionFromLink(end, endPosition);
-		cost = (startPosition - endPosition).Size();
-	}
+float TDPAStar::GetCost(const TDPNodeLink& end, float distance) const
+{
+	// assume unit cost
+	float cost = mSettings->UseUnitCost ? mSettings->UnitCost : distance;
 
 	cost *= (1.0f - (static_cast<float>(end.LayerIndex) / static_cast<float>(mVolume->GetTotalLayers()))) * mSettings->NodeSizeCompensation;
 
 	return cost;
 }
 
+void TDPAStar::GetLayerFactors(const TDPNodeLink& endLink, FLayerFactors& factors) const
+{
+	const float totalLayers = static_cast<float>(mVolume->GetTotalLayers());
+
+	for (int32 layer = 0; layer < INVALID_LAYER_INDEX; ++layer)
+	{
+		factors.Cost[layer] = (1.0f - (layer / totalLayers)) * mSettings->NodeSizeCompensation;
+	}
+
+	// compensated by the layer of the end, the same for every node of the query
+	factors.Heuristic = factors.Cost[endLink.LayerIndex] * mSettings->HeuristicWeight;
+}
+
 float TDPAStar::CalculateHeuristic(const TDPNodeLink& start, const TDPNodeLink& end) const
 {
 	float heuristic = mHeuristic(start, end, *mVolume);
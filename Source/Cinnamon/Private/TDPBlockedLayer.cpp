@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TDPBlockedLayer.h"
+#include "Algo/BinarySearch.h"
+
+void TDPBlockedLayer::Build(TArray<MortonCodeType>& codes, MortonCodeType totalCodes)
+{
+	RadixSort(codes, totalCodes);
+
+	int32 total = 0;
+	for (int32 i = 0; i < codes.Num(); ++i)
+	{
+		if (total == 0 || codes[total - 1] != codes[i])
+		{
+			codes[total++] = codes[i];
+		}
+	}
+
+	codes.SetNum(total, false);
+	BuildSorted(codes, totalCodes);
+}
+
+void TDPBlockedLayer::BuildSorted(const TArray<MortonCodeType>& codes, MortonCodeType totalCodes)
+{
+	Reset();
+
+	mNum = codes.Num();
+	// a bitmap costs one bit per possible code, the sorted array 64 bits per blocked code
+	mIsDense = totalCodes <= static_cast<MortonCodeType>(codes.Num()) * 64;
+
+	if (mIsDense)
+	{
+		mBitmap.SetNumZeroed(static_cast<int32>((totalCodes + 63) >> 6));
+		for (MortonCodeType code : codes)
+		{
+			mBitmap[code >> 6] |= 1ULL << (code & 63);
+		}
+	}
+	else
+	{
+		mCodes = codes;
+	}
+}
+
+void TDPBlockedLayer::Reset()
+{
+	mCodes.Empty();
+	mBitmap.Empty();
+	mNum = 0;
+	mIsDense = false;
+}
+
+bool TDPBlockedLayer::Contains(MortonCodeType code) const
+{
+	if (mIsDense)
+	{
+		const MortonCodeType word = code >> 6;
+		return word < static_cast<MortonCodeType>(mBitmap.Num()) && (mBitmap[word] & (1ULL << (code & 63))) != 0;
+	}
+
+	return Algo::BinarySearch(mCodes, code) != INDEX_NONE;
+}
+
+int32 TDPBlockedLayer::Num() const
+{
+	return mNum;
+}
+
+bool TDPBlockedLayer::IsDense() const
+{
+	return mIsDense;
+}
+
+SIZE_T TDPBlockedLayer::GetAllocatedSize() const
+{
+	return mCodes.GetAllocatedSize() + mBitmap.GetAllocatedSize();
+}
+
+void TDPBlockedLayer::RadixSort(TArray<MortonCodeType>& codes, MortonCodeType totalCodes)
+{
+	const int32 bits = totalCodes > 1 ? FMath::CeilLogTwo64(totalCodes) : 0;
+
+	TArray<MortonCodeType> buffer;
+	buffer.SetNumUninitialized(codes.Num());
+
+	// least significant digit first, only as many byte passes as the layer has bits
+	for (int32 shift = 0; shift < bits; shift += 8)
+	{
+		int32 offsets[257] = {};
+
+		for (MortonCodeType code : codes)
+		{
+			++offsets[((code >> shift) & 0xFF) + 1];
+		}
+
+		for (int32 i = 0; i < 256; ++i)
+		{
+			offsets[i + 1] += offsets[i];
+		}
+
+		for (MortonCodeType code : codes)
+		{
+			buffer[offsets[(code >> shift) & 0xFF]++] = code;
+		}
+
+		Swap(codes, buffer);
+	}
+}
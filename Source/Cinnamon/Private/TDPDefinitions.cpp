@@ -2,6 +2,7 @@
 
 
 #include "TDPDefinitions.h"
+#include "Serialization/CustomVersion.h"
 
 const FIntVector NodeHelper::NeighborDirections[] = {
 	{ 1, 0, 0 },
@@ -30,6 +31,17 @@ const NodeIndexType NodeHelper::LeafChildOffsets[6][16] = {
 	{ 36, 37, 44, 45, 38, 39, 46, 47, 52, 53, 60, 61, 54, 55, 62, 63 }
 };
 
+const uint8 NodeHelper::SubnodeCoordinates[64][3] = {
+	{ 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 }, { 1, 1, 0 }, { 0, 0, 1 }, { 1, 0, 1 }, { 0, 1, 1 }, { 1, 1, 1 },
+	{ 2, 0, 0 }, { 3, 0, 0 }, { 2, 1, 0 }, { 3, 1, 0 }, { 2, 0, 1 }, { 3, 0, 1 }, { 2, 1, 1 }, { 3, 1, 1 },
+	{ 0, 2, 0 }, { 1, 2, 0 }, { 0, 3, 0 }, { 1, 3, 0 }, { 0, 2, 1 }, { 1, 2, 1 }, { 0, 3, 1 }, { 1, 3, 1 },
+	{ 2, 2, 0 }, { 3, 2, 0 }, { 2, 3, 0 }, { 3, 3, 0 }, { 2, 2, 1 }, { 3, 2, 1 }, { 2, 3, 1 }, { 3, 3, 1 },
+	{ 0, 0, 2 }, { 1, 0, 2 }, { 0, 1, 2 }, { 1, 1, 2 }, { 0, 0, 3 }, { 1, 0, 3 }, { 0, 1, 3 }, { 1, 1, 3 },
+	{ 2, 0, 2 }, { 3, 0, 2 }, { 2, 1, 2 }, { 3, 1, 2 }, { 2, 0, 3 }, { 3, 0, 3 }, { 2, 1, 3 }, { 3, 1, 3 },
+	{ 0, 2, 2 }, { 1, 2, 2 }, { 0, 3, 2 }, { 1, 3, 2 }, { 0, 2, 3 }, { 1, 2, 3 }, { 0, 3, 3 }, { 1, 3, 3 },
+	{ 2, 2, 2 }, { 3, 2, 2 }, { 2, 3, 2 }, { 3, 3, 2 }, { 2, 2, 3 }, { 3, 2, 3 }, { 2, 3, 3 }, { 3, 3, 3 }
+};
+
 const FColor DebugHelper::LayerColors[] = {
 	FColor::Yellow,
 	FColor::Blue,
@@ -43,3 +55,7 @@ const FColor DebugHelper::LayerColors[] = {
 	FColor::Emerald,
 	FColor::Turquoise
 };
+
+const FGuid FTDPCustomVersion::GUID(0x6A1C3E52, 0x41B7497D, 0x9E0F2C84, 0x3D5B7A19);
+
+FCustomVersionRegistration GRegisterTDPCustomVersion(FTDPCustomVersion::GUID, FTDPCustomVersion::LatestVersion, TEXT("TDPOctreeVer"));
@@ -0,0 +1,538 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TDPGeometryRasterizer.h"
+#include "Engine/World.h"
+#include "Components/PrimitiveComponent.h"
+#include "PhysicsEngine/BodySetup.h"
+#include "Interfaces/Interface_CollisionDataProvider.h"
+
+namespace
+{
+	// two triangles per box face, corners are indexed by their xyz bits
+	const int32 BoxIndices[36] = {
+		0, 2, 6, 0, 6, 4,
+		1, 5, 7, 1, 7, 3,
+		0, 4, 5, 0, 5, 1,
+		2, 3, 7, 2, 7, 6,
+		0, 1, 3, 0, 3, 2,
+		4, 6, 7, 4, 7, 5
+	};
+
+	const int32 MaxGridResolution = 64;
+	const int32 CapsuleSearchIterations = 32;
+}
+
+void TDPGeometryRasterizer::Gather(UWorld* world, const FBox& bounds, ECollisionChannel channel, bool complexCollision, const AActor* ignoredActor)
+{
+	Reset();
+
+	mBounds = bounds;
+
+	FCollisionQueryParams collisionParams;
+	collisionParams.bFindInitialOverlaps = true;
+	collisionParams.bTraceComplex = complexCollision;
+
+	if (ignoredActor)
+	{
+		collisionParams.AddIgnoredActor(ignoredActor);
+	}
+
+	TArray<FOverlapResult> results;
+	world->OverlapMultiByChannel(results, bounds.GetCenter(), FQuat::Identity, channel, FCollisionShape::MakeBox(bounds.GetExtent()), collisionParams);
+
+	TSet<UPrimitiveComponent*> components;
+	for (auto& result : results)
+	{
+		UPrimitiveComponent* component = result.GetComponent();
+
+		// only blocking geometry takes part in the physics rasterization, mirror that
+		if (component && result.bBlockingHit && !components.Contains(component))
+		{
+			components.Add(component);
+			AddComponent(*component, complexCollision);
+		}
+	}
+
+	BuildGrid();
+	mIsReady = true;
+}
+
+void TDPGeometryRasterizer::Reset()
+{
+	mElements.Empty();
+	mTriangles.Empty();
+	mConvexes.Empty();
+	mPlanes.Empty();
+	mSpheres.Empty();
+	mCapsules.Empty();
+	mCellOffsets.Empty();
+	mCellElements.Empty();
+	mResolution = 0;
+	mIsReady = false;
+}
+
+bool TDPGeometryRasterizer::IsReady() const
+{
+	return mIsReady;
+}
+
+bool TDPGeometryRasterizer::IsBoxBlocked(const FVector& center, float halfSize) const
+{
+	const FVector extent(halfSize);
+	const FBox box(center - extent, center + extent);
+
+	if (!mIsReady || mElements.Num() == 0 || !box.Intersect(mBounds))
+	{
+		return false;
+	}
+
+	FIntVector min, max;
+	GetCellRange(box, min, max);
+
+	for (int32 z = min.Z; z <= max.Z; ++z)
+	{
+		for (int32 y = min.Y; y <= max.Y; ++y)
+		{
+			for (int32 x = min.X; x <= max.X; ++x)
+			{
+				const int32 cell = x + (y * mResolution) + (z * mResolution * mResolution);
+
+				for (int32 i = mCellOffsets[cell]; i < mCellOffsets[cell + 1]; ++i)
+				{
+					const auto& element = mElements[mCellElements[i]];
+
+					if (element.Bounds.Intersect(box) && IsElementBlocked(element, center, extent))
+					{
+						return true;
+					}
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+bool TDPGeometryRasterizer::IsBoxContained(const FVector& center, float halfSize) const
+{
+	const FVector extent(halfSize);
+	const FBox box(center - extent, center + extent);
+
+	if (!mIsReady || mElements.Num() == 0 || !mBounds.IsInside(box))
+	{
+		return false;
+	}
+
+	// an element holding the whole box overlaps the cell of its center, no need to look anywhere else
+	FIntVector min, max;
+	GetCellRange(FBox(center, center), min, max);
+
+	const int32 cell = min.X + (min.Y * mResolution) + (min.Z * mResolution * mResolution);
+
+	for (int32 i = mCellOffsets[cell]; i < mCellOffsets[cell + 1]; ++i)
+	{
+		const auto& element = mElements[mCellElements[i]];
+
+		if (element.Bounds.IsInside(box) && IsElementContaining(element, center, extent))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int32 TDPGeometryRasterizer::GetTotalTriangles() const
+{
+	return mTriangles.Num();
+}
+
+SIZE_T TDPGeometryRasterizer::GetAllocatedSize() const
+{
+	return mElements.GetAllocatedSize() + mTriangles.GetAllocatedSize() + mConvexes.GetAllocatedSize() + mPlanes.GetAllocatedSize() +
+		mSpheres.GetAllocatedSize() + mCapsules.GetAllocatedSize() + mCellOffsets.GetAllocatedSize() + mCellElements.GetAllocatedSize();
+}
+
+void TDPGeometryRasterizer::AddComponent(UPrimitiveComponent& component, bool complexCollision)
+{
+	UBodySetup* bodySetup = component.GetBodySetup();
+
+	if (bodySetup == nullptr)
+	{
+		return;
+	}
+
+	const FTransform& transform = component.GetComponentTransform();
+	const ECollisionTraceFlag traceFlag = bodySetup->GetCollisionTraceFlag();
+	const bool useComplex = traceFlag == CTF_UseComplexAsSimple || (complexCollision && traceFlag != CTF_UseSimpleAsComplex);
+
+	// fall back to simple collision if there is no triangle data available
+	if (!useComplex || !AddTriangleMesh(*bodySetup, transform))
+	{
+		AddSimpleGeometry(*bodySetup, transform);
+	}
+}
+
+bool TDPGeometryRasterizer::AddTriangleMesh(const UBodySetup& bodySetup, const FTransform& transform)
+{
+	IInterface_CollisionDataProvider* provider = Cast<IInterface_CollisionDataProvider>(bodySetup.GetOuter());
+
+	if (provider == nullptr || !provider->ContainsPhysicsTriMeshData(true))
+	{
+		return false;
+	}
+
+	FTriMeshCollisionData data;
+	if (!provider->GetPhysicsTriMeshData(&data, true))
+	{
+		return false;
+	}
+
+	for (const auto& triangle : data.Indices)
+	{
+		AddTriangle(transform.TransformPosition(data.Vertices[triangle.v0]),
+			transform.TransformPosition(data.Vertices[triangle.v1]),
+			transform.TransformPosition(data.Vertices[triangle.v2]));
+	}
+
+	return data.Indices.Num() > 0;
+}
+
+void TDPGeometryRasterizer::AddSimpleGeometry(const UBodySetup& bodySetup, const FTransform& transform)
+{
+	const FKAggregateGeom& geometry = bodySetup.AggGeom;
+	// spheres and capsules can't represent non uniform scale, grow them to stay conservative
+	const float maxScale = transform.GetScale3D().GetAbsMax();
+
+	for (const auto& box : geometry.BoxElems)
+	{
+		AddBox(box.GetTransform(), transform, FVector(box.X, box.Y, box.Z) / 2);
+	}
+
+	for (const auto& sphere : geometry.SphereElems)
+	{
+		FSphere element;
+		element.Center = transform.TransformPosition(sphere.Center);
+		element.Radius = sphere.Radius * maxScale;
+
+		mElements.Add({ EElementType::Sphere, mSpheres.Add(element), FBox(element.Center - FVector(element.Radius), element.Center + FVector(element.Radius)) });
+	}
+
+	for (const auto& sphyl : geometry.SphylElems)
+	{
+		const FTransform elementTransform = sphyl.GetTransform();
+
+		FCapsule element;
+		element.Start = transform.TransformPosition(elementTransform.TransformPosition(FVector(0.0f, 0.0f, sphyl.Length / 2)));
+		element.End = transform.TransformPosition(elementTransform.TransformPosition(FVector(0.0f, 0.0f, -sphyl.Length / 2)));
+		element.Radius = sphyl.Radius * maxScale;
+
+		FBox bounds(element.Start - FVector(element.Radius), element.Start + FVector(element.Radius));
+		bounds += FBox(element.End - FVector(element.Radius), element.End + FVector(element.Radius));
+		mElements.Add({ EElementType::Capsule, mCapsules.Add(element), bounds });
+	}
+
+	for (const auto& convex : geometry.ConvexElems)
+	{
+		const FTransform elementTransform = convex.GetTransform();
+
+		// without hull indices the best we can do is the hull bounds
+		if (convex.IndexData.Num() == 0)
+		{
+			AddBox(FTransform(convex.ElemBox.GetCenter()) * elementTransform, transform, convex.ElemBox.GetExtent());
+			continue;
+		}
+
+		TArray<FVector> vertices;
+		vertices.Reserve(convex.VertexData.Num());
+		for (const auto& vertex : convex.VertexData)
+		{
+			vertices.Add(transform.TransformPosition(elementTransform.TransformPosition(vertex)));
+		}
+
+		AddConvex(vertices, convex.IndexData);
+	}
+}
+
+void TDPGeometryRasterizer::AddTriangle(const FVector& a, const FVector& b, const FVector& c)
+{
+	FBox bounds(a, a);
+	bounds += b;
+	bounds += c;
+
+	mElements.Add({ EElementType::Triangle, mTriangles.Add({ a, b, c }), bounds });
+}
+
+void TDPGeometryRasterizer::AddConvex(const TArray<FVector>& vertices, const TArray<int32>& indices)
+{
+	FBox bounds(vertices);
+	const FVector centroid = bounds.GetCenter();
+
+	FConvex convex;
+	convex.FirstPlane = mPlanes.Num();
+
+	for (int32 i = 0; i + 2 < indices.Num(); i += 3)
+	{
+		const FVector& a = vertices[indices[i]];
+		const FVector& b = vertices[indices[i + 1]];
+		const FVector& c = vertices[indices[i + 2]];
+
+		// the hull surface catches every box that crosses it
+		AddTriangle(a, b, c);
+
+		// keep the planes facing outwards so the interior is on the negative side
+		FPlane plane(a, b, c);
+		if (plane.PlaneDot(centroid) > 0.0f)
+		{
+			plane = plane.Flip();
+		}
+
+		mPlanes.Add(plane);
+	}
+
+	convex.TotalPlanes = mPlanes.Num() - convex.FirstPlane;
+
+	// the interior catches the boxes that are fully inside the hull
+	mElements.Add({ EElementType::Convex, mConvexes.Add(convex), bounds });
+}
+
+void TDPGeometryRasterizer::AddBox(const FTransform& elementTransform, const FTransform& transform, const FVector& extent)
+{
+	TArray<FVector> vertices;
+	vertices.Reserve(8);
+
+	for (int32 i = 0; i < 8; ++i)
+	{
+		const FVector corner((i & 1) ? extent.X : -extent.X, (i & 2) ? extent.Y : -extent.Y, (i & 4) ? extent.Z : -extent.Z);
+		vertices.Add(transform.TransformPosition(elementTransform.TransformPosition(corner)));
+	}
+
+	AddConvex(vertices, TArray<int32>(BoxIndices, ARRAY_COUNT(BoxIndices)));
+}
+
+void TDPGeometryRasterizer::BuildGrid()
+{
+	// aim for a handful of elements per cell
+	mResolution = FMath::Clamp(FMath::CeilToInt(FMath::Pow(static_cast<float>(mElements.Num()), 1.0f / 3.0f)), 1, MaxGridResolution);
+	mCellSize = mBounds.GetSize() / static_cast<float>(mResolution);
+
+	const int32 totalCells = mResolution * mResolution * mResolution;
+	mCellOffsets.Init(0, totalCells + 1);
+
+	// count, prefix sum and fill so each cell is a contiguous range
+	for (int32 pass = 0; pass < 2; ++pass)
+	{
+		if (pass == 1)
+		{
+			for (int32 i = 0; i < totalCells; ++i)
+			{
+				mCellOffsets[i + 1] += mCellOffsets[i];
+			}
+
+			mCellElements.SetNumUninitialized(mCellOffsets[totalCells]);
+		}
+
+		TArray<int32> cursors;
+		if (pass == 1)
+		{
+			cursors = mCellOffsets;
+		}
+
+		for (int32 elementIndex = 0; elementIndex < mElements.Num(); ++elementIndex)
+		{
+			FIntVector min, max;
+			GetCellRange(mElements[elementIndex].Bounds, min, max);
+
+			for (int32 z = min.Z; z <= max.Z; ++z)
+			{
+				for (int32 y = min.Y; y <= max.Y; ++y)
+				{
+					for (int32 x = min.X; x <= max.X; ++x)
+					{
+						const int32 cell = x + (y * mResolution) + (z * mResolution * mResolution);
+
+						if (pass == 0)
+						{
+							++mCellOffsets[cell + 1];
+						}
+						else
+						{
+							mCellElements[cursors[cell]++] = elementIndex;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+bool TDPGeometryRasterizer::IsElementBlocked(const FElement& element, const FVector& center, const FVector& extent) const
+{
+	switch (element.Type)
+	{
+	case EElementType::Triangle:
+		return TriangleBoxOverlap(center, extent, mTriangles[element.Index]);
+	case EElementType::Convex:
+	{
+		// a box that doesn't cross the hull surface is blocked only if it is inside the hull
+		const auto& convex = mConvexes[element.Index];
+		for (int32 i = convex.FirstPlane; i < convex.FirstPlane + convex.TotalPlanes; ++i)
+		{
+			if (mPlanes[i].PlaneDot(center) > 0.0f)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+	case EElementType::Sphere:
+	{
+		const auto& sphere = mSpheres[element.Index];
+		return PointBoxDistanceSquared(sphere.Center, center, extent) <= FMath::Square(sphere.Radius);
+	}
+	case EElementType::Capsule:
+	{
+		// distance from the box along the capsule segment is convex, so a ternary search finds the closest point
+		const auto& capsule = mCapsules[element.Index];
+		float low = 0.0f;
+		float high = 1.0f;
+
+		for (int32 i = 0; i < CapsuleSearchIterations; ++i)
+		{
+			const float first = low + (high - low) / 3;
+			const float second = high - (high - low) / 3;
+
+			if (PointBoxDistanceSquared(FMath::Lerp(capsule.Start, capsule.End, first), center, extent) <
+				PointBoxDistanceSquared(FMath::Lerp(capsule.Start, capsule.End, second), center, extent))
+			{
+				high = second;
+			}
+			else
+			{
+				low = first;
+			}
+		}
+
+		return PointBoxDistanceSquared(FMath::Lerp(capsule.Start, capsule.End, (low + high) / 2), center, extent) <= FMath::Square(capsule.Radius);
+	}
+	default:
+		return false;
+	}
+}
+
+bool TDPGeometryRasterizer::IsElementContaining(const FElement& element, const FVector& center, const FVector& extent) const
+{
+	// every element but loose triangles is convex, so it holds the box if it holds all of its corners
+	for (int32 corner = 0; corner < 8; ++corner)
+	{
+		const FVector point = center + extent * FVector(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, corner & 4 ? 1.0f : -1.0f);
+
+		switch (element.Type)
+		{
+		case EElementType::Convex:
+		{
+			const auto& convex = mConvexes[element.Index];
+			for (int32 i = convex.FirstPlane; i < convex.FirstPlane + convex.TotalPlanes; ++i)
+			{
+				if (mPlanes[i].PlaneDot(point) > 0.0f)
+				{
+					return false;
+				}
+			}
+			break;
+		}
+		case EElementType::Sphere:
+		{
+			const auto& sphere = mSpheres[element.Index];
+			if (FVector::DistSquared(point, sphere.Center) > FMath::Square(sphere.Radius))
+			{
+				return false;
+			}
+			break;
+		}
+		case EElementType::Capsule:
+		{
+			const auto& capsule = mCapsules[element.Index];
+			if (FMath::PointDistToSegmentSquared(point, capsule.Start, capsule.End) > FMath::Square(capsule.Radius))
+			{
+				return false;
+			}
+			break;
+		}
+		default:
+			// triangle soups have no inside
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void TDPGeometryRasterizer::GetCellRange(const FBox& box, FIntVector& min, FIntVector& max) const
+{
+	const FVector localMin = (box.Min - mBounds.Min) / mCellSize;
+	const FVector localMax = (box.Max - mBounds.Min) / mCellSize;
+
+	min.X = FMath::Clamp(FMath::FloorToInt(localMin.X), 0, mResolution - 1);
+	min.Y = FMath::Clamp(FMath::FloorToInt(localMin.Y), 0, mResolution - 1);
+	min.Z = FMath::Clamp(FMath::FloorToInt(localMin.Z), 0, mResolution - 1);
+	max.X = FMath::Clamp(FMath::FloorToInt(localMax.X), 0, mResolution - 1);
+	max.Y = FMath::Clamp(FMath::FloorToInt(localMax.Y), 0, mResolution - 1);
+	max.Z = FMath::Clamp(FMath::FloorToInt(localMax.Z), 0, mResolution - 1);
+}
+
+bool TDPGeometryRasterizer::TriangleBoxOverlap(const FVector& center, const FVector& extent, const FTriangle& triangle)
+{
+	// separating axis test (Akenine-Moller), move everything so the box is centered at the origin
+	const FVector v0 = triangle.A - center;
+	const FVector v1 = triangle.B - center;
+	const FVector v2 = triangle.C - center;
+
+	// box face normals
+	if (FMath::Max3(v0.X, v1.X, v2.X) < -extent.X || FMath::Min3(v0.X, v1.X, v2.X) > extent.X ||
+		FMath::Max3(v0.Y, v1.Y, v2.Y) < -extent.Y || FMath::Min3(v0.Y, v1.Y, v2.Y) > extent.Y ||
+		FMath::Max3(v0.Z, v1.Z, v2.Z) < -extent.Z || FMath::Min3(v0.Z, v1.Z, v2.Z) > extent.Z)
+	{
+		return false;
+	}
+
+	const FVector edges[3] = { v1 - v0, v2 - v1, v0 - v2 };
+
+	auto isSeparatingAxis = [&](const FVector& axis) -> bool
+	{
+		const float p0 = FVector::DotProduct(v0, axis);
+		const float p1 = FVector::DotProduct(v1, axis);
+		const float p2 = FVector::DotProduct(v2, axis);
+		const float radius = extent.X * FMath::Abs(axis.X) + extent.Y * FMath::Abs(axis.Y) + extent.Z * FMath::Abs(axis.Z);
+
+		return FMath::Max3(p0, p1, p2) < -radius || FMath::Min3(p0, p1, p2) > radius;
+	};
+
+	// triangle normal
+	if (isSeparatingAxis(FVector::CrossProduct(edges[0], edges[1])))
+	{
+		return false;
+	}
+
+	// cross products of box axes and triangle edges
+	for (const auto& edge : edges)
+	{
+		if (isSeparatingAxis(FVector(0.0f, -edge.Z, edge.Y)) ||
+			isSeparatingAxis(FVector(edge.Z, 0.0f, -edge.X)) ||
+			isSeparatingAxis(FVector(-edge.Y, edge.X, 0.0f)))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+float TDPGeometryRasterizer::PointBoxDistanceSquared(const FVector& point, const FVector& center, const FVector& extent)
+{
+	const FVector local = (point - center).GetAbs() - extent;
+
+	return FVector(FMath::Max(local.X, 0.0f), FMath::Max(local.Y, 0.0f), FMath::Max(local.Z, 0.0f)).SizeSquared();
+}
@@ -0,0 +1,157 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TDPGraph.h"
+#include "TDPTree.h"
+
+
+void TDPGraph::Build(const TDPTree& octree, NeighborsFunction getNeighbors, PositionFunction getPosition, LayerIndexType firstLayer)
+{
+	Reset();
+
+	if (firstLayer >= octree.Layers.Num())
+	{
+		return;
+	}
+
+	// lay out the rows first, every layer node and then the subnodes of the partially blocked leaves
+	int32 totalRows = 0;
+	mLayerRows.SetNumUninitialized(octree.Layers.Num());
+
+	for (int32 layer = 0; layer < octree.Layers.Num(); ++layer)
+	{
+		mLayerRows[layer] = layer < firstLayer ? INDEX_NONE : totalRows;
+		totalRows += layer < firstLayer ? 0 : octree.Layers[layer].Num();
+	}
+
+	const auto& leafLayer = octree.Layers[0];
+
+	if (firstLayer == 0)
+	{
+		mSubnodeRows.Init(INDEX_NONE, leafLayer.Num());
+
+		for (NodeIndexType i = 0; i < leafLayer.Num(); ++i)
+		{
+			if (leafLayer.HasChildren(i) && leafLayer.GetFirstChild(i).NodeIndex != TDPTree::FullyBlockedLeaf)
+			{
+				mSubnodeRows[i] = totalRows;
+				totalRows += 64;
+			}
+		}
+	}
+
+	mOffsets.Reserve(totalRows + 1);
+	mOffsets.Add(0);
+
+	TArray<TDPNodeLink> neighbors;
+	auto addRow = [this, &neighbors, &getNeighbors, &getPosition](const TDPNodeLink& link)
+	{
+		neighbors.Reset();
+		getNeighbors(link, neighbors);
+
+		const FVector position = getPosition(link);
+		for (const auto& neighbor : neighbors)
+		{
+			mNeighbors.Add(neighbor);
+			mCosts.Add((getPosition(neighbor) - position).Size());
+		}
+
+		mOffsets.Add(mNeighbors.Num());
+	};
+
+	for (int32 layer = firstLayer; layer < octree.Layers.Num(); ++layer)
+	{
+		for (NodeIndexType i = 0; i < octree.Layers[layer].Num(); ++i)
+		{
+			// layer 0 nodes with children are searched through their subnodes
+			if (layer == 0 && leafLayer.HasChildren(i))
+			{
+				mOffsets.Add(mNeighbors.Num());
+				continue;
+			}
+
+			addRow(TDPNodeLink(layer, i, 0));
+		}
+	}
+
+	for (NodeIndexType i = 0; i < mSubnodeRows.Num(); ++i)
+	{
+		if (mSubnodeRows[i] == INDEX_NONE)
+		{
+			continue;
+		}
+
+		const auto& leaf = octree.GetLeafNode(leafLayer.GetFirstChild(i).NodeIndex);
+		for (SubnodeIndexType subnode = 0; subnode < 64; ++subnode)
+		{
+			// blocked subnodes are never reached
+			if (leaf.GetSubnode(subnode))
+			{
+				mOffsets.Add(mNeighbors.Num());
+				continue;
+			}
+
+			addRow(TDPNodeLink(0, i, subnode));
+		}
+	}
+
+	check(mOffsets.Num() == totalRows + 1);
+
+	mNeighbors.Shrink();
+	mCosts.Shrink();
+}
+
+void TDPGraph::Reset()
+{
+	mLayerRows.Empty();
+	mSubnodeRows.Empty();
+	mOffsets.Empty();
+	mNeighbors.Empty();
+	mCosts.Empty();
+}
+
+bool TDPGraph::IsBuilt() const
+{
+	return mOffsets.Num() > 0;
+}
+
+int32 TDPGraph::GetTotalRows() const
+{
+	return FMath::Max(mOffsets.Num() - 1, 0);
+}
+
+int32 TDPGraph::GetTotalEdges() const
+{
+	return mNeighbors.Num();
+}
+
+TArrayView<const TDPNodeLink> TDPGraph::GetNeighbors(const TDPNodeLink& link) const
+{
+	const int32 row = GetRow(link);
+
+	return TArrayView<const TDPNodeLink>(mNeighbors.GetData() + mOffsets[row], mOffsets[row + 1] - mOffsets[row]);
+}
+
+TArrayView<const float> TDPGraph::GetCosts(const TDPNodeLink& link) const
+{
+	const int32 row = GetRow(link);
+
+	return TArrayView<const float>(mCosts.GetData() + mOffsets[row], mOffsets[row + 1] - mOffsets[row]);
+}
+
+SIZE_T TDPGraph::GetAllocatedSize() const
+{
+	return mLayerRows.GetAllocatedSize() + mSubnodeRows.GetAllocatedSize() + mOffsets.GetAllocatedSize() + mNeighbors.GetAllocatedSize() + mCosts.GetAllocatedSize();
+}
+
+int32 TDPGraph::GetRow(const TDPNodeLink& link) const
+{
+	check(link.LayerIndex < mLayerRows.Num() && mLayerRows[link.LayerIndex] != INDEX_NONE);
+
+	if (link.LayerIndex == 0 && mSubnodeRows[link.NodeIndex] != INDEX_NONE)
+	{
+		return mSubnodeRows[link.NodeIndex] + link.SubnodeIndex;
+	}
+
+	return mLayerRows[link.LayerIndex] + link.NodeIndex;
+}
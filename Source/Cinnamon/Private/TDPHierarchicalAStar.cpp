@@ -0,0 +1,137 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TDPHierarchicalAStar.h"
+#include "TDPSearchState.h"
+
+
+TDPHierarchicalAStar::TDPHierarchicalAStar(const ATDPVolume& volume, ETDPHeuristic heuristic, const FTDPPathFinderSettings& settings) : TDPAStar(volume, heuristic, settings)
+{
+}
+
+void TDPHierarchicalAStar::FindPath(const TDPNodeLink startLink, const TDPNodeLink endLink, const FVector& startPosition, const FVector& endPosition, TDPNavigationPath& path) const
+{
+	if (!mVolume->GetCoarseGraph().IsBuilt())
+	{
+		TDPAStar::FindPath(startLink, endLink, startPosition, endPosition, path);
+		return;
+	}
+
+	// the coarse search has to finish first, the fine search reuses the same per thread state
+	TSet<TDPNodeLink> corridor;
+	TDPPathStatistics coarseStatistics;
+
+	if (!FindCorridor(mVolume->GetCoarseLink(startLink), mVolume->GetCoarseLink(endLink), corridor, coarseStatistics))
+	{
+		path.GetStatistics() = coarseStatistics;
+#if WITH_EDITOR
+		UE_LOG(CinnamonLog, Warning, TEXT("Hierarchical pathfinding failed, no coarse route, visited cells: %i"), coarseStatistics.VisitedNodes);
+#endif
+		return;
+	}
+
+	// a cell can be split by geometry, the route through it may not exist at full resolution
+	TDPPathStatistics corridorStatistics;
+	if (!FindCorridorPath(startLink, endLink, startPosition, endPosition, &corridor, path))
+	{
+		corridorStatistics = path.GetStatistics();
+		FindCorridorPath(startLink, endLink, startPosition, endPosition, nullptr, path);
+	}
+
+	// every pass counts, otherwise the numbers can't be compared to plain A*
+	auto& statistics = path.GetStatistics();
+	statistics.Iterations += coarseStatistics.Iterations + corridorStatistics.Iterations;
+	statistics.VisitedNodes += coarseStatistics.VisitedNodes + corridorStatistics.VisitedNodes;
+
+#if WITH_EDITOR
+	UE_LOG(CinnamonLog, Display, TEXT("Hierarchical pathfinding, visited cells: %i, corridor cells: %i"), coarseStatistics.VisitedNodes, corridor.Num());
+#endif
+}
+
+bool TDPHierarchicalAStar::FindCorridor(const TDPNodeLink& startCell, const TDPNodeLink& endCell, TSet<TDPNodeLink>& corridor, TDPPathStatistics& statistics) const
+{
+	const TDPGraph& graph = mVolume->GetCoarseGraph();
+	const FVector end = mVolume->GetLinkPosition(endCell);
+	const float heuristicWeight = mSettings->HeuristicWeight;
+
+	TDPSearchState& state = TDPSearchState::Get();
+	state.Reset(mVolume->GetOctree());
+
+	bool added;
+	int32 current = state.FindOrAdd(startCell, added);
+	state[current].F = (mVolume->GetLinkPosition(startCell) - end).Size() * heuristicWeight;
+	state.PushOpen(current);
+
+	bool found = false;
+
+	while (!state.IsOpenEmpty())
+	{
+		current = state.PopOpen();
+		state[current].Closed = true;
+		++statistics.VisitedNodes;
+
+		if (state[current].Link == endCell)
+		{
+			found = true;
+			break;
+		}
+
+		++statistics.Iterations;
+
+		// cell centers are far apart, the baked distances are the costs
+		const TDPNodeLink currentLink = state[current].Link;
+		const TArrayView<const TDPNodeLink> neighborRow = graph.GetNeighbors(currentLink);
+		const TArrayView<const float> costRow = graph.GetCosts(currentLink);
+
+		for (int32 i = 0; i < neighborRow.Num(); ++i)
+		{
+			const int32 slot = state.FindOrAdd(neighborRow[i], added);
+
+			if (state[slot].Closed)
+			{
+				continue;
+			}
+
+			const float pathCost = state[current].G + costRow[i];
+			auto& neighborNode = state[slot];
+
+			if (added)
+			{
+				neighborNode.G = pathCost;
+				neighborNode.F = pathCost + (mVolume->GetLinkPosition(neighborRow[i]) - end).Size() * heuristicWeight;
+				neighborNode.Parent = current;
+				state.PushOpen(slot);
+			}
+			else if (pathCost < neighborNode.G)
+			{
+				neighborNode.F = pathCost + (neighborNode.F - neighborNode.G);
+				neighborNode.G = pathCost;
+				neighborNode.Parent = current;
+				state.DecreaseOpen(slot);
+			}
+		}
+	}
+
+	statistics.FrontierNodes = state.GetTotalOpen();
+
+	if (!found)
+	{
+		return false;
+	}
+
+	statistics.Cost = state[current].G;
+
+	// the route and the cells next to it
+	for (int32 slot = current; slot != TDPSearchState::InvalidSlot; slot = state[slot].Parent)
+	{
+		const TDPNodeLink& cell = state[slot].Link;
+		corridor.Add(cell);
+
+		for (const auto& neighbor : graph.GetNeighbors(cell))
+		{
+			corridor.Add(neighbor);
+		}
+	}
+
+	return true;
+}
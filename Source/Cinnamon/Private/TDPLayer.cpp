@@ -0,0 +1,435 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TDPLayer.h"
+#include "libmorton/include/morton.h"
+
+
+int32 TDPLayer::Num() const
+{
+	return mMapped ? mMappedMortonCodes.Num() : mMortonCodes.Num();
+}
+
+void TDPLayer::Reserve(int32 number)
+{
+	mMortonCodes.Reserve(number);
+	mParents.Reserve(number);
+	mFirstChildren.Reserve(number);
+	mNeighbors.Reserve(number * 6);
+}
+
+void TDPLayer::SetNum(int32 number)
+{
+	check(!mCompact && !mMapped);
+	mLookup.Reset();
+	mPositions.Reset();
+
+	mMortonCodes.SetNumZeroed(number);
+	mParents.SetNum(number);
+	mFirstChildren.SetNum(number);
+	mNeighbors.SetNum(number * 6);
+}
+
+void TDPLayer::Reset()
+{
+	mMortonCodes.Reset();
+	mParents.Reset();
+	mFirstChildren.Reset();
+	mNeighbors.Reset();
+	mChildMask.Reset();
+	mCompact = false;
+	mLookup.Reset();
+	mPositions.Reset();
+
+	mMappedMortonCodes = TArrayView<const MortonCodeType>();
+	mMappedParents = TArrayView<const TDPNodeLink>();
+	mMappedFirstChildren = TArrayView<const TDPNodeLink>();
+	mMappedNeighbors = TArrayView<const TDPNodeLink>();
+	mMapped = false;
+}
+
+NodeIndexType TDPLayer::Add(MortonCodeType code)
+{
+	check(!mCompact && !mMapped);
+	mLookup.Reset();
+	mPositions.Reset();
+
+	mParents.AddDefaulted();
+	mFirstChildren.AddDefaulted();
+	mNeighbors.AddDefaulted(6);
+
+	return mMortonCodes.Add(code);
+}
+
+NodeIndexType TDPLayer::Add(const TDPLayer& other, NodeIndexType index)
+{
+	check(!mCompact && !mMapped && !other.mCompact);
+	mLookup.Reset();
+	mPositions.Reset();
+
+	mParents.Add(other.GetParent(index));
+	mFirstChildren.Add(other.GetFirstChild(index));
+	mNeighbors.Append(other.GetNeighbors(index), 6);
+
+	return mMortonCodes.Add(other.GetMortonCode(index));
+}
+
+void TDPLayer::InsertDefaulted(NodeIndexType index, int32 count)
+{
+	check(!mCompact && !mMapped);
+	mLookup.Reset();
+	mPositions.Reset();
+
+	mMortonCodes.InsertZeroed(index, count);
+	mParents.InsertDefaulted(index, count);
+	mFirstChildren.InsertDefaulted(index, count);
+	mNeighbors.InsertDefaulted(index * 6, count * 6);
+}
+
+void TDPLayer::RemoveAt(NodeIndexType index, int32 count)
+{
+	check(!mCompact && !mMapped);
+	mLookup.Reset();
+	mPositions.Reset();
+
+	mMortonCodes.RemoveAt(index, count);
+	mParents.RemoveAt(index, count);
+	mFirstChildren.RemoveAt(index, count);
+	mNeighbors.RemoveAt(index * 6, count * 6);
+}
+
+TDPNode TDPLayer::operator[](NodeIndexType index)
+{
+	return TDPNode(*this, index);
+}
+
+TDPConstNode TDPLayer::operator[](NodeIndexType index) const
+{
+	return TDPConstNode(*this, index);
+}
+
+TArrayView<const MortonCodeType> TDPLayer::GetMortonCodes() const
+{
+	return mMapped ? mMappedMortonCodes : TArrayView<const MortonCodeType>(mMortonCodes);
+}
+
+TArrayView<const TDPNodeLink> TDPLayer::GetParentLinks() const
+{
+	return mMapped ? mMappedParents : TArrayView<const TDPNodeLink>(mParents);
+}
+
+TArrayView<const TDPNodeLink> TDPLayer::GetFirstChildLinks() const
+{
+	return mMapped ? mMappedFirstChildren : TArrayView<const TDPNodeLink>(mFirstChildren);
+}
+
+TArrayView<const TDPNodeLink> TDPLayer::GetNeighborLinks() const
+{
+	return mMapped ? mMappedNeighbors : TArrayView<const TDPNodeLink>(mNeighbors);
+}
+
+MortonCodeType& TDPLayer::GetMortonCode(NodeIndexType index)
+{
+	// mapped data is read only, expand the octree before changing it
+	check(!mMapped);
+	return mMortonCodes[index];
+}
+
+const MortonCodeType& TDPLayer::GetMortonCode(NodeIndexType index) const
+{
+	return mMapped ? mMappedMortonCodes[index] : mMortonCodes[index];
+}
+
+TDPNodeLink& TDPLayer::GetParent(NodeIndexType index)
+{
+	check(!mMapped);
+	return mParents[index];
+}
+
+const TDPNodeLink& TDPLayer::GetParent(NodeIndexType index) const
+{
+	return mMapped ? mMappedParents[index] : mParents[index];
+}
+
+TDPNodeLink& TDPLayer::GetFirstChild(NodeIndexType index)
+{
+	check(!mMapped);
+	return mFirstChildren[index];
+}
+
+const TDPNodeLink& TDPLayer::GetFirstChild(NodeIndexType index) const
+{
+	return mMapped ? mMappedFirstChildren[index] : mFirstChildren[index];
+}
+
+TDPNodeLink* TDPLayer::GetNeighbors(NodeIndexType index)
+{
+	check(!mMapped);
+	return &mNeighbors[index * 6];
+}
+
+const TDPNodeLink* TDPLayer::GetNeighbors(NodeIndexType index) const
+{
+	return mMapped ? &mMappedNeighbors[index * 6] : &mNeighbors[index * 6];
+}
+
+bool TDPLayer::HasChildren(NodeIndexType index) const
+{
+	if (mMapped)
+	{
+		return mMappedFirstChildren[index].IsValid();
+	}
+
+	return mFirstChildren.Num() > 0 ? mFirstChildren[index].IsValid() : mChildMask[index];
+}
+
+bool TDPLayer::IsCompact() const
+{
+	return mCompact;
+}
+
+void TDPLayer::Compact(bool keepFirstChildren)
+{
+	// mapped pages are shared and not on the heap, nothing to gain
+	if (mCompact || mMapped)
+	{
+		return;
+	}
+
+	if (!keepFirstChildren)
+	{
+		mChildMask.Init(false, mMortonCodes.Num());
+		for (int32 i = 0; i < mFirstChildren.Num(); ++i)
+		{
+			mChildMask[i] = mFirstChildren[i].IsValid();
+		}
+
+		mFirstChildren.Empty();
+	}
+
+	mParents.Empty();
+	mNeighbors.Empty();
+	mCompact = true;
+}
+
+void TDPLayer::Expand(TArray<TDPNodeLink>&& parents, TArray<TDPNodeLink>&& firstChildren, TArray<TDPNodeLink>&& neighbors)
+{
+	check(parents.Num() == Num() && firstChildren.Num() == Num() && neighbors.Num() == Num() * 6);
+
+	// the links are rebuilt by the caller, only the codes have to leave the mapped file
+	if (mMapped)
+	{
+		mMortonCodes = TArray<MortonCodeType>(mMappedMortonCodes.GetData(), mMappedMortonCodes.Num());
+		mMappedMortonCodes = TArrayView<const MortonCodeType>();
+		mMappedParents = TArrayView<const TDPNodeLink>();
+		mMappedFirstChildren = TArrayView<const TDPNodeLink>();
+		mMappedNeighbors = TArrayView<const TDPNodeLink>();
+		mMapped = false;
+	}
+
+	mParents = MoveTemp(parents);
+	mFirstChildren = MoveTemp(firstChildren);
+	mNeighbors = MoveTemp(neighbors);
+	mChildMask.Empty();
+	mCompact = false;
+}
+
+bool TDPLayer::HasLookup() const
+{
+	return mLookup.Num() > 0;
+}
+
+void TDPLayer::BuildLookup()
+{
+	const int32 num = Num();
+	if (num == 0)
+	{
+		mLookup.Reset();
+		return;
+	}
+
+	// at most 3/4 full keeps the probes short
+	const uint32 capacity = FMath::RoundUpToPowerOfTwo(static_cast<uint32>(num) + num / 3 + 1);
+	mLookupShift = 64 - FMath::FloorLog2(capacity);
+	mLookup.Init({ 0, INDEX_NONE }, capacity);
+
+	// mapped layers keep their codes in the navdata file
+	const TArrayView<const MortonCodeType> codes = GetMortonCodes();
+
+	for (NodeIndexType i = 0; i < num; ++i)
+	{
+		const MortonCodeType code = codes[i];
+		uint32 slot = static_cast<uint32>((code * 0x9E3779B97F4A7C15ULL) >> mLookupShift);
+
+		while (mLookup[slot].Index != INDEX_NONE)
+		{
+			slot = (slot + 1) & (capacity - 1);
+		}
+
+		mLookup[slot] = { code, i };
+	}
+}
+
+void TDPLayer::ClearLookup()
+{
+	mLookup.Empty();
+}
+
+bool TDPLayer::FindNodeIndex(MortonCodeType code, NodeIndexType& index) const
+{
+	const uint32 mask = mLookup.Num() - 1;
+	uint32 slot = static_cast<uint32>((code * 0x9E3779B97F4A7C15ULL) >> mLookupShift);
+
+	while (mLookup[slot].Index != INDEX_NONE)
+	{
+		if (mLookup[slot].Code == code)
+		{
+			index = mLookup[slot].Index;
+			return true;
+		}
+
+		slot = (slot + 1) & mask;
+	}
+
+	return false;
+}
+
+bool TDPLayer::HasPositions() const
+{
+	return mPositions.Num() > 0;
+}
+
+void TDPLayer::BuildPositions(const FVector& origin, float voxelSize)
+{
+	const int32 num = Num();
+	mPositions.SetNumUninitialized(num);
+
+	const TArrayView<const MortonCodeType> codes = GetMortonCodes();
+
+	for (NodeIndexType i = 0; i < num; ++i)
+	{
+		uint_fast32_t x, y, z;
+		libmorton::morton3D_64_decode(codes[i], x, y, z);
+		mPositions[i] = origin + voxelSize * FVector(x, y, z) + FVector(voxelSize / 2);
+	}
+}
+
+void TDPLayer::ClearPositions()
+{
+	mPositions.Empty();
+}
+
+const FVector& TDPLayer::GetPosition(NodeIndexType index) const
+{
+	return mPositions[index];
+}
+
+bool TDPLayer::IsMapped() const
+{
+	return mMapped;
+}
+
+void TDPLayer::Map(TArrayView<const MortonCodeType> codes, TArrayView<const TDPNodeLink> parents, TArrayView<const TDPNodeLink> firstChildren, TArrayView<const TDPNodeLink> neighbors)
+{
+	check(parents.Num() == codes.Num() && firstChildren.Num() == codes.Num() && neighbors.Num() == codes.Num() * 6);
+
+	Reset();
+
+	mMappedMortonCodes = codes;
+	mMappedParents = parents;
+	mMappedFirstChildren = firstChildren;
+	mMappedNeighbors = neighbors;
+	mMapped = true;
+}
+
+bool TDPLayer::SerializeBulk(FArchive& Ar)
+{
+	check(!mCompact && !mMapped);
+
+	int32 num = Num();
+	Ar << num;
+
+	// codes are sorted, the deltas between neighbors fit in one or two bytes as varints
+	TArray<uint8> codes;
+
+	if (Ar.IsSaving())
+	{
+		codes.Reserve(num * 2);
+
+		MortonCodeType previous = 0;
+		for (MortonCodeType code : mMortonCodes)
+		{
+			uint64 delta = code - previous;
+			previous = code;
+
+			do
+			{
+				codes.Add(static_cast<uint8>(delta & 0x7F) | (delta >= 0x80 ? 0x80 : 0));
+				delta >>= 7;
+			} while (delta > 0);
+		}
+	}
+
+	Ar << codes;
+
+	const int64 linkBytes = static_cast<int64>(num) * 8 * sizeof(TDPNodeLink);
+
+	if (Ar.IsLoading())
+	{
+		if (num < 0 || num > codes.Num() || linkBytes > Ar.TotalSize() - Ar.Tell())
+		{
+			return false;
+		}
+
+		SetNum(num);
+
+		MortonCodeType previous = 0;
+		int32 byte = 0;
+		for (int32 i = 0; i < num; ++i)
+		{
+			uint64 delta = 0;
+			int32 shift = 0;
+
+			do
+			{
+				if (byte == codes.Num() || shift > 63)
+				{
+					return false;
+				}
+
+				delta |= static_cast<uint64>(codes[byte] & 0x7F) << shift;
+				shift += 7;
+			} while (codes[byte++] & 0x80);
+
+			previous += delta;
+			mMortonCodes[i] = previous;
+		}
+	}
+
+	// parent, first child and 6 neighbors per node
+	Ar.Serialize(mParents.GetData(), num * sizeof(TDPNodeLink));
+	Ar.Serialize(mFirstChildren.GetData(), num * sizeof(TDPNodeLink));
+	Ar.Serialize(mNeighbors.GetData(), num * 6 * sizeof(TDPNodeLink));
+
+	return !Ar.IsError();
+}
+
+uint64 TDPLayer::MemoryUsage() const
+{
+	const uint64 caches = static_cast<uint64>(mLookup.Num()) * sizeof(FLookupSlot) + static_cast<uint64>(mPositions.Num()) * sizeof(FVector);
+
+	if (mMapped)
+	{
+		return caches + static_cast<uint64>(mMappedMortonCodes.Num()) * sizeof(MortonCodeType) +
+			(static_cast<uint64>(mMappedParents.Num()) + mMappedFirstChildren.Num() + mMappedNeighbors.Num()) * sizeof(TDPNodeLink);
+	}
+
+	return caches + static_cast<uint64>(mMortonCodes.Num()) * sizeof(MortonCodeType) +
+		(static_cast<uint64>(mParents.Num()) + mFirstChildren.Num() + mNeighbors.Num()) * sizeof(TDPNodeLink) + (mChildMask.Num() + 7) / 8;
+}
+
+SIZE_T TDPLayer::GetAllocatedSize() const
+{
+	return mMortonCodes.GetAllocatedSize() + mParents.GetAllocatedSize() + mFirstChildren.GetAllocatedSize() + mNeighbors.GetAllocatedSize() +
+		mChildMask.GetAllocatedSize() + mLookup.GetAllocatedSize() + mPositions.GetAllocatedSize();
+}
@@ -0,0 +1,144 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TDPLazyThetaStar.h"
+#include "TDPSearchState.h"
+
+
+TDPLazyThetaStar::TDPLazyThetaStar(const ATDPVolume& volume, ETDPHeuristic heuristic, const FTDPPathFinderSettings& settings) :
+	IPathFinder(volume, *PathHelper::Heuristics.Find(heuristic), settings), mHeuristicType(heuristic)
+{
+}
+
+void TDPLazyThetaStar::FindPath(const TDPNodeLink startLink, const TDPNodeLink endLink, const FVector& startPosition, const FVector& endPosition, TDPNavigationPath& path) const
+{
+	TDPSearchState& state = TDPSearchState::Get();
+	state.Reset(mVolume->GetOctree());
+
+	TArray<TDPNodeLink>& neighbors = state.GetNeighbors();
+	const FVector end = mVolume->GetLinkPosition(endLink);
+	const float heuristicWeight = mSettings->HeuristicWeight;
+
+	// costs are plain distances without the layer compensation, a shortcut is never more expensive than the nodes it skips
+	auto heuristic = [this, &end, heuristicWeight](const FVector& position)
+	{
+		return PathHelper::GetDistance(mHeuristicType, position, end) * heuristicWeight;
+	};
+
+	bool added;
+	int32 current = state.FindOrAdd(startLink, added);
+	state[current].F = heuristic(mVolume->GetLinkPosition(startLink));
+	state.PushOpen(current);
+
+	uint32 iterations = 0;
+	int32 visitedNodes = 0;
+	bool found = false;
+
+	while (!state.IsOpenEmpty())
+	{
+		current = state.PopOpen();
+		state[current].Closed = true;
+		++visitedNodes;
+
+		SetVertex(state, current);
+
+		if (state[current].Link == endLink)
+		{
+			found = true;
+			break;
+		}
+
+		++iterations;
+
+		const TDPNodeLink currentLink = state[current].Link;
+		if (!mVolume->GetNodeFromLink(currentLink).IsValid())
+		{
+			continue;
+		}
+
+		// neighbors are relaxed through the parent of the current node, line of sight is assumed until expanded
+		const int32 parent = state[current].Parent != TDPSearchState::InvalidSlot ? state[current].Parent : current;
+		const FVector parentPosition = mVolume->GetLinkPosition(state[parent].Link);
+		const TArrayView<const TDPNodeLink> neighborRow = GetNeighbors(currentLink, neighbors);
+
+		for (const auto& neighbor : neighborRow)
+		{
+			// slots are looked up again after adding, a new subnode block can move the others
+			const int32 slot = state.FindOrAdd(neighbor, added);
+
+			if (state[slot].Closed)
+			{
+				continue;
+			}
+
+			const FVector position = mVolume->GetLinkPosition(neighbor);
+			const float pathCost = state[parent].G + (position - parentPosition).Size();
+			auto& neighborNode = state[slot];
+
+			if (added)
+			{
+				neighborNode.G = pathCost;
+				neighborNode.F = pathCost + heuristic(position);
+				neighborNode.Parent = parent;
+				neighborNode.Expander = current;
+				state.PushOpen(slot);
+			}
+			else if (pathCost < neighborNode.G)
+			{
+				neighborNode.F = pathCost + (neighborNode.F - neighborNode.G);
+				neighborNode.G = pathCost;
+				neighborNode.Parent = parent;
+				neighborNode.Expander = current;
+				state.DecreaseOpen(slot);
+			}
+		}
+	}
+
+	const int32 frontierNodes = state.GetTotalOpen();
+
+	auto& statistics = path.GetStatistics();
+	statistics.Iterations = iterations;
+	statistics.VisitedNodes = visitedNodes;
+	statistics.FrontierNodes = frontierNodes;
+
+	if (found)
+	{
+		statistics.Cost = state[current].G;
+		BuildPath(state, current, startPosition, endPosition, path);
+#if WITH_EDITOR
+		UE_LOG(CinnamonLog, Display, TEXT("Lazy Theta* complete, iterations: %i"), iterations);
+		UE_LOG(CinnamonLog, Display, TEXT("Lazy Theta* complete, visited nodes: %i"), visitedNodes);
+		UE_LOG(CinnamonLog, Display, TEXT("Lazy Theta* complete, frontier: %i"), frontierNodes);
+		UE_LOG(CinnamonLog, Display, TEXT("Lazy Theta* complete, path length: %i"), path.GetPath().Num());
+		UE_LOG(CinnamonLog, Display, TEXT("Lazy Theta* complete, path cost: %f"), statistics.Cost);
+#endif
+		return;
+	}
+
+#if WITH_EDITOR
+	UE_LOG(CinnamonLog, Warning, TEXT("Lazy Theta* failed, iterations: %i"), iterations);
+	UE_LOG(CinnamonLog, Warning, TEXT("Lazy Theta* failed, visited nodes: %i"), visitedNodes);
+	UE_LOG(CinnamonLog, Warning, TEXT("Lazy Theta* failed, frontier: %i"), frontierNodes);
+#endif
+}
+
+void TDPLazyThetaStar::SetVertex(TDPSearchState& state, int32 slot) const
+{
+	auto& node = state[slot];
+
+	if (node.Parent == TDPSearchState::InvalidSlot || node.Expander == TDPSearchState::InvalidSlot)
+	{
+		return;
+	}
+
+	const FVector position = mVolume->GetLinkPosition(node.Link);
+	if (mVolume->HasLineOfSight(mVolume->GetLinkPosition(state[node.Parent].Link), position))
+	{
+		return;
+	}
+
+	// the expander is a closed neighbor, the edge to it is always free
+	const auto& expander = state[node.Expander];
+	node.Parent = node.Expander;
+	node.G = expander.G + (position - mVolume->GetLinkPosition(expander.Link)).Size();
+}
@@ -0,0 +1,45 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TDPMemoryReport.h"
+
+
+uint64 TDPMemoryReport::GetUsedBytes() const
+{
+	uint64 result = LeafUsedBytes + PortalBytes + HalfSizeCacheBytes + GraphBytes;
+
+	for (const auto& layer : Layers)
+	{
+		result += layer.UsedBytes;
+	}
+
+	return result;
+}
+
+uint64 TDPMemoryReport::GetAllocatedBytes() const
+{
+	uint64 result = LeafAllocatedBytes + PortalBytes + HalfSizeCacheBytes + GraphBytes;
+
+	for (const auto& layer : Layers)
+	{
+		result += layer.AllocatedBytes;
+	}
+
+	return result;
+}
+
+FString TDPMemoryReport::ToString() const
+{
+	FString result = FString::Printf(TEXT("Used: %llu Bytes, Allocated: %llu Bytes, Generation Peak: %llu Bytes\n"), GetUsedBytes(), GetAllocatedBytes(), GenerationPeakBytes);
+
+	for (int32 i = 0; i < Layers.Num(); ++i)
+	{
+		result += FString::Printf(TEXT("Layer %d: %d Nodes, Used: %llu Bytes, Allocated: %llu Bytes\n"), i, Layers[i].Nodes, Layers[i].UsedBytes, Layers[i].AllocatedBytes);
+	}
+
+	result += FString::Printf(TEXT("Leaves: %d (%d Free), Used: %llu Bytes, Allocated: %llu Bytes\n"), LeafNodes, FreeLeafNodes, LeafUsedBytes, LeafAllocatedBytes);
+	result += FString::Printf(TEXT("Leaf Occupancy: %d Empty, %d Partial, %d Full\n"), EmptyLeaves, PartialLeaves, FullLeaves);
+	result += FString::Printf(TEXT("Portals: %llu Bytes, Half Size Cache: %llu Bytes, Graph: %llu Bytes"), PortalBytes, HalfSizeCacheBytes, GraphBytes);
+
+	return result;
+}
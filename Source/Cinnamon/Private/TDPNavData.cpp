@@ -0,0 +1,241 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TDPNavData.h"
+#include "TDPTree.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFilemanager.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+
+
+// the file is read in place, every element has to keep its size on every platform
+static_assert(sizeof(MortonCodeType) == 8 && sizeof(TDPLeafNode) == 8, "navdata sections need fixed size elements");
+
+// "TDPN"
+const uint32 TDPNavData::Magic = 0x4E504454;
+const uint32 TDPNavData::Version = 2;
+
+bool TDPNavData::Write(const FString& filename, const TDPTree& octree, const TArray<float>& layerHalfSizes, const FVector& origin, const FVector& extents)
+{
+	// links are always stored, compact and mapped octrees are written from an expanded copy
+	if (octree.IsCompact() || octree.IsMapped())
+	{
+		TDPTree expanded = octree;
+		expanded.Expand();
+		return Write(filename, expanded, layerHalfSizes, origin, extents);
+	}
+
+	FHeader header;
+	FMemory::Memzero(header);
+	header.Magic = Magic;
+	header.Version = Version;
+	header.LinkSize = sizeof(TDPNodeLink);
+	header.TotalLayers = octree.Layers.Num();
+	header.Origin = origin;
+	header.Extents = extents;
+
+	TArray<FLayer> layers;
+	layers.SetNumZeroed(octree.Layers.Num());
+
+	// lay out every section first, the data is then written in one go
+	uint64 offset = Align(sizeof(FHeader) + layers.Num() * sizeof(FLayer), Alignment);
+	auto addSection = [&offset](FSection& section, int32 num, uint64 elementSize)
+	{
+		section.Offset = offset;
+		section.Num = num;
+		offset = Align(offset + num * elementSize, Alignment);
+	};
+
+	for (int32 layer = 0; layer < octree.Layers.Num(); ++layer)
+	{
+		const int32 nodes = octree.Layers[layer].Num();
+		addSection(layers[layer].MortonCodes, nodes, sizeof(MortonCodeType));
+		addSection(layers[layer].Parents, nodes, sizeof(TDPNodeLink));
+		addSection(layers[layer].FirstChildren, nodes, sizeof(TDPNodeLink));
+		addSection(layers[layer].Neighbors, nodes * 6, sizeof(TDPNodeLink));
+	}
+
+	addSection(header.LeafNodes, octree.LeafNodes.Num(), sizeof(TDPLeafNode));
+	addSection(header.LayerHalfSizes, layerHalfSizes.Num(), sizeof(float));
+	header.FileSize = offset;
+
+	TUniquePtr<FArchive> writer(IFileManager::Get().CreateFileWriter(*filename));
+	if (!writer)
+	{
+		return false;
+	}
+
+	uint8 padding[Alignment] = {};
+	auto writeSection = [&writer, &padding](const FSection& section, const void* data, uint64 elementSize)
+	{
+		writer->Serialize(padding, section.Offset - writer->Tell());
+		writer->Serialize(const_cast<void*>(data), section.Num * elementSize);
+	};
+
+	writer->Serialize(&header, sizeof(FHeader));
+	writer->Serialize(layers.GetData(), layers.Num() * sizeof(FLayer));
+
+	for (int32 layer = 0; layer < octree.Layers.Num(); ++layer)
+	{
+		const auto& octreeLayer = octree.Layers[layer];
+		writeSection(layers[layer].MortonCodes, octreeLayer.GetMortonCodes().GetData(), sizeof(MortonCodeType));
+		writeSection(layers[layer].Parents, octreeLayer.GetParentLinks().GetData(), sizeof(TDPNodeLink));
+		writeSection(layers[layer].FirstChildren, octreeLayer.GetFirstChildLinks().GetData(), sizeof(TDPNodeLink));
+		writeSection(layers[layer].Neighbors, octreeLayer.GetNeighborLinks().GetData(), sizeof(TDPNodeLink));
+	}
+
+	writeSection(header.LeafNodes, octree.LeafNodes.GetData(), sizeof(TDPLeafNode));
+	writeSection(header.LayerHalfSizes, layerHalfSizes.GetData(), sizeof(float));
+	writer->Serialize(padding, header.FileSize - writer->Tell());
+
+	return writer->Close();
+}
+
+TSharedPtr<TDPNavData> TDPNavData::Map(const FString& filename)
+{
+	TSharedPtr<TDPNavData> navData = MakeShareable(new TDPNavData());
+
+	navData->mFileHandle = FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*filename);
+	if (navData->mFileHandle)
+	{
+		navData->mFileRegion = navData->mFileHandle->MapRegion();
+	}
+
+	if (navData->mFileRegion)
+	{
+		navData->mData = navData->mFileRegion->GetMappedPtr();
+		navData->mSize = navData->mFileRegion->GetMappedSize();
+	}
+	else if (FFileHelper::LoadFileToArray(navData->mFileData, *filename, FILEREAD_Silent))
+	{
+		navData->mData = navData->mFileData.GetData();
+		navData->mSize = navData->mFileData.Num();
+	}
+	else
+	{
+		return nullptr;
+	}
+
+	if (!navData->Validate())
+	{
+		return nullptr;
+	}
+
+	return navData;
+}
+
+TDPNavData::~TDPNavData()
+{
+	// the region has to go before the file it maps
+	delete mFileRegion;
+	delete mFileHandle;
+}
+
+int32 TDPNavData::GetTotalLayers() const
+{
+	return reinterpret_cast<const FHeader*>(mData)->TotalLayers;
+}
+
+const FVector& TDPNavData::GetOrigin() const
+{
+	return reinterpret_cast<const FHeader*>(mData)->Origin;
+}
+
+const FVector& TDPNavData::GetExtents() const
+{
+	return reinterpret_cast<const FHeader*>(mData)->Extents;
+}
+
+TArrayView<const MortonCodeType> TDPNavData::GetMortonCodes(LayerIndexType layer) const
+{
+	return GetSection<MortonCodeType>(GetLayer(layer).MortonCodes);
+}
+
+TArrayView<const TDPNodeLink> TDPNavData::GetParents(LayerIndexType layer) const
+{
+	return GetSection<TDPNodeLink>(GetLayer(layer).Parents);
+}
+
+TArrayView<const TDPNodeLink> TDPNavData::GetFirstChildren(LayerIndexType layer) const
+{
+	return GetSection<TDPNodeLink>(GetLayer(layer).FirstChildren);
+}
+
+TArrayView<const TDPNodeLink> TDPNavData::GetNeighbors(LayerIndexType layer) const
+{
+	return GetSection<TDPNodeLink>(GetLayer(layer).Neighbors);
+}
+
+TArrayView<const TDPLeafNode> TDPNavData::GetLeafNodes() const
+{
+	return GetSection<TDPLeafNode>(reinterpret_cast<const FHeader*>(mData)->LeafNodes);
+}
+
+TArrayView<const float> TDPNavData::GetLayerHalfSizes() const
+{
+	return GetSection<float>(reinterpret_cast<const FHeader*>(mData)->LayerHalfSizes);
+}
+
+int64 TDPNavData::GetSize() const
+{
+	return mSize;
+}
+
+bool TDPNavData::Validate() const
+{
+	if (mSize < static_cast<int64>(sizeof(FHeader)))
+	{
+		return false;
+	}
+
+	// a file from another version, link width or a truncated one is rejected, the caller falls back to generating
+	const FHeader& header = *reinterpret_cast<const FHeader*>(mData);
+	if (header.Magic != Magic || header.Version != Version || header.LinkSize != sizeof(TDPNodeLink) || header.FileSize != static_cast<uint64>(mSize))
+	{
+		return false;
+	}
+
+	if (header.TotalLayers >= INVALID_LAYER_INDEX || sizeof(FHeader) + header.TotalLayers * sizeof(FLayer) > static_cast<uint64>(mSize))
+	{
+		return false;
+	}
+
+	for (LayerIndexType layer = 0; layer < header.TotalLayers; ++layer)
+	{
+		const FLayer& sections = GetLayer(layer);
+		const uint64 nodes = sections.MortonCodes.Num;
+
+		if (!IsSectionValid<MortonCodeType>(sections.MortonCodes) ||
+			!IsSectionValid<TDPNodeLink>(sections.Parents) || sections.Parents.Num != nodes ||
+			!IsSectionValid<TDPNodeLink>(sections.FirstChildren) || sections.FirstChildren.Num != nodes ||
+			!IsSectionValid<TDPNodeLink>(sections.Neighbors) || sections.Neighbors.Num != nodes * 6)
+		{
+			return false;
+		}
+	}
+
+	if (!IsSectionValid<TDPLeafNode>(header.LeafNodes) || !IsSectionValid<float>(header.LayerHalfSizes) || header.LayerHalfSizes.Num != header.TotalLayers)
+	{
+		return false;
+	}
+
+	// leaves are only reached through the first children of layer 0
+	if (header.TotalLayers > 0)
+	{
+		for (const TDPNodeLink& child : GetFirstChildren(0))
+		{
+			if (child.IsValid() && child.NodeIndex >= header.LeafNodes.Num)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+const TDPNavData::FLayer& TDPNavData::GetLayer(LayerIndexType layer) const
+{
+	return reinterpret_cast<const FLayer*>(mData + sizeof(FHeader))[layer];
+}
@@ -9,6 +9,9 @@
 #include "Kismet/GameplayStatics.h"
 #include "DrawDebugHelpers.h"
 #include "TDPAStar.h"
+#include "TDPTiledAStar.h"
+#include "TDPLazyThetaStar.h"
+#include "TDPHierarchicalAStar.h"
 
 // Sets default values for this component's properties
 UTDPNavigationComponent::UTDPNavigationComponent()
@@ -51,17 +54,31 @@ void UTDPNavigationComponent::BeginPlay()
 	Super::BeginPlay();
 
 	if (FindNavigationVolume())
+	{
+		CreatePathFinder();
+	}
+}
+
+void UTDPNavigationComponent::CreatePathFinder()
+{
+	if (!mNavigationPath.IsValid())
 	{
 		mNavigationPath = MakeShared<TDPNavigationPath>();
+	}
 
-		switch (PathFinder)
-		{
-		case ETDPPathFinder::AStar:
-			mPathFinder = MakeShared<TDPAStar>(*mNavigationVolume, *PathHelper::Heuristics.Find(Heuristic), PathFinderSettings);
-			break;
-		default:
-			break;
-		}
+	switch (PathFinder)
+	{
+	case ETDPPathFinder::AStar:
+		mPathFinder = MakeShared<TDPAStar>(*mNavigationVolume, Heuristic, PathFinderSettings);
+		break;
+	case ETDPPathFinder::LazyThetaStar:
+		mPathFinder = MakeShared<TDPLazyThetaStar>(*mNavigationVolume, Heuristic, PathFinderSettings);
+		break;
+	case ETDPPathFinder::HierarchicalAStar:
+		mPathFinder = MakeShared<TDPHierarchicalAStar>(*mNavigationVolume, Heuristic, PathFinderSettings);
+		break;
+	default:
+		break;
 	}
 }
 
@@ -79,28 +96,114 @@ bool UTDPNavigationComponent::HasValidNavigationVolume() const
 
 bool UTDPNavigationComponent::FindNavigationVolume()
 {
-	TArray<AActor*> volumes;
-
-	UGameplayStatics::GetAllActorsOfClass(Cast<UObject>(GetWorld()), ATDPVolume::StaticClass(), volumes);
-
 	FVector position;
 	
 	if (GetPawnPosition(position))
 	{
-		for (auto actor : volumes)
+		if (const ATDPVolume* volume = FindVolumeAt(position))
 		{
-			auto volume = Cast<ATDPVolume>(actor);
-			if (volume && volume->IsPointInside(position))
-			{
-				mNavigationVolume = volume;
-				return true;
-			}
+			mNavigationVolume = volume;
+			return true;
 		}
 	}
 
 	return false;
 }
 
+const ATDPVolume* UTDPNavigationComponent::FindVolumeAt(const FVector& position) const
+{
+	TArray<AActor*> volumes;
+
+	UGameplayStatics::GetAllActorsOfClass(Cast<UObject>(GetWorld()), ATDPVolume::StaticClass(), volumes);
+
+	for (auto actor : volumes)
+	{
+		auto volume = Cast<ATDPVolume>(actor);
+		if (volume && volume->IsPointInside(position))
+		{
+			return volume;
+		}
+	}
+
+	return nullptr;
+}
+
+void UTDPNavigationComponent::UpdateNavigationVolume()
+{
+	FVector position;
+
+	// the pawn may have moved into another tile
+	if (GetPawnPosition(position) && (!HasValidNavigationVolume() || !mNavigationVolume->IsPointInside(position)) && FindNavigationVolume())
+	{
+		CreatePathFinder();
+	}
+}
+
+bool UTDPNavigationComponent::GetTileLinks(const FVector& startPosition, const FVector& targetPosition, TDPTileLink& startLink, TDPTileLink& targetLink) const
+{
+	const ATDPVolume* targetVolume = FindVolumeAt(targetPosition);
+
+	startLink = TDPTileLink(mNavigationVolume);
+	targetLink = TDPTileLink(targetVolume);
+	if (targetVolume == nullptr || !targetVolume->GetTotalLayers() || 
+		!mNavigationVolume->GetLinkFromPosition(startPosition, startLink.Link) || !targetVolume->GetLinkFromPosition(targetPosition, targetLink.Link))
+	{
+#if WITH_EDITOR
+		UE_LOG(CinnamonLog, Error, TEXT("Path finder failed to find navigation links across tiles"));
+#endif
+		return false;
+	}
+
+	return true;
+}
+
+bool UTDPNavigationComponent::FindPathAcrossTiles(const FVector& startPosition, const FVector& targetPosition)
+{
+	TDPTileLink startLink;
+	TDPTileLink targetLink;
+	if (!GetTileLinks(startPosition, targetPosition, startLink, targetLink))
+	{
+		return false;
+	}
+
+	TDPTiledAStar pathFinder(*mNavigationVolume, Heuristic, PathFinderSettings);
+	mNavigationPath->Reset();
+	pathFinder.FindPath(startLink, targetLink, startPosition, targetPosition, *mNavigationPath);
+	mNavigationPath->SetIsReady(true);
+
+	if (DrawPath)
+	{
+		mNavigationPath->DrawDebugVisualization(GetWorld(), *targetLink.Volume);
+	}
+
+	return true;
+}
+
+bool UTDPNavigationComponent::FindPathAcrossTilesAsync(const FVector& startPosition, const FVector& targetPosition, FThreadSafeBool& complete)
+{
+	TDPTileLink startLink;
+	TDPTileLink targetLink;
+	if (!GetTileLinks(startPosition, targetPosition, startLink, targetLink) || !CanFindPathAsync(targetLink.Link))
+	{
+		return false;
+	}
+
+	// portals point into other tiles, the tiles are gathered here where they're streamed and rebuilt
+	TArray<const ATDPVolume*> tiles;
+	TDPTiledAStar::GatherTiles(*mNavigationVolume, tiles);
+
+	mNavigationPath->Reset();
+	mNavigationPaths.Add(mNavigationPath);
+	mNavigationPath = MakeShared<TDPNavigationPath>();
+	mCurrentAsyncTask = MakeShared<FAsyncTask<FindPathTask>>(GetWorld(), tiles, PathFinderSettings, Heuristic, startLink, targetLink, startPosition, targetPosition, *mNavigationPath, complete);
+	mCurrentAsyncTask->StartBackgroundTask();
+	mTasks.Add(mCurrentAsyncTask);
+	mLastTargetLink = targetLink.Link;
+	mMoveRequested = false;
+
+	return true;
+}
+
 
 // Called every frame
 void UTDPNavigationComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
@@ -136,10 +239,17 @@ bool UTDPNavigationComponent::FindPath(const FVector& targetPosition)
 	UE_LOG(CinnamonLog, Log, TEXT("Finding path from %s and %s"), *startPosition.ToString(), *targetPosition.ToString());
 #endif
 
+	UpdateNavigationVolume();
+
 	TDPNodeLink startLink;
 	TDPNodeLink targetLink;
 	if (IsNavigationPossible())
 	{
+		if (!mNavigationVolume->IsPointInside(targetPosition))
+		{
+			return FindPathAcrossTiles(startPosition, targetPosition);
+		}
+
 		// Get the nav link from our volume
 		if (!mNavigationVolume->GetLinkFromPosition(startPosition, startLink))
 		{
@@ -187,10 +297,17 @@ bool UTDPNavigationComponent::FindPathAsync(const FVector& targetPosition, FThre
 	UE_LOG(CinnamonLog, Log, TEXT("Finding path from %s and %s"), *startPosition.ToString(), *targetPosition.ToString());
 #endif
 
+	UpdateNavigationVolume();
+
 	TDPNodeLink startLink;
 	TDPNodeLink targetLink;
 	if (IsNavigationPossible())
 	{
+		if (!mNavigationVolume->IsPointInside(targetPosition))
+		{
+			return FindPathAcrossTilesAsync(startPosition, targetPosition, complete);
+		}
+
 		// Get the nav link from our volume
 		if (!mNavigationVolume->GetLinkFromPosition(startPosition, startLink))
 		{
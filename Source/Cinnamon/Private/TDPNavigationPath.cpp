@@ -80,6 +80,7 @@ void TDPNavigationPath::CreateUENavigationPath(FNavigationPath& path)
 void TDPNavigationPath::Reset()
 {
 	mPath.Reset();
+	mStatistics = TDPPathStatistics();
 	mIsReady = false;
 }
 
@@ -102,3 +103,13 @@ const TArray<TDPPathPoint>& TDPNavigationPath::GetPath() const
 {
 	return mPath;
 }
+
+TDPPathStatistics& TDPNavigationPath::GetStatistics()
+{
+	return mStatistics;
+}
+
+const TDPPathStatistics& TDPNavigationPath::GetStatistics() const
+{
+	return mStatistics;
+}
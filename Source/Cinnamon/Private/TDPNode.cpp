@@ -2,68 +2,129 @@
 
 
 #include "TDPNode.h"
+#include "TDPLayer.h"
 
 TDPNode::TDPNode() : 
-	mMortonCode(0), mParent(TDPNodeLink::InvalidLink), mFirstChild(TDPNodeLink::InvalidLink)
+	mLayer(nullptr), mIndex(INDEX_NONE)
 {
 }
 
+TDPNode::TDPNode(TDPLayer& layer, NodeIndexType index) :
+	mLayer(&layer), mIndex(index)
+{
+}
+
+bool TDPNode::IsValid() const
+{
+	return mLayer != nullptr;
+}
+
+NodeIndexType TDPNode::GetIndex() const
+{
+	return mIndex;
+}
+
 MortonCodeType& TDPNode::GetMortonCode()
 {
-	return mMortonCode;
+	return mLayer->GetMortonCode(mIndex);
 }
 
 const MortonCodeType& TDPNode::GetMortonCode() const
 {
-	return mMortonCode;
+	return mLayer->GetMortonCode(mIndex);
 }
 
 void TDPNode::SetMortonCode(MortonCodeType code)
 {
-	mMortonCode = code;
+	mLayer->GetMortonCode(mIndex) = code;
 }
 
 TDPNodeLink& TDPNode::GetParent()
 {
-	return mParent;
+	return mLayer->GetParent(mIndex);
 }
 
 const TDPNodeLink& TDPNode::GetParent() const
 {
-	return mParent;
+	return mLayer->GetParent(mIndex);
 }
 
 void TDPNode::SetParent(TDPNodeLink node)
 {
-	mParent = node;
+	mLayer->GetParent(mIndex) = node;
 }
 
 TDPNodeLink& TDPNode::GetFirstChild()
 {
-	return mFirstChild;
+	return mLayer->GetFirstChild(mIndex);
 }
 
 const TDPNodeLink& TDPNode::GetFirstChild() const
 {
-	return mFirstChild;
+	return mLayer->GetFirstChild(mIndex);
 }
 
 void TDPNode::SetFirstChild(TDPNodeLink node)
 {
-	mFirstChild = node;
+	mLayer->GetFirstChild(mIndex) = node;
 }
 
 TDPNodeLink* TDPNode::GetNeighbors()
 {
-	return mNeighbors;
+	return mLayer->GetNeighbors(mIndex);
 }
 
 const TDPNodeLink* TDPNode::GetNeighbors() const
 {
-	return mNeighbors;
+	return mLayer->GetNeighbors(mIndex);
 }
 
 bool TDPNode::HasChildren() const
 {
-	return mFirstChild.IsValid();
+	return mLayer->HasChildren(mIndex);
+}
+
+TDPConstNode::TDPConstNode() :
+	mLayer(nullptr), mIndex(INDEX_NONE)
+{
+}
+
+TDPConstNode::TDPConstNode(const TDPLayer& layer, NodeIndexType index) :
+	mLayer(&layer), mIndex(index)
+{
+}
+
+bool TDPConstNode::IsValid() const
+{
+	return mLayer != nullptr;
+}
+
+NodeIndexType TDPConstNode::GetIndex() const
+{
+	return mIndex;
+}
+
+const MortonCodeType& TDPConstNode::GetMortonCode() const
+{
+	return mLayer->GetMortonCode(mIndex);
+}
+
+const TDPNodeLink& TDPConstNode::GetParent() const
+{
+	return mLayer->GetParent(mIndex);
+}
+
+const TDPNodeLink& TDPConstNode::GetFirstChild() const
+{
+	return mLayer->GetFirstChild(mIndex);
+}
+
+const TDPNodeLink* TDPConstNode::GetNeighbors() const
+{
+	return mLayer->GetNeighbors(mIndex);
+}
+
+bool TDPConstNode::HasChildren() const
+{
+	return mLayer->HasChildren(mIndex);
 }
@@ -4,6 +4,7 @@
 #include "TDPNodeLink.h"
 
 const TDPNodeLink TDPNodeLink::InvalidLink{};
+const NodeIndexType TDPNodeLink::MaxNodeIndex = static_cast<NodeIndexType>(FMath::Min<uint64>((1ULL << NODE_LINK_NODE_BITS) - 1, MAX_int32));
 
 TDPNodeLink::TDPNodeLink(LayerIndexType layer, NodeIndexType node, SubnodeIndexType subnode)
 	: LayerIndex(layer), NodeIndex(node), SubnodeIndex(subnode)
@@ -22,7 +23,7 @@ bool TDPNodeLink::operator!=(const TDPNodeLink& other) const
 
 bool TDPNodeLink::operator<(const TDPNodeLink& other) const
 {
-	return *reinterpret_cast<const uint32*>(this) < *reinterpret_cast<const uint32*>(&other);
+	return *reinterpret_cast<const NodeLinkType*>(this) < *reinterpret_cast<const NodeLinkType*>(&other);
 }
 
 void TDPNodeLink::SetLayerIndex(LayerIndexType layer)
@@ -52,5 +53,5 @@ bool TDPNodeLink::IsValid() const
 
 FString TDPNodeLink::ToString() const
 {
-	return FString::Printf(TEXT("NodeLink [Layer: %i, Index: %i, Subindex: %i]"), LayerIndex, NodeIndex, SubnodeIndex);
+	return FString::Printf(TEXT("NodeLink [Layer: %i, Index: %i, Subindex: %i]"), static_cast<int32>(LayerIndex), static_cast<int32>(NodeIndex), static_cast<int32>(SubnodeIndex));
 }
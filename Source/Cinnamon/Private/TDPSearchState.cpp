@@ -0,0 +1,303 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TDPSearchState.h"
+#include "TDPTree.h"
+
+
+TDPSearchState& TDPSearchState::Get()
+{
+	static thread_local TDPSearchState state;
+	return state;
+}
+
+void TDPSearchState::Reset(const TDPTree& octree)
+{
+	const TDPTree* octrees[] = { &octree };
+	Reset(MakeArrayView(octrees));
+}
+
+void TDPSearchState::Reset(TArrayView<const TDPTree* const> octrees)
+{
+	check(octrees.Num() <= MAX_uint16 + 1);
+
+	mOctrees.Reset();
+	mOctrees.Append(octrees.GetData(), octrees.Num());
+
+	// stamps wrapped around, clear them once so old slots can't look visited
+	if (++mGeneration == 0)
+	{
+		for (auto& node : mNodes)
+		{
+			node.Generation = 0;
+		}
+
+		for (auto& node : mSubnodes)
+		{
+			node.Generation = 0;
+		}
+
+		FMemory::Memzero(mSubnodeBlockGenerations.GetData(), mSubnodeBlockGenerations.Num() * sizeof(uint32));
+		mGeneration = 1;
+	}
+
+	mTileLayers.Reset();
+	mTileLeaves.Reset();
+	mLayerSlots.Reset();
+
+	int32 totalSlots = 0;
+	int32 leafLayerNodes = 0;
+	for (const TDPTree* octree : octrees)
+	{
+		mTileLayers.Add(mLayerSlots.Num());
+		mTileLeaves.Add(leafLayerNodes);
+
+		for (int32 layer = 0; layer < octree->Layers.Num(); ++layer)
+		{
+			mLayerSlots.Add(totalSlots);
+			totalSlots += octree->Layers[layer].Num();
+		}
+
+		leafLayerNodes += octree->Layers.Num() > 0 ? octree->Layers[0].Num() : 0;
+	}
+
+	// arrays never shrink, slots left over from a bigger octree keep their older stamps
+	if (mNodes.Num() < totalSlots)
+	{
+		const int32 previous = mNodes.Num();
+		mNodes.SetNumUninitialized(totalSlots, false);
+
+		for (int32 i = previous; i < totalSlots; ++i)
+		{
+			mNodes[i].Generation = 0;
+		}
+	}
+
+	if (mSubnodeBlocks.Num() < leafLayerNodes)
+	{
+		mSubnodeBlocks.SetNumUninitialized(leafLayerNodes, false);
+		mSubnodeBlockGenerations.SetNumZeroed(leafLayerNodes, false);
+	}
+
+	mUsedSubnodes = 0;
+	mOpen.Reset();
+	mNeighbors.Reset();
+}
+
+int32 TDPSearchState::FindOrAdd(const TDPNodeLink& link, bool& added)
+{
+	return FindOrAdd(0, link, added);
+}
+
+int32 TDPSearchState::FindOrAdd(uint16 tile, const TDPNodeLink& link, bool& added)
+{
+	int32 slot;
+	FNode* node;
+
+	if (IsSubnode(tile, link))
+	{
+		const int32 leaf = mTileLeaves[tile] + link.NodeIndex;
+
+		// first subnode of this leaf reached in the query, hand out the next block
+		if (mSubnodeBlockGenerations[leaf] != mGeneration)
+		{
+			mSubnodeBlockGenerations[leaf] = mGeneration;
+			mSubnodeBlocks[leaf] = mUsedSubnodes;
+			mUsedSubnodes += 64;
+
+			if (mSubnodes.Num() < mUsedSubnodes)
+			{
+				const int32 previous = mSubnodes.Num();
+				mSubnodes.SetNumUninitialized(mUsedSubnodes, false);
+
+				for (int32 i = previous; i < mUsedSubnodes; ++i)
+				{
+					mSubnodes[i].Generation = 0;
+				}
+			}
+		}
+
+		const int32 index = mSubnodeBlocks[leaf] + link.SubnodeIndex;
+		slot = mNodes.Num() + index;
+		node = &mSubnodes[index];
+	}
+	else
+	{
+		slot = mLayerSlots[mTileLayers[tile] + link.LayerIndex] + link.NodeIndex;
+		node = &mNodes[slot];
+	}
+
+	added = node->Generation != mGeneration;
+
+	if (added)
+	{
+		node->Link = link;
+		node->Parent = InvalidSlot;
+		node->Expander = InvalidSlot;
+		node->G = 0.0f;
+		node->F = 0.0f;
+		node->HeapIndex = INDEX_NONE;
+		node->Generation = mGeneration;
+		node->Tile = tile;
+		node->Closed = false;
+	}
+
+	return slot;
+}
+
+int32 TDPSearchState::Find(const TDPNodeLink& link) const
+{
+	return Find(0, link);
+}
+
+int32 TDPSearchState::Find(uint16 tile, const TDPNodeLink& link) const
+{
+	int32 slot;
+
+	if (IsSubnode(tile, link))
+	{
+		const int32 leaf = mTileLeaves[tile] + link.NodeIndex;
+		if (mSubnodeBlockGenerations[leaf] != mGeneration)
+		{
+			return InvalidSlot;
+		}
+
+		slot = mNodes.Num() + mSubnodeBlocks[leaf] + link.SubnodeIndex;
+	}
+	else
+	{
+		slot = mLayerSlots[mTileLayers[tile] + link.LayerIndex] + link.NodeIndex;
+	}
+
+	return (*this)[slot].Generation == mGeneration ? slot : InvalidSlot;
+}
+
+TDPSearchState::FNode& TDPSearchState::operator[](int32 slot)
+{
+	// subnode slots come after every layer slot
+	return slot < mNodes.Num() ? mNodes[slot] : mSubnodes[slot - mNodes.Num()];
+}
+
+const TDPSearchState::FNode& TDPSearchState::operator[](int32 slot) const
+{
+	return slot < mNodes.Num() ? mNodes[slot] : mSubnodes[slot - mNodes.Num()];
+}
+
+void TDPSearchState::PushOpen(int32 slot)
+{
+	check((*this)[slot].HeapIndex == INDEX_NONE);
+
+	mOpen.AddUninitialized();
+	SetOpen(mOpen.Num() - 1, FOpenEntry{ (*this)[slot].F, slot });
+	SiftUp(mOpen.Num() - 1);
+}
+
+void TDPSearchState::DecreaseOpen(int32 slot)
+{
+	const int32 index = (*this)[slot].HeapIndex;
+	check(index != INDEX_NONE);
+
+	mOpen[index].F = (*this)[slot].F;
+	SiftUp(index);
+}
+
+int32 TDPSearchState::PopOpen()
+{
+	if (mOpen.Num() == 0)
+	{
+		return InvalidSlot;
+	}
+
+	const int32 slot = mOpen[0].Slot;
+	(*this)[slot].HeapIndex = INDEX_NONE;
+
+	const FOpenEntry last = mOpen.Pop(false);
+	if (mOpen.Num() > 0)
+	{
+		SetOpen(0, last);
+		SiftDown(0);
+	}
+
+	return slot;
+}
+
+bool TDPSearchState::IsOpenEmpty() const
+{
+	return mOpen.Num() == 0;
+}
+
+int32 TDPSearchState::GetTotalOpen() const
+{
+	return mOpen.Num();
+}
+
+TArray<TDPNodeLink>& TDPSearchState::GetNeighbors()
+{
+	return mNeighbors;
+}
+
+SIZE_T TDPSearchState::GetAllocatedSize() const
+{
+	return mOctrees.GetAllocatedSize() + mTileLayers.GetAllocatedSize() + mTileLeaves.GetAllocatedSize() + mLayerSlots.GetAllocatedSize() + mNodes.GetAllocatedSize() + mSubnodeBlocks.GetAllocatedSize() + mSubnodeBlockGenerations.GetAllocatedSize() +
+		mSubnodes.GetAllocatedSize() + mOpen.GetAllocatedSize() + mNeighbors.GetAllocatedSize();
+}
+
+bool TDPSearchState::IsSubnode(uint16 tile, const TDPNodeLink& link) const
+{
+	return link.LayerIndex == 0 && mOctrees[tile]->HasChildren(link);
+}
+
+void TDPSearchState::SiftUp(int32 index)
+{
+	const FOpenEntry entry = mOpen[index];
+
+	while (index > 0)
+	{
+		const int32 parent = (index - 1) / 2;
+		if (mOpen[parent].F <= entry.F)
+		{
+			break;
+		}
+
+		SetOpen(index, mOpen[parent]);
+		index = parent;
+	}
+
+	SetOpen(index, entry);
+}
+
+void TDPSearchState::SiftDown(int32 index)
+{
+	const FOpenEntry entry = mOpen[index];
+	const int32 num = mOpen.Num();
+
+	while (true)
+	{
+		int32 child = index * 2 + 1;
+		if (child >= num)
+		{
+			break;
+		}
+
+		if (child + 1 < num && mOpen[child + 1].F < mOpen[child].F)
+		{
+			++child;
+		}
+
+		if (entry.F <= mOpen[child].F)
+		{
+			break;
+		}
+
+		SetOpen(index, mOpen[child]);
+		index = child;
+	}
+
+	SetOpen(index, entry);
+}
+
+void TDPSearchState::SetOpen(int32 index, const FOpenEntry& entry)
+{
+	mOpen[index] = entry;
+	(*this)[entry.Slot].HeapIndex = index;
+}
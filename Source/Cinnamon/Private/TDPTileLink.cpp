@@ -0,0 +1,24 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TDPTileLink.h"
+
+TDPTileLink::TDPTileLink(const ATDPVolume* volume, TDPNodeLink link)
+	: Volume(volume), Link(link)
+{
+}
+
+bool TDPTileLink::operator==(const TDPTileLink& other) const
+{
+	return Volume == other.Volume && Link == other.Link;
+}
+
+bool TDPTileLink::operator!=(const TDPTileLink& other) const
+{
+	return !(*this == other);
+}
+
+bool TDPTileLink::IsValid() const
+{
+	return Volume != nullptr && Link.IsValid();
+}
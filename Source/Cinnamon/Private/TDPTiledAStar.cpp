@@ -0,0 +1,201 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TDPTiledAStar.h"
+#include "TDPVolume.h"
+#include "TDPSearchState.h"
+
+
+TDPTiledAStar::TDPTiledAStar(const ATDPVolume& volume, ETDPHeuristic heuristic, const FTDPPathFinderSettings& settings) :
+	IPathFinder(volume, *PathHelper::Heuristics.Find(heuristic), settings), mHeuristicType(heuristic)
+{
+}
+
+void TDPTiledAStar::FindPath(const TDPNodeLink startLink, const TDPNodeLink endLink, const FVector& startPosition, const FVector& endPosition, TDPNavigationPath& path) const
+{
+	FindPath(TDPTileLink(mVolume, startLink), TDPTileLink(mVolume, endLink), startPosition, endPosition, path);
+}
+
+bool TDPTiledAStar::FindPath(const TDPTileLink& startLink, const TDPTileLink& endLink, const FVector& startPosition, const FVector& endPosition, TDPNavigationPath& path) const
+{
+	TArray<const ATDPVolume*> tiles;
+	GatherTiles(*startLink.Volume, tiles);
+
+	return FindPath(tiles, startLink, endLink, startPosition, endPosition, path);
+}
+
+bool TDPTiledAStar::FindPath(TArrayView<const ATDPVolume* const> tiles, const TDPTileLink& startLink, const TDPTileLink& endLink, const FVector& startPosition, const FVector& endPosition, TDPNavigationPath& path) const
+{
+	const int32 startIndex = tiles.IndexOfByKey(startLink.Volume);
+	const int32 endIndex = tiles.IndexOfByKey(endLink.Volume);
+
+	// the end is in a tile that isn't connected to the start
+	if (startIndex == INDEX_NONE || endIndex == INDEX_NONE)
+	{
+#if WITH_EDITOR
+		UE_LOG(CinnamonLog, Warning, TEXT("Tiled pathfinding failed, the end tile isn't connected to the start tile"));
+#endif
+		return false;
+	}
+
+	const uint16 startTile = static_cast<uint16>(startIndex);
+	const uint16 endTile = static_cast<uint16>(endIndex);
+
+	switch (mHeuristicType)
+	{
+	case ETDPHeuristic::EuclideanDistance:
+		return FindPath<PathHelper::FEuclideanDistance>(tiles, startTile, startLink.Link, endTile, endLink.Link, startPosition, endPosition, path);
+	case ETDPHeuristic::OctileDistance:
+		return FindPath<PathHelper::FOctileDistance>(tiles, startTile, startLink.Link, endTile, endLink.Link, startPosition, endPosition, path);
+	default:
+		return FindPath<PathHelper::FManhattanDistance>(tiles, startTile, startLink.Link, endTile, endLink.Link, startPosition, endPosition, path);
+	}
+}
+
+void TDPTiledAStar::GatherTiles(const ATDPVolume& volume, TArray<const ATDPVolume*>& tiles)
+{
+	tiles.Reset();
+	tiles.Add(&volume);
+
+	for (int32 i = 0; i < tiles.Num(); ++i)
+	{
+		for (const ATDPVolume* tile : tiles[i]->GetConnectedTiles())
+		{
+			tiles.AddUnique(tile);
+		}
+	}
+}
+
+template<typename HeuristicType>
+bool TDPTiledAStar::FindPath(TArrayView<const ATDPVolume* const> tiles, uint16 startTile, const TDPNodeLink& startLink, uint16 endTile, const TDPNodeLink& endLink,
+	const FVector& startPosition, const FVector& endPosition, TDPNavigationPath& path) const
+{
+	if (mSettings->UseUnitCost)
+	{
+		return Search<HeuristicType, PathHelper::FUnitCost>(tiles, startTile, startLink, endTile, endLink, startPosition, endPosition, path);
+	}
+
+	return Search<HeuristicType, PathHelper::FDistanceCost>(tiles, startTile, startLink, endTile, endLink, startPosition, endPosition, path);
+}
+
+template<typename HeuristicType, typename CostType>
+struct TDPTiledAStar::FSearchSpace
+{
+	TArrayView<const ATDPVolume* const> Tiles;
+	const TArray<FTileFactors>& Factors;
+	// tiles don't share a morton space, the heuristic compares world positions
+	FVector End;
+	float HeuristicFactor;
+	float UnitCost;
+	TArray<TDPNodeLink>& Neighbors;
+	TArray<TDPTileLink>& Portals;
+
+	float GetHeuristic(uint16 tile, const TDPNodeLink& link) const
+	{
+		return HeuristicType()(Tiles[tile]->GetLinkPosition(link), End) * HeuristicFactor;
+	}
+
+	template<typename VisitorType>
+	void ForEachNeighbor(uint16 tile, const TDPNodeLink& link, const VisitorType& visit) const
+	{
+		const ATDPVolume& volume = *Tiles[tile];
+		if (!volume.GetNodeFromLink(link).IsValid())
+		{
+			return;
+		}
+
+		const TArrayView<const TDPNodeLink> neighborRow = IPathFinder::GetNeighbors(volume, link, Neighbors);
+		TArrayView<const float> costRow;
+
+		if (CostType::UsesDistance && volume.GetGraph().IsBuilt())
+		{
+			costRow = volume.GetGraph().GetCosts(link);
+		}
+
+		const FVector position = CostType::UsesDistance ? volume.GetLinkPosition(link) : FVector::ZeroVector;
+
+		for (int32 i = 0; i < neighborRow.Num(); ++i)
+		{
+			const auto& neighbor = neighborRow[i];
+
+			float distance = 0.0f;
+			if (CostType::UsesDistance)
+			{
+				distance = costRow.Num() > 0 ? costRow[i] : (volume.GetLinkPosition(neighbor) - position).Size();
+			}
+
+			visit(tile, neighbor, GetCost(tile, neighbor, distance));
+		}
+
+		// portals into tiles that weren't gathered for this query are skipped
+		Portals.Reset();
+		volume.GetPortalNeighborsFromLink(link, Portals);
+
+		for (const auto& portal : Portals)
+		{
+			const int32 portalTile = Tiles.IndexOfByKey(portal.Volume);
+			if (portalTile == INDEX_NONE)
+			{
+				continue;
+			}
+
+			const float distance = CostType::UsesDistance ? (portal.Volume->GetLinkPosition(portal.Link) - position).Size() : 0.0f;
+			visit(static_cast<uint16>(portalTile), portal.Link, GetCost(portalTile, portal.Link, distance));
+		}
+	}
+
+	float GetCost(int32 tile, const TDPNodeLink& link, float distance) const
+	{
+		return CostType()(UnitCost, distance) * Factors[tile].Cost[link.LayerIndex];
+	}
+};
+
+template<typename HeuristicType, typename CostType>
+bool TDPTiledAStar::Search(TArrayView<const ATDPVolume* const> tiles, uint16 startTile, const TDPNodeLink& startLink, uint16 endTile, const TDPNodeLink& endLink,
+	const FVector& startPosition, const FVector& endPosition, TDPNavigationPath& path) const
+{
+	TArray<const TDPTree*> octrees;
+	TArray<FTileFactors> factors;
+	octrees.Reserve(tiles.Num());
+	factors.SetNumUninitialized(tiles.Num());
+
+	for (int32 tile = 0; tile < tiles.Num(); ++tile)
+	{
+		octrees.Add(&tiles[tile]->GetOctree());
+
+		const float totalLayers = static_cast<float>(tiles[tile]->GetTotalLayers());
+		for (int32 layer = 0; layer < INVALID_LAYER_INDEX; ++layer)
+		{
+			factors[tile].Cost[layer] = (1.0f - (layer / totalLayers)) * mSettings->NodeSizeCompensation;
+		}
+	}
+
+	TDPSearchState& state = TDPSearchState::Get();
+	state.Reset(octrees);
+
+	// compensated by the layer of the end, the same for every node of the query
+	TArray<TDPTileLink> portals;
+	const FSearchSpace<HeuristicType, CostType> space{ tiles, factors, tiles[endTile]->GetLinkPosition(endLink), factors[endTile].Cost[endLink.LayerIndex] * mSettings->HeuristicWeight,
+		mSettings->UnitCost, state.GetNeighbors(), portals };
+
+	auto& statistics = path.GetStatistics();
+	const int32 end = state.Search(space, startTile, startLink, endTile, endLink, statistics);
+
+	if (end != TDPSearchState::InvalidSlot)
+	{
+		BuildPath(state, end, tiles, startPosition, endPosition, path);
+#if WITH_EDITOR
+		UE_LOG(CinnamonLog, Display, TEXT("Tiled pathfinding complete, iterations: %i"), statistics.Iterations);
+		UE_LOG(CinnamonLog, Display, TEXT("Tiled pathfinding complete, visited nodes: %i"), statistics.VisitedNodes);
+		UE_LOG(CinnamonLog, Display, TEXT("Tiled pathfinding complete, path length: %i"), path.GetPath().Num());
+#endif
+		return true;
+	}
+
+#if WITH_EDITOR
+	UE_LOG(CinnamonLog, Warning, TEXT("Tiled pathfinding failed, iterations: %i"), statistics.Iterations);
+	UE_LOG(CinnamonLog, Warning, TEXT("Tiled pathfinding failed, visited nodes: %i"), statistics.VisitedNodes);
+#endif
+
+	return false;
+}
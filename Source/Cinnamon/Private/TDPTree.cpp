@@ -2,8 +2,17 @@
 
 
 #include "TDPTree.h"
+#include "TDPNavData.h"
+#include "TDPMemoryReport.h"
+#include "Async/ParallelFor.h"
+#include "Misc/Compression.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/MemoryReader.h"
+#include "libmorton/include/morton.h"
 
 
+const NodeIndexType TDPTree::FullyBlockedLeaf = 0;
+
 int32 TDPTree::GetTotalLayerNodes() const
 {
 	int32 total = 0;
@@ -16,32 +25,597 @@ int32 TDPTree::GetTotalLayerNodes() const
 	return total;
 }
 
-const TArray<TDPNode>& TDPTree::GetLayer(LayerIndexType layer) const
+int32 TDPTree::GetTotalLeafNodes() const
+{
+	return IsMapped() ? mMappedLeafNodes.Num() : LeafNodes.Num() - FreeLeafNodes.Num();
+}
+
+const TDPLeafNode& TDPTree::GetLeafNode(NodeIndexType leaf) const
+{
+	return IsMapped() ? mMappedLeafNodes[leaf] : LeafNodes[leaf];
+}
+
+TArrayView<const TDPLeafNode> TDPTree::GetLeafNodes() const
+{
+	return IsMapped() ? mMappedLeafNodes : TArrayView<const TDPLeafNode>(LeafNodes);
+}
+
+const TDPLayer& TDPTree::GetLayer(LayerIndexType layer) const
 {
 	return Layers[layer];
 }
 
-TArray<TDPNode>& TDPTree::GetLayer(LayerIndexType layer)
+TDPLayer& TDPTree::GetLayer(LayerIndexType layer)
 {
 	return Layers[layer];
 }
 
-int32 TDPTree::MemoryUsage() const
+bool TDPTree::GetNodeIndexFromMortonCode(LayerIndexType layer, MortonCodeType nodeCode, NodeIndexType& index) const
+{
+	const auto& octreeLayer = GetLayer(layer);
+
+	if (octreeLayer.HasLookup())
+	{
+		return octreeLayer.FindNodeIndex(nodeCode, index);
+	}
+
+	return SearchNodeIndex(layer, nodeCode, index);
+}
+
+bool TDPTree::SearchNodeIndex(LayerIndexType layer, MortonCodeType nodeCode, NodeIndexType& index) const
+{
+	// only the codes are read, the links stay out of the cache
+	const auto& codes = GetLayer(layer).GetMortonCodes();
+
+	int32 first = 0;
+	int32 last = codes.Num() - 1;
+	int32 middle = (first + last) / 2;
+
+	// nodes are built in acsending order by morton code so we can do binary search here
+	while (first <= last)
+	{
+		if (codes[middle] < nodeCode)
+		{
+			first = middle + 1;
+		}
+		else if (codes[middle] == nodeCode)
+		{
+			index = middle;
+			return true;
+		}
+		else
+		{
+			last = middle - 1;
+		}
+
+		middle = (first + last) / 2;
+	}
+
+	return false;
+}
+
+NodeIndexType TDPTree::FindInsertIndex(LayerIndexType layer, MortonCodeType code) const
+{
+	const auto& codes = GetLayer(layer).GetMortonCodes();
+
+	int32 first = 0;
+	int32 last = codes.Num() - 1;
+	int32 middle = (first + last) / 2;
+
+	// nodes are built in acsending order by morton code so we can do binary search here
+	while (first <= last)
+	{
+		if (codes[middle] < code)
+		{
+			first = middle + 1;
+		}
+		else
+		{
+			last = middle - 1;
+		}
+
+		middle = (first + last) / 2;
+	}
+
+	return first;
+}
+
+bool TDPTree::HasChildren(const TDPNodeLink& link) const
+{
+	return Layers[link.LayerIndex].HasChildren(link.NodeIndex);
+}
+
+TDPNodeLink TDPTree::GetParentLink(const TDPNodeLink& link) const
+{
+	const auto& layer = Layers[link.LayerIndex];
+
+	if (!layer.IsCompact())
+	{
+		return layer.GetParent(link.NodeIndex);
+	}
+
+	NodeIndexType index;
+	if (link.LayerIndex + 1 < Layers.Num() && GetNodeIndexFromMortonCode(link.LayerIndex + 1, layer.GetMortonCode(link.NodeIndex) >> 3, index))
+	{
+		return TDPNodeLink(link.LayerIndex + 1, index, 0);
+	}
+
+	return TDPNodeLink::InvalidLink;
+}
+
+TDPNodeLink TDPTree::GetFirstChildLink(const TDPNodeLink& link) const
+{
+	const auto& layer = Layers[link.LayerIndex];
+
+	// the leaf layer keeps its first child links when compact, leaves are not stored in node order
+	if (!layer.IsCompact() || link.LayerIndex == 0)
+	{
+		return layer.GetFirstChild(link.NodeIndex);
+	}
+
+	if (!layer.HasChildren(link.NodeIndex))
+	{
+		return TDPNodeLink::InvalidLink;
+	}
+
+	NodeIndexType index;
+	bool result = GetNodeIndexFromMortonCode(link.LayerIndex - 1, layer.GetMortonCode(link.NodeIndex) << 3, index);
+	check(result);
+
+	return TDPNodeLink(link.LayerIndex - 1, index, 0);
+}
+
+TDPNodeLink TDPTree::GetNeighborLink(const TDPNodeLink& link, int32 direction) const
+{
+	const auto& layer = Layers[link.LayerIndex];
+
+	if (!layer.IsCompact())
+	{
+		return layer.GetNeighbors(link.NodeIndex)[direction];
+	}
+
+	return FindNeighborLink(link.LayerIndex, layer.GetMortonCode(link.NodeIndex), direction);
+}
+
+TDPNodeLink TDPTree::FindNeighborLink(LayerIndexType layer, MortonCodeType code, int32 direction) const
+{
+	// same search as the generation, the closest node across the face, going up the layers until one exists
+	for (int32 currentLayer = layer; currentLayer < Layers.Num() - 1; ++currentLayer, code >>= 3)
+	{
+		const int32 maxCoordinate = 1 << (Layers.Num() - 1 - currentLayer);
+
+		uint_fast32_t x, y, z;
+		libmorton::morton3D_64_decode(code, x, y, z);
+
+		const FIntVector position = FIntVector(static_cast<int32>(x), static_cast<int32>(y), static_cast<int32>(z)) + NodeHelper::NeighborDirections[direction];
+
+		if (position.X < 0 || position.X >= maxCoordinate ||
+			position.Y < 0 || position.Y >= maxCoordinate ||
+			position.Z < 0 || position.Z >= maxCoordinate)
+		{
+			return TDPNodeLink::InvalidLink;
+		}
+
+		NodeIndexType index;
+		if (GetNodeIndexFromMortonCode(currentLayer, libmorton::morton3D_64_encode(static_cast<uint_fast32_t>(position.X), static_cast<uint_fast32_t>(position.Y), static_cast<uint_fast32_t>(position.Z)), index))
+		{
+			if (currentLayer == 0 && Layers[0].HasChildren(index) && Layers[0].GetFirstChild(index).NodeIndex == FullyBlockedLeaf)
+			{
+				return TDPNodeLink::InvalidLink;
+			}
+
+			return TDPNodeLink(currentLayer, index, 0);
+		}
+	}
+
+	return TDPNodeLink::InvalidLink;
+}
+
+bool TDPTree::IsCompact() const
+{
+	return Layers.Num() > 0 && Layers[0].IsCompact();
+}
+
+void TDPTree::Compact()
+{
+	for (int32 layer = 0; layer < Layers.Num(); ++layer)
+	{
+		Layers[layer].Compact(layer == 0);
+	}
+}
+
+void TDPTree::Expand()
+{
+	if (!IsCompact() && !IsMapped())
+	{
+		return;
+	}
+
+	// derive every link first, each layer stops answering from its codes once it is expanded
+	TArray<TArray<TDPNodeLink>> parents, firstChildren, neighbors;
+	parents.SetNum(Layers.Num());
+	firstChildren.SetNum(Layers.Num());
+	neighbors.SetNum(Layers.Num());
+
+	for (int32 layer = 0; layer < Layers.Num(); ++layer)
+	{
+		const int32 nodes = Layers[layer].Num();
+		parents[layer].SetNum(nodes);
+		firstChildren[layer].SetNum(nodes);
+		neighbors[layer].SetNum(nodes * 6);
+
+		ParallelFor(nodes, [this, &parents, &firstChildren, &neighbors, layer](int32 i)
+		{
+			const TDPNodeLink link(layer, i, 0);
+			parents[layer][i] = GetParentLink(link);
+			firstChildren[layer][i] = GetFirstChildLink(link);
+
+			for (int32 direction = 0; direction < 6; ++direction)
+			{
+				neighbors[layer][i * 6 + direction] = FindNeighborLink(layer, Layers[layer].GetMortonCodes()[i], direction);
+			}
+		});
+	}
+
+	for (int32 layer = 0; layer < Layers.Num(); ++layer)
+	{
+		Layers[layer].Expand(MoveTemp(parents[layer]), MoveTemp(firstChildren[layer]), MoveTemp(neighbors[layer]));
+	}
+
+	if (IsMapped())
+	{
+		LeafNodes = TArray<TDPLeafNode>(mMappedLeafNodes.GetData(), mMappedLeafNodes.Num());
+		FreeLeafNodes.Reset();
+		mMappedLeafNodes = TArrayView<const TDPLeafNode>();
+		mNavData.Reset();
+	}
+}
+
+void TDPTree::BuildLookups()
+{
+	ParallelFor(Layers.Num(), [this](int32 layer)
+	{
+		Layers[layer].BuildLookup();
+	});
+}
+
+void TDPTree::ClearLookups()
+{
+	for (auto& layer : Layers)
+	{
+		layer.ClearLookup();
+	}
+}
+
+void TDPTree::BuildPositions(const FVector& origin, const TArray<float>& layerHalfSizes)
+{
+	ParallelFor(Layers.Num(), [this, &origin, &layerHalfSizes](int32 layer)
+	{
+		Layers[layer].BuildPositions(origin, layerHalfSizes[layer] * 2);
+	});
+}
+
+void TDPTree::ClearPositions()
+{
+	for (auto& layer : Layers)
+	{
+		layer.ClearPositions();
+	}
+}
+
+bool TDPTree::IsMapped() const
+{
+	return mNavData.IsValid();
+}
+
+void TDPTree::Map(const TSharedPtr<TDPNavData>& navData)
+{
+	Clear();
+
+	Layers.SetNum(navData->GetTotalLayers());
+	for (LayerIndexType layer = 0; layer < Layers.Num(); ++layer)
+	{
+		Layers[layer].Map(navData->GetMortonCodes(layer), navData->GetParents(layer), navData->GetFirstChildren(layer), navData->GetNeighbors(layer));
+	}
+
+	mMappedLeafNodes = navData->GetLeafNodes();
+	mNavData = navData;
+}
+
+void TDPTree::SetLeafNode(NodeIndexType node, const TDPLeafNode& leaf)
+{
+	auto& child = Layers[0].GetFirstChild(node);
+
+	// still partially blocked, the leaf can be overwritten in place
+	if (child.IsValid() && child.NodeIndex != FullyBlockedLeaf && !leaf.IsEmpty() && !leaf.IsFullyBlocked())
+	{
+		LeafNodes[child.NodeIndex] = leaf;
+		return;
+	}
+
+	RemoveLeafNode(child);
+	child = AddLeafNode(leaf);
+}
+
+void TDPTree::RemoveLayerNodes(LayerIndexType layer, NodeIndexType index, int32 count)
+{
+	if (layer == 0)
+	{
+		for (int32 i = index; i < index + count; ++i)
+		{
+			RemoveLeafNode(Layers[0].GetFirstChild(i));
+		}
+	}
+
+	Layers[layer].RemoveAt(index, count);
+}
+
+void TDPTree::RebuildLeafNodes()
+{
+	// packs the leaves in node order, also converts octrees saved with a leaf for every layer 0 node
+	TArray<TDPLeafNode> leaves = MoveTemp(LeafNodes);
+	LeafNodes.Reset();
+	FreeLeafNodes.Reset();
+
+	if (Layers.Num() == 0)
+	{
+		return;
+	}
+
+	auto& layer = Layers[0];
+	for (NodeIndexType i = 0; i < layer.Num(); ++i)
+	{
+		auto& child = layer.GetFirstChild(i);
+		if (child.IsValid())
+		{
+			child = AddLeafNode(leaves[child.NodeIndex]);
+		}
+	}
+}
+
+TDPNodeLink TDPTree::AddLeafNode(const TDPLeafNode& leaf)
+{
+	// a node with a free leaf is just a free node
+	if (leaf.IsEmpty())
+	{
+		return TDPNodeLink::InvalidLink;
+	}
+
+	if (LeafNodes.Num() == 0)
+	{
+		LeafNodes.AddDefaulted_GetRef().GetSubnodes() = ~0ULL;
+	}
+
+	if (leaf.IsFullyBlocked())
+	{
+		return TDPNodeLink(0, FullyBlockedLeaf, 0);
+	}
+
+	NodeIndexType index;
+	if (FreeLeafNodes.Num() > 0)
+	{
+		index = FreeLeafNodes.Pop(false);
+		LeafNodes[index] = leaf;
+	}
+	else
+	{
+		index = LeafNodes.Add(leaf);
+	}
+
+	return TDPNodeLink(0, index, 0);
+}
+
+void TDPTree::RemoveLeafNode(const TDPNodeLink& link)
+{
+	if (link.IsValid() && link.NodeIndex != FullyBlockedLeaf)
+	{
+		FreeLeafNodes.Add(link.NodeIndex);
+	}
+}
+
+void TDPTree::Serialize(FArchive& Ar, bool compress)
+{
+	Ar.UsingCustomVersion(FTDPCustomVersion::GUID);
+
+	if (Ar.IsLoading() && Ar.CustomVer(FTDPCustomVersion::GUID) < FTDPCustomVersion::BulkOctree)
+	{
+		Ar << Layers;
+		Ar << LeafNodes;
+		return;
+	}
+
+	// "TDPO", format and size let a reader skip data it doesn't understand instead of misreading it
+	const uint32 magic = 0x4F504454;
+	uint32 savedMagic = magic;
+	int32 savedVersion = FTDPCustomVersion::LatestVersion;
+	uint32 savedLinkSize = sizeof(TDPNodeLink);
+	bool compressed = false;
+	int32 uncompressedSize = 0;
+	TArray<uint8> data;
+
+	if (Ar.IsSaving())
+	{
+		FMemoryWriter writer(data);
+		SerializeBulk(writer);
+		uncompressedSize = data.Num();
+
+		// transactions and duplication save too, only compress what goes to disk
+		if (compress && Ar.IsPersistent() && uncompressedSize > 0)
+		{
+			TArray<uint8> compressedData;
+			int32 compressedSize = FCompression::CompressMemoryBound(NAME_Zlib, uncompressedSize);
+			compressedData.SetNumUninitialized(compressedSize);
+
+			if (FCompression::CompressMemory(NAME_Zlib, compressedData.GetData(), compressedSize, data.GetData(), uncompressedSize))
+			{
+				compressedData.SetNum(compressedSize, false);
+				data = MoveTemp(compressedData);
+				compressed = true;
+			}
+		}
+	}
+
+	Ar << savedMagic;
+	Ar << savedVersion;
+
+	if (savedVersion >= FTDPCustomVersion::BulkLinkSize)
+	{
+		Ar << savedLinkSize;
+	}
+
+	Ar << compressed;
+	Ar << uncompressedSize;
+	Ar << data;
+
+	if (!Ar.IsLoading())
+	{
+		return;
+	}
+
+	Clear();
+
+	if (savedMagic != magic || savedVersion != FTDPCustomVersion::LatestVersion || savedLinkSize != sizeof(TDPNodeLink) || uncompressedSize < 0)
+	{
+		return;
+	}
+
+	if (compressed)
+	{
+		TArray<uint8> uncompressedData;
+		uncompressedData.SetNumUninitialized(uncompressedSize);
+
+		if (!FCompression::UncompressMemory(NAME_Zlib, uncompressedData.GetData(), uncompressedSize, data.GetData(), data.Num()))
+		{
+			return;
+		}
+
+		data = MoveTemp(uncompressedData);
+	}
+
+	FMemoryReader reader(data);
+	if (!SerializeBulk(reader))
+	{
+		Clear();
+	}
+}
+
+bool TDPTree::SerializeBulk(FArchive& Ar)
+{
+	int32 totalLayers = Layers.Num();
+	Ar << totalLayers;
+
+	if (Ar.IsLoading())
+	{
+		if (totalLayers < 0 || totalLayers >= INVALID_LAYER_INDEX)
+		{
+			return false;
+		}
+
+		Layers.SetNum(totalLayers);
+	}
+
+	for (auto& layer : Layers)
+	{
+		if (!layer.SerializeBulk(Ar))
+		{
+			return false;
+		}
+	}
+
+	int32 totalLeafNodes = LeafNodes.Num();
+	Ar << totalLeafNodes;
+
+	if (Ar.IsLoading())
+	{
+		if (totalLeafNodes < 0 || static_cast<int64>(totalLeafNodes) * sizeof(TDPLeafNode) > Ar.TotalSize() - Ar.Tell())
+		{
+			return false;
+		}
+
+		LeafNodes.SetNumUninitialized(totalLeafNodes);
+	}
+
+	Ar.Serialize(LeafNodes.GetData(), totalLeafNodes * sizeof(TDPLeafNode));
+
+	return !Ar.IsError();
+}
+
+uint64 TDPTree::MemoryUsage() const
 {
-	int32 result = 0;
+	uint64 result = 0;
 
 	for (int32 i = 0; i < Layers.Num(); ++i)
 	{
-		result += Layers[i].Num() * sizeof(TDPNode);
+		result += Layers[i].MemoryUsage();
 	}
 
-	result += LeafNodes.Num() * sizeof(TDPLeafNode);
+	result += (static_cast<uint64>(LeafNodes.Num()) + mMappedLeafNodes.Num()) * sizeof(TDPLeafNode);
+	result += static_cast<uint64>(FreeLeafNodes.Num()) * sizeof(NodeIndexType);
+
+	return result;
+}
+
+SIZE_T TDPTree::GetAllocatedSize() const
+{
+	SIZE_T result = Layers.GetAllocatedSize() + LeafNodes.GetAllocatedSize() + FreeLeafNodes.GetAllocatedSize();
+
+	for (const auto& layer : Layers)
+	{
+		result += layer.GetAllocatedSize();
+	}
 
 	return result;
 }
 
+void TDPTree::GetMemoryReport(TDPMemoryReport& report) const
+{
+	report.Layers.SetNum(Layers.Num());
+
+	for (int32 i = 0; i < Layers.Num(); ++i)
+	{
+		report.Layers[i].Nodes = Layers[i].Num();
+		report.Layers[i].UsedBytes = Layers[i].MemoryUsage();
+		report.Layers[i].AllocatedBytes = Layers[i].GetAllocatedSize();
+	}
+
+	report.LeafNodes = GetTotalLeafNodes();
+	report.FreeLeafNodes = IsMapped() ? 0 : FreeLeafNodes.Num();
+	report.LeafUsedBytes = (static_cast<uint64>(LeafNodes.Num()) + mMappedLeafNodes.Num()) * sizeof(TDPLeafNode) + static_cast<uint64>(FreeLeafNodes.Num()) * sizeof(NodeIndexType);
+	report.LeafAllocatedBytes = LeafNodes.GetAllocatedSize() + FreeLeafNodes.GetAllocatedSize();
+
+	report.EmptyLeaves = 0;
+	report.PartialLeaves = 0;
+	report.FullLeaves = 0;
+
+	if (Layers.Num() == 0)
+	{
+		return;
+	}
+
+	// free layer 0 nodes have no leaf, fully blocked ones share the first leaf
+	const auto& layer = Layers[0];
+	for (NodeIndexType i = 0; i < layer.Num(); ++i)
+	{
+		if (!layer.HasChildren(i))
+		{
+			++report.EmptyLeaves;
+		}
+		else if (layer.GetFirstChild(i).NodeIndex == FullyBlockedLeaf)
+		{
+			++report.FullLeaves;
+		}
+		else
+		{
+			++report.PartialLeaves;
+		}
+	}
+}
+
 void TDPTree::Clear()
 {
 	Layers.Reset();
 	LeafNodes.Reset();
+	FreeLeafNodes.Reset();
+	mMappedLeafNodes = TArrayView<const TDPLeafNode>();
+	mNavData.Reset();
 }
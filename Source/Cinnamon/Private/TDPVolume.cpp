@@ -10,8 +10,17 @@
 #include "libmorton/include/morton.h"
 #include "DrawDebugHelpers.h"
 #include "TDPDynamicObstacleComponent.h"
+#include "Async/ParallelFor.h"
+#include "GenerateOctreeTask.h"
+#include "TDPNavData.h"
+#include "Misc/Paths.h"
+#include "EngineUtils.h"
+#include "HAL/LowLevelMemTracker.h"
 #include <chrono>
 
+// octree, caches and generation scratch memory show up under this name in LLM captures and memreport
+DECLARE_LLM_MEMORY_STAT(TEXT("Cinnamon"), STAT_CinnamonLLM, STATGROUP_LLMFULL);
+
 ATDPVolume::ATDPVolume(const FObjectInitializer& ObjectInitializer)	: Super(ObjectInitializer)
 {
 	PrimaryActorTick.bCanEverTick = true;
@@ -39,6 +48,31 @@ void ATDPVolume::BeginPlay()
 	{
 		mActors.Emplace(result.GetActor());
 	}
+
+	if (!mNavDataFile.IsEmpty())
+	{
+		LoadNavData();
+	}
+
+	RebuildPortals();
+}
+
+void ATDPVolume::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// the tile is streamed out, adjacent tiles can't path into it anymore
+	RemovePortals();
+	WaitForTileQueries();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ATDPVolume::BeginDestroy()
+{
+	CancelGeneration();
+	RemovePortals();
+	WaitForTileQueries();
+
+	Super::BeginDestroy();
 }
 
 void ATDPVolume::PostRegisterAllComponents()
@@ -55,7 +89,13 @@ void ATDPVolume::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
-	if (mDynamicUpdateEnabled && mOctreeDirty)
+	if (mGenerationTask.IsValid() && mGenerationTask->IsDone())
+	{
+		FinishGeneration();
+	}
+
+	// dynamic updates wait for the background generation, the new octree replaces the current one anyway
+	if (mDynamicUpdateEnabled && mOctreeDirty && !IsGenerating())
 	{
 #if WITH_EDITOR
 		if (PrintLogMessagesOnTick)
@@ -69,7 +109,24 @@ void ATDPVolume::Tick(float DeltaTime)
 
 		// do magic
 		FlushDrawnOctree();
-		UpdateOctree();
+		{
+			FRWScopeLock lock(mOctreeLock, SLT_Write);
+
+			// updates move nodes around, they need the stored links
+			mOctree.Expand();
+			UpdateOctree();
+
+			if (mCompactOctree)
+			{
+				mOctree.Compact();
+			}
+		}
+
+		// node indices moved, portals from adjacent tiles need to be found again
+		if (mPortals.Num() > 0)
+		{
+			RebuildPortals();
+		}
 
 #if WITH_EDITOR
 		float totalTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - startTime).count() / 1000.0f;
@@ -99,6 +156,12 @@ void ATDPVolume::Tick(float DeltaTime)
 void ATDPVolume::PostEditChangeProperty(FPropertyChangedEvent & PropertyChangedEvent)
 {
 	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	// the coarse graph is baked for one layer, it has to follow the details panel
+	if (PropertyChangedEvent.GetPropertyName() == GET_MEMBER_NAME_CHECKED(ATDPVolume, mHierarchyLayer))
+	{
+		SetHierarchyLayer(mHierarchyLayer);
+	}
 }
 
 void ATDPVolume::PostEditUndo()
@@ -120,16 +183,27 @@ bool ATDPVolume::ShouldTickIfViewportsOnly() const
 
 void ATDPVolume::Initialize()
 {
+	CancelGeneration();
+
 #if WITH_EDITOR
 	UE_LOG(CinnamonLog, Log, TEXT("Initalizing..."));
 	FlushDrawnOctree();
 #endif
 
+	// async path queries hold the read lock while searching
+	FRWScopeLock lock(mOctreeLock, SLT_Write);
+	InitializeLayout();
+}
+
+void ATDPVolume::InitializeLayout()
+{
 	FBox bounds = GetComponentsBoundingBox(true);
 	bounds.GetCenterAndExtents(mOrigin, mExtents);
 
 	mBlockedIndices.Reset();
 	mOctree.Clear();
+	mGraph.Reset();
+	mCoarseGraph.Reset();
 	mLayerVoxelHalfSizeCache.Reset();
 
 	mTotalLayers = mLayers + 1;
@@ -143,422 +217,1077 @@ void ATDPVolume::Initialize()
 
 void ATDPVolume::Generate()
 {
-	// initialize volume
-	Initialize();
+	LLM_SCOPED_SINGLE_STAT_TAG(STAT_CinnamonLLM);
+	// a blocking generation replaces whatever is being generated in the background
+	CancelGeneration();
 
 #if WITH_EDITOR
 
+	UE_LOG(CinnamonLog, Log, TEXT("Initalizing..."));
+	FlushDrawnOctree();
 	GetWorld()->PersistentLineBatcher->SetComponentTickEnabled(false);
 	auto startTime = std::chrono::high_resolution_clock::now();
 
 #endif // WITH_EDITOR
 
-	RasterizeLowRes();
-
-	for (int32 i = 0; i < mTotalLayers; ++i)
 	{
-		mOctree.Layers.Emplace();
-	}
+		// the octree is built in place, async path queries wait until it's complete
+		FRWScopeLock lock(mOctreeLock, SLT_Write);
+		InitializeLayout();
 
-	// rasterize each layer, from the inner most layer (most precision) to the outer most (less precision), setting parent children links
-	for (int32 i = 0; i < mTotalLayers; ++i)
-	{
-		RasterizeLayer(i);
-	}
+		GatherGeometry(GetComponentsBoundingBox(true));
 
-	for (int32 i = mTotalLayers - 2; i >= 0; --i)
-	{
-		SetNeighborLinks(i);
+		if (!RasterizeOctree(mOctree))
+		{
+			// no navigation rather than a broken octree
+			mOctree.Clear();
+			mTotalLayers = 0;
+		}
+		else if (mCompactOctree)
+		{
+			mOctree.Compact();
+		}
+
+		mGeometryRasterizer.Reset();
+		RebuildGraph();
 	}
 
 	mTotalLayerNodes = mOctree.GetTotalLayerNodes();
-	mTotalLeafNodes = mOctree.LeafNodes.Num();
+	mTotalLeafNodes = mOctree.GetTotalLeafNodes();
 	mTotalBytes = mOctree.MemoryUsage();
 
+	RebuildPortals();
+
 #if WITH_EDITOR
 
 	float totalTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - startTime).count() / 1000.0f;
 	UE_LOG(CinnamonLog, Log, TEXT("Total Time (s): %f"), totalTime);
 	UE_LOG(CinnamonLog, Log, TEXT("Total Layer Nodes: %d"), mTotalLayerNodes);
 	UE_LOG(CinnamonLog, Log, TEXT("Total Leaf Nodes: %d"), mTotalLeafNodes);
-	UE_LOG(CinnamonLog, Log, TEXT("Memory Usage: %d Bytes"), mTotalBytes);
+	UE_LOG(CinnamonLog, Log, TEXT("Memory Usage: %lld Bytes, Generation Peak: %lld Bytes"), mTotalBytes, mGenerationPeakBytes);
 
 #endif
 }
 
-void ATDPVolume::Clear()
-{
-	mOctree.Clear();
-	mBlockedIndices.Reset();
-	mTotalLayers = 0;
-	mTotalBytes = 0;
-	mTotalLayerNodes = 0;
-	mTotalLeafNodes = 0;
-	FlushDrawnOctree();
-}
-
-void ATDPVolume::DrawOctree() const
+void ATDPVolume::GenerateAsync()
 {
-	FlushDrawnOctree();
-
-	for (int32 i = 0; i < mOctree.Layers.Num(); ++i)
+	if (IsGenerating())
 	{
-		for (int32 j = 0; j < mOctree.Layers[i].Num(); ++j)
-		{
-			DrawNodeVoxel(i, mOctree.Layers[i][j]);
-		}
+		return;
 	}
-}
 
-void ATDPVolume::DrawLeafNodes() const
-{
-	FlushDrawnOctree();
+	FVector origin, extents;
+	GetComponentsBoundingBox(true).GetCenterAndExtents(origin, extents);
 
-	if (mOctree.Layers.Num() > 0)
+	// the current octree can only keep answering queries while generating if the new one has the same layout
+	if (!origin.Equals(mOrigin) || !extents.Equals(mExtents) || mTotalLayers != mLayers + 1 || mLayerVoxelHalfSizeCache.Num() != mLayers + 1)
 	{
-		for (const auto& node : mOctree.GetLayer(0))
-		{
-			DrawNodeVoxel(0, node);
-		}
+		Clear();
+
+		FRWScopeLock lock(mOctreeLock, SLT_Write);
+		InitializeLayout();
+		// no navigation until the new octree is ready
+		mTotalLayers = 0;
 	}
+
+	mPendingOctree.Clear();
+	mGenerationCancelled = false;
+	mGenerationStep.Reset();
+	mGenerationLayer.Reset();
+	mGenerationStepNodes.Reset();
+	mGenerationStepProcessedNodes.Reset();
+	mGenerationStartTime = FPlatformTime::Seconds();
+
+	// gathering touches components, it has to happen on the game thread
+	GatherGeometry(GetComponentsBoundingBox(true));
+
+	mGenerationTask = MakeShared<FAsyncTask<GenerateOctreeTask>>(*this, mPendingOctree);
+	mGenerationTask->StartBackgroundTask();
 }
 
-void ATDPVolume::DrawBlockedMiniLeafNodes() const
+void ATDPVolume::CancelGeneration()
 {
-	for (int32 i = 0; i < mOctree.LeafNodes.Num(); ++i)
+	if (mGenerationTask.IsValid())
 	{
-		for (int32 j = 0; j < 64; ++j)
-		{
-			if (mOctree.LeafNodes[i].GetSubnode(j))
-			{
-				FVector position;
-				TDPNodeLink link{ 0, i, static_cast<SubnodeIndexType>(j) };
-				GetNodePositionFromLink(link, position);
-				DrawNodeVoxel(position, FVector(mLayerVoxelHalfSizeCache[0] / 4), FColor::Emerald);
-			}
-		}
+		mGenerationCancelled = true;
+		mGenerationTask->EnsureCompletion(false);
+		mGenerationTask = nullptr;
+		// blocking generation and updates check the same flag
+		mGenerationCancelled = false;
+
+		mPendingOctree.Clear();
+		mGeometryRasterizer.Reset();
+
+		// the current octree was dropped if the layout changed
+		mTotalLayers = mOctree.Layers.Num();
 	}
 }
 
-void ATDPVolume::FlushDrawnOctree() const
+bool ATDPVolume::IsGenerating() const
 {
-	FlushDebugStrings(GetWorld());
-	FlushPersistentDebugLines(GetWorld());
+	return mGenerationTask.IsValid();
 }
 
-FVector ATDPVolume::GetRandomPointInVolume() const
+bool ATDPVolume::GetGenerationProgress(int32& layer, float& percent) const
 {
-	float x = FMath::RandRange(mOrigin.X - (mExtents.X / 2), mOrigin.X + (mExtents.X / 2));
-	float y = FMath::RandRange(mOrigin.Y - (mExtents.Y / 2), mOrigin.Y + (mExtents.Y / 2));
-	float z = FMath::RandRange(mOrigin.Z - (mExtents.Z / 2), mOrigin.Z + (mExtents.Z / 2));
+	if (!IsGenerating())
+	{
+		layer = 0;
+		percent = 0.0f;
+		return false;
+	}
 
-	return FVector(x, y, z);
+	// one low res step, one step per rasterized layer and one per linked layer
+	const int32 totalSteps = 2 * (mLayers + 1);
+	const int32 nodes = mGenerationStepNodes.GetValue();
+	const float stepProgress = nodes > 0 ? FMath::Min(static_cast<float>(mGenerationStepProcessedNodes.GetValue()) / nodes, 1.0f) : 0.0f;
+
+	layer = mGenerationLayer.GetValue();
+	percent = 100.0f * FMath::Min((mGenerationStep.GetValue() + stepProgress) / totalSteps, 1.0f);
+
+	return true;
 }
 
-void ATDPVolume::RasterizeLowRes()
+FRWLock& ATDPVolume::GetOctreeLock() const
 {
-	mBlockedIndices.Emplace();
+	return mOctreeLock;
+}
 
-	const int32 lowresLayer = 1;
-	int32 nodes = GetNodeAmountInLayer(1);
-	for (int32 i = 0; i < nodes; ++i)
-	{
-		FVector position;
-		GetNodePosition(lowresLayer, i, position);
+void ATDPVolume::FinishGeneration()
+{
+	LLM_SCOPED_SINGLE_STAT_TAG(STAT_CinnamonLLM);
+	mGenerationTask = nullptr;
+	mGeometryRasterizer.Reset();
 
-		if (IsVoxelBlocked(position, mLayerVoxelHalfSizeCache[lowresLayer]))
-		{
-			mBlockedIndices[0].Add(i);
-		}
+	if (mGenerationCancelled)
+	{
+		mPendingOctree.Clear();
+		return;
 	}
 
-	for (int32 i = 0; i < mLayers; ++i)
+	if (mCompactOctree)
 	{
-		mBlockedIndices.Emplace();
-		for (MortonCodeType& code : mBlockedIndices[i])
-		{
-			mBlockedIndices[i + 1].Add(code >> 3); // your parent is eight times you
-		}
+		mPendingOctree.Compact();
 	}
-}
 
-void ATDPVolume::RasterizeLayer(LayerIndexType layer)
-{
-	if (layer == 0)
 	{
-		// allocate space for all leaves
-		// we know this value from lowres rasterize
-		mOctree.LeafNodes.Reserve(mBlockedIndices[layer].Num() * 8);
-		// likewise for leaf layer nodes
-		mOctree.Layers[layer].Reserve(mBlockedIndices[layer].Num() * 8);
-
-		int32 nodes = GetNodeAmountInLayer(layer);
-		for (int32 i = 0; i < nodes; ++i)
-		{
-			// if parent is blocked then this node has to be added
-			if (mBlockedIndices[layer].Contains(i >> 3))
-			{
-				// Add new node
-				int32 nodeIndex = mOctree.GetLayer(layer).Emplace();
-				TDPNode& node = mOctree.GetLayer(layer)[nodeIndex];
-
-				node.SetMortonCode(i);
-				FVector nodePosition;
-				GetNodePosition(layer, i, nodePosition);
-
-				NodeIndexType currentLeaf = mOctree.LeafNodes.Emplace();
-				if (IsVoxelBlocked(nodePosition, mLayerVoxelHalfSizeCache[layer], true))
-				{
-					FVector origin = nodePosition - FVector(mLayerVoxelHalfSizeCache[layer]);
-					RasterizeLeafNode(origin, currentLeaf);
-					auto& child = node.GetFirstChild();
-					child.SetLayerIndex(0);
-					child.SetNodeIndex(currentLeaf);
-					child.SetSubnodeIndex(0);
-#if WITH_EDITOR
-					// Debug
-					if (DrawOnlyBlockedLeafVoxels)
-					{
-						DrawNodeVoxel(nodePosition, FVector(mLayerVoxelHalfSizeCache[layer]), DebugHelper::LayerColors[layer]);
-					}
-#endif
-				}
-
-#if WITH_EDITOR
-				// Debug
-				if (DrawLeafVoxels && !DrawOnlyBlockedLeafVoxels)
-				{
-					DrawNodeVoxel(nodePosition, FVector(mLayerVoxelHalfSizeCache[layer]), DebugHelper::LayerColors[layer]);
-				}
-#endif
-			}
-		}
+		// async path queries hold the read lock while searching
+		FRWScopeLock lock(mOctreeLock, SLT_Write);
+		Swap(mOctree, mPendingOctree);
+		mTotalLayers = mOctree.Layers.Num();
+		RebuildGraph();
 	}
-	else if (mOctree.GetLayer(layer - 1).Num() > 0)
-	{
-		mOctree.Layers[layer].Reserve(mBlockedIndices[layer].Num() * 8);
 
-		int32 nodes = GetNodeAmountInLayer(layer);
-		for (int32 i = 0; i < nodes; ++i)
-		{
-			if (IsNodeBlocked(layer, i))
-			{
-				// Add new node
-				int32 nodeIndex = mOctree.GetLayer(layer).Emplace();
-				TDPNode& node = mOctree.GetLayer(layer)[nodeIndex];
+	mPendingOctree.Clear();
 
-				node.SetMortonCode(i);
-				FVector nodePosition;
-				GetNodePosition(layer, node.GetMortonCode(), nodePosition);
+	mTotalLayerNodes = mOctree.GetTotalLayerNodes();
+	mTotalLeafNodes = mOctree.GetTotalLeafNodes();
+	mTotalBytes = mOctree.MemoryUsage();
 
-				NodeIndexType firstChildIndex;
-				if (GetNodeIndexFromMortonCode(layer - 1, node.GetMortonCode() << 3, firstChildIndex))
-				{
-					// set parent -> first child link
-					auto& firstChild = node.GetFirstChild();
-					firstChild.SetLayerIndex(layer - 1);
-					firstChild.SetNodeIndex(firstChildIndex);
-
-					// set children -> parent links (exactly 8 children)
-					auto& octreeLayer = mOctree.GetLayer(layer - 1);
-					for (int32 childOffset = 0; childOffset < 8; ++childOffset)
-					{
-						auto& parent = octreeLayer[firstChildIndex + childOffset].GetParent();
-						parent.SetLayerIndex(layer);
-						parent.SetNodeIndex(nodeIndex);
-					}
+	RebuildPortals();
 
 #if WITH_EDITOR
-					// Debug
-					if (DrawParentChildLinks)
-					{
-						FVector startPosition, endPosition;
-						GetNodePosition(layer, node.GetMortonCode(), startPosition);
-						GetNodePosition(layer - 1, node.GetMortonCode() << 3, endPosition);
-						DrawDebugDirectionalArrow(GetWorld(), startPosition, endPosition, LinkSize, DebugHelper::LayerColors[layer], true);
-					}
-#endif
-				}
-				else
-				{
-					// if no children then invalidate link
-					auto& firstChild = node.GetFirstChild();
-					firstChild.Invalidate();
-				}
+	UE_LOG(CinnamonLog, Log, TEXT("Async Generation Time (s): %f"), static_cast<float>(FPlatformTime::Seconds() - mGenerationStartTime));
+	UE_LOG(CinnamonLog, Log, TEXT("Total Layer Nodes: %d"), mTotalLayerNodes);
+	UE_LOG(CinnamonLog, Log, TEXT("Total Leaf Nodes: %d"), mTotalLeafNodes);
+	UE_LOG(CinnamonLog, Log, TEXT("Memory Usage: %lld Bytes, Generation Peak: %lld Bytes"), mTotalBytes, mGenerationPeakBytes);
 
-#if WITH_EDITOR
-				// Debug
-				if (DrawVoxels)
-				{
-					DrawNodeVoxel(nodePosition, FVector(mLayerVoxelHalfSizeCache[layer]), DebugHelper::LayerColors[layer]);
-				}
-#endif
-			}
-		}
+	if (DrawVoxels)
+	{
+		DrawOctree();
 	}
+#endif
 }
 
-void ATDPVolume::RasterizeLeafNode(const FVector& origin, NodeIndexType leaf)
+void ATDPVolume::GatherGeometry(const FBox& bounds)
 {
-	const int32 totalLeaves = 64;
-	const float leafSize = mLayerVoxelHalfSizeCache[0] / 2; // 64 leaves per leaf node (cached value is already half)
-
-	for (int32 i = 0; i < totalLeaves; ++i)
+	LLM_SCOPED_SINGLE_STAT_TAG(STAT_CinnamonLLM);
+	// the geometry snapshot is only used while generating, dynamic updates keep querying the physics scene
+	if (mRasterizer == ETDPRasterizer::Geometry)
 	{
-		uint_fast32_t x, y, z;
-		libmorton::morton3D_64_decode(i, x, y, z);
-		FVector position = origin + FVector(x * leafSize, y * leafSize, z * leafSize) + FVector(leafSize / 2);
-
-		if (IsVoxelBlocked(position, leafSize / 2, true))
-		{
-			mOctree.LeafNodes[leaf].SetSubnode(i);
-
+		mGeometryRasterizer.Gather(GetWorld(), bounds.ExpandBy(mCollisionClearance + mLayerVoxelHalfSizeCache[0]), mCollisionChannel, mComplexCollision, this);
 #if WITH_EDITOR
-			// Debug
-			if (DrawMiniLeafVoxels)
-			{
-				DrawNodeVoxel(position, FVector(leafSize / 2), FColor::Emerald);
-			}
-
-			if (DrawLeafMortonCodes)
-			{
-				DrawDebugString(GetWorld(), position, FString::FromInt(leaf) + ":" + FString::FromInt(i), nullptr, FColor::Emerald);
-			}
+		UE_LOG(CinnamonLog, Log, TEXT("Collision Triangles: %d"), mGeometryRasterizer.GetTotalTriangles());
 #endif
-		}
 	}
 }
 
-void ATDPVolume::SetNeighborLinks(const LayerIndexType layer)
+bool ATDPVolume::RasterizeOctree(TDPTree& octree)
 {
-	auto& octreeLayer = mOctree.GetLayer(layer);
+	LLM_SCOPED_SINGLE_STAT_TAG(STAT_CinnamonLLM);
+	const int32 totalLayers = mLayers + 1;
 
-	for (int32 i = 0; i < octreeLayer.Num(); ++i)
+	// scratch memory peaks while the blocked indices, the geometry snapshot and the new octree are all alive
+	uint64 peakBytes = 0;
+	auto trackPeak = [this, &octree, &peakBytes]()
 	{
-		auto& node = octreeLayer[i];
-		FVector nodePosition;
-		GetNodePosition(layer, node.GetMortonCode(), nodePosition);
-
-		// at most 6 neighbors, each face
-		for (int32 j = 0; j < 6; ++j)
+		uint64 bytes = octree.GetAllocatedSize() + mBlockedIndices.GetAllocatedSize() + mGeometryRasterizer.GetAllocatedSize();
+		for (const auto& blockedLayer : mBlockedIndices)
 		{
-			auto& link = node.GetNeighbors()[j];
-
-			NodeIndexType currentNodeIndex = i;
-			auto currentLayer = layer;
-			// find the closest neighbor, start by looking in the current node's layer
-			// go up the layers if no valid neighbor was found in that layer
-			while (!FindNeighborLink(currentLayer, currentNodeIndex, j, link, nodePosition)
-				&& currentLayer < mOctree.Layers.Num() - 2)
-			{
-				auto& parentLink = mOctree.GetLayer(currentLayer)[currentNodeIndex].GetParent();
-				if (parentLink.IsValid())
-				{
-					currentNodeIndex = parentLink.NodeIndex;
-					currentLayer = parentLink.LayerIndex;
-				}
-				else
-				{
-					++currentLayer;
-					GetNodeIndexFromMortonCode(currentLayer, node.GetMortonCode() >> 3, currentNodeIndex);
-				}
-			}
+			bytes += blockedLayer.GetAllocatedSize();
 		}
-	}
-}
 
-bool ATDPVolume::FindNeighborLink(const LayerIndexType layerIndex, const NodeIndexType nodeIndex, uint8 direction, TDPNodeLink& link, const FVector& nodePosition)
-{
-	auto& layer = mOctree.GetLayer(layerIndex);
-	auto& node = layer[nodeIndex];
-	int32 maxCoordinate = static_cast<int32>(FMath::Pow(2, (mLayers - layerIndex)));
-
-	uint_fast32_t x, y, z;
-	libmorton::morton3D_64_decode(node.GetMortonCode(), x, y, z);
+		peakBytes = FMath::Max(peakBytes, bytes);
+	};
 
-	FIntVector signedPosition(static_cast<int32>(x), static_cast<int32>(y), static_cast<int32>(z));
-	signedPosition += NodeHelper::NeighborDirections[direction];
+	SetGenerationStep(0, mLayers, 0);
+	RasterizeLowRes();
+	trackPeak();
 
-	// invalidate link if neighbor coordinates are out of bounds
-	if (signedPosition.X < 0 || signedPosition.X >= maxCoordinate ||
-		signedPosition.Y < 0 || signedPosition.Y >= maxCoordinate ||
-		signedPosition.Z < 0 || signedPosition.Z >= maxCoordinate)
+	// links can't address more nodes than this, stop before writing corrupt links
+	for (int32 i = 0; i < totalLayers; ++i)
 	{
-		link.Invalidate();
-
-#if WITH_EDITOR
-		// Debug
-		if (DrawInvalidNeighborLinks)
+		if (mBlockedIndices[i].Num() * 8LL > TDPNodeLink::MaxNodeIndex + 1LL)
 		{
-			FVector startPosition, endPosition;
-			GetNodePosition(layerIndex, node.GetMortonCode(), startPosition);
-			endPosition = startPosition + (FVector(NodeHelper::NeighborDirections[direction]) * mLayerVoxelHalfSizeCache[layerIndex] * 2);
-			DrawDebugDirectionalArrow(GetWorld(), startPosition, endPosition, LinkSize, FColor::Red, true);
-		}
+#if WITH_EDITOR
+			UE_LOG(CinnamonLog, Error, TEXT("Layer %d needs %lld nodes, node links can only address %d. Use fewer layers or build with CINNAMON_WIDE_NODE_LINKS."), i, mBlockedIndices[i].Num() * 8LL, TDPNodeLink::MaxNodeIndex + 1);
 #endif
-
-		return true;
+			mBlockedIndices.Empty();
+			return false;
+		}
 	}
 
-	x = signedPosition.X;
-	y = signedPosition.Y;
-	z = signedPosition.Z;
+	for (int32 i = 0; i < totalLayers; ++i)
+	{
+		octree.Layers.Emplace();
+	}
 
-	MortonCodeType neighborCode = libmorton::morton3D_64_encode(x, y, z);
+	// rasterize each layer, from the inner most layer (most precision) to the outer most (less precision), setting parent children links
+	for (int32 i = 0; i < totalLayers && !mGenerationCancelled; ++i)
+	{
+		SetGenerationStep(1 + i, i, mBlockedIndices[i].Num() * 8);
+		RasterizeLayer(octree, i);
+		trackPeak();
+	}
 
-	// assume we'll look for nodes sequentially after current
-	int32 stopValue = layer.Num();
-	int32 nodeDelta = 1;
-	// if we'll be looking for a lower node then change values
-	if (neighborCode < node.GetMortonCode())
+	// neighbor links search every layer, the lookups are kept afterwards for pathfinding
+	if (mHashedLookup && !mGenerationCancelled)
 	{
-		nodeDelta = -1;
-		stopValue = -1;
+		octree.BuildLookups();
 	}
 
-	for (int32 i = nodeIndex + nodeDelta; i != stopValue; i += nodeDelta)
+	for (int32 i = totalLayers - 2; i >= 0 && !mGenerationCancelled; --i)
 	{
-		auto& currentNode = layer[i];
+		SetGenerationStep(1 + totalLayers + (totalLayers - 2 - i), i, octree.GetLayer(i).Num());
+		SetNeighborLinks(octree, i);
+	}
 
-		// if node found
-		if (currentNode.GetMortonCode() == neighborCode)
-		{
-			if (layerIndex == 0 && 
-				currentNode.HasChildren() && 
-				mOctree.LeafNodes[currentNode.GetFirstChild().NodeIndex].IsFullyBlocked())
-			{
-				link.Invalidate();
-				return true;
-			}
+	if (mCachedPositions && !mGenerationCancelled)
+	{
+		octree.BuildPositions(mOrigin - mExtents, mLayerVoxelHalfSizeCache);
+	}
 
-			link.SetLayerIndex(layerIndex);
-			check(i < layer.Num() && i >= 0);
-			link.SetNodeIndex(i);
+	trackPeak();
+	mGenerationPeakBytes = peakBytes;
 
 #if WITH_EDITOR
-			// Debug
-			if (DrawValidNeighborLinks)
-			{
-				FVector endPosition;
-				GetNodePosition(layerIndex, neighborCode, endPosition);
-				DrawDebugDirectionalArrow(GetWorld(), nodePosition, endPosition, LinkSize, DebugHelper::LayerColors[layerIndex], true);
-			}
+	SIZE_T blockedIndicesBytes = 0;
+	for (const auto& blockedLayer : mBlockedIndices)
+	{
+		blockedIndicesBytes += blockedLayer.GetAllocatedSize();
+	}
+
+	UE_LOG(CinnamonLog, Log, TEXT("Blocked Indices Memory Usage: %llu Bytes"), static_cast<uint64>(blockedIndicesBytes));
 #endif
 
-			return true;
-		}
-		else if ((nodeDelta == -1 && currentNode.GetMortonCode() < neighborCode) ||
-			(nodeDelta == 1 && currentNode.GetMortonCode() > neighborCode))
-		{
-			return false;
-		}
-	}
+	// the blocked indices are only needed while rasterizing
+	mBlockedIndices.Empty();
 
-	return false;
+	return !mGenerationCancelled;
+}
+
+void ATDPVolume::SetGenerationStep(int32 step, int32 layer, int32 nodes)
+{
+	mGenerationStepProcessedNodes.Reset();
+	mGenerationStepNodes.Set(nodes);
+	mGenerationLayer.Set(layer);
+	mGenerationStep.Set(step);
+}
+
+void ATDPVolume::Clear()
+{
+	CancelGeneration();
+	RemovePortals();
+
+	{
+		FRWScopeLock lock(mOctreeLock, SLT_Write);
+		mOctree.Clear();
+		mGraph.Reset();
+		mCoarseGraph.Reset();
+		mBlockedIndices.Reset();
+		mTotalLayers = 0;
+	}
+
+	mTotalBytes = 0;
+	mGenerationPeakBytes = 0;
+	mTotalLayerNodes = 0;
+	mTotalLeafNodes = 0;
+	FlushDrawnOctree();
+}
+
+bool ATDPVolume::SaveNavData()
+{
+	if (mNavDataFile.IsEmpty() || IsGenerating())
+	{
+		return false;
+	}
+
+	FRWScopeLock lock(mOctreeLock, SLT_ReadOnly);
+
+	if (mOctree.Layers.Num() == 0)
+	{
+		return false;
+	}
+
+	const bool result = TDPNavData::Write(GetNavDataPath(), mOctree, mLayerVoxelHalfSizeCache, mOrigin, mExtents);
+
+#if WITH_EDITOR
+	if (!result)
+	{
+		UE_LOG(CinnamonLog, Error, TEXT("SaveNavData: could not write %s."), *GetNavDataPath());
+	}
+#endif
+
+	return result;
+}
+
+bool ATDPVolume::LoadNavData()
+{
+	LLM_SCOPED_SINGLE_STAT_TAG(STAT_CinnamonLLM);
+	if (mNavDataFile.IsEmpty() || IsGenerating())
+	{
+		return false;
+	}
+
+	// the octree reads straight from the mapped pages, nothing is copied until it changes
+	TSharedPtr<TDPNavData> navData = TDPNavData::Map(GetNavDataPath());
+
+	if (!navData.IsValid())
+	{
+#if WITH_EDITOR
+		UE_LOG(CinnamonLog, Warning, TEXT("LoadNavData: %s is missing or was written by another version."), *GetNavDataPath());
+#endif
+		return false;
+	}
+
+	// positions and neighbor searches mix the file's layers with the volume's layout, both have to match
+	if (navData->GetTotalLayers() != mLayers + 1 || !navData->GetOrigin().Equals(mOrigin) || !navData->GetExtents().Equals(mExtents))
+	{
+#if WITH_EDITOR
+		UE_LOG(CinnamonLog, Warning, TEXT("LoadNavData: %s was baked for another layer count or volume bounds."), *GetNavDataPath());
+#endif
+		return false;
+	}
+
+	{
+		FRWScopeLock lock(mOctreeLock, SLT_Write);
+
+		mOctree.Map(navData);
+		mLayerVoxelHalfSizeCache = TArray<float>(navData->GetLayerHalfSizes().GetData(), navData->GetLayerHalfSizes().Num());
+		// the graph is only built for a complete octree
+		mTotalLayers = mOctree.Layers.Num();
+
+		if (mHashedLookup)
+		{
+			mOctree.BuildLookups();
+		}
+
+		if (mCachedPositions)
+		{
+			mOctree.BuildPositions(mOrigin - mExtents, mLayerVoxelHalfSizeCache);
+		}
+
+		RebuildGraph();
+	}
+
+	mTotalLayerNodes = mOctree.GetTotalLayerNodes();
+	mTotalLeafNodes = mOctree.GetTotalLeafNodes();
+	mTotalBytes = mOctree.MemoryUsage();
+
+	return true;
+}
+
+FString ATDPVolume::GetNavDataPath() const
+{
+	return FPaths::IsRelative(mNavDataFile) ? FPaths::Combine(FPaths::ProjectContentDir(), mNavDataFile) : mNavDataFile;
+}
+
+void ATDPVolume::RebuildPortals()
+{
+	LLM_SCOPED_SINGLE_STAT_TAG(STAT_CinnamonLLM);
+	RemovePortals();
+
+	// total layers is saved with the actor even when the octree isn't
+	auto hasOctree = [](const ATDPVolume& volume)
+	{
+		return volume.mTotalLayers > 0 && volume.mOctree.Layers.Num() == volume.mTotalLayers && volume.mLayerVoxelHalfSizeCache.Num() == volume.mTotalLayers;
+	};
+
+	if (!mTiledNavigation || !hasOctree(*this) || GetWorld() == nullptr)
+	{
+		return;
+	}
+
+	for (TActorIterator<ATDPVolume> it(GetWorld()); it; ++it)
+	{
+		ATDPVolume* other = *it;
+
+		if (other != this && !other->IsPendingKill() && other->mTiledNavigation && hasOctree(*other))
+		{
+			BuildPortals(*other);
+		}
+	}
+
+#if WITH_EDITOR
+	UE_LOG(CinnamonLog, Log, TEXT("Total Portals: %d, Connected Tiles: %d"), mTotalPortals, mConnectedTiles.Num());
+#endif
+}
+
+void ATDPVolume::BuildPortals(ATDPVolume& other)
+{
+	const FBox bounds(mOrigin - mExtents, mOrigin + mExtents);
+	const FBox otherBounds(other.mOrigin - other.mExtents, other.mOrigin + other.mExtents);
+
+	// sample the shared face with the smallest leaf of both tiles so every leaf on the face gets a portal
+	const float step = FMath::Min(mLayerVoxelHalfSizeCache[0], other.mLayerVoxelHalfSizeCache[0]) / 2;
+	const float tolerance = step / 4;
+	TArray<TPair<TDPNodeLink, TDPNodeLink>> portals;
+
+	for (int32 axis = 0; axis < 3; ++axis)
+	{
+		float face, side;
+
+		if (FMath::IsNearlyEqual(bounds.Max[axis], otherBounds.Min[axis], tolerance))
+		{
+			face = bounds.Max[axis];
+			side = 1.0f;
+		}
+		else if (FMath::IsNearlyEqual(bounds.Min[axis], otherBounds.Max[axis], tolerance))
+		{
+			face = bounds.Min[axis];
+			side = -1.0f;
+		}
+		else
+		{
+			continue;
+		}
+
+		const int32 u = (axis + 1) % 3;
+		const int32 v = (axis + 2) % 3;
+		const float uMin = FMath::Max(bounds.Min[u], otherBounds.Min[u]);
+		const float vMin = FMath::Max(bounds.Min[v], otherBounds.Min[v]);
+		const int32 uSteps = FMath::FloorToInt((FMath::Min(bounds.Max[u], otherBounds.Max[u]) - uMin) / step);
+		const int32 vSteps = FMath::FloorToInt((FMath::Min(bounds.Max[v], otherBounds.Max[v]) - vMin) / step);
+
+		for (int32 i = 0; i < uSteps; ++i)
+		{
+			for (int32 j = 0; j < vSteps; ++j)
+			{
+				FVector point, otherPoint;
+				point[u] = otherPoint[u] = uMin + (i + 0.5f) * step;
+				point[v] = otherPoint[v] = vMin + (j + 0.5f) * step;
+				point[axis] = face - side * step / 2;
+				otherPoint[axis] = face + side * step / 2;
+
+				TDPNodeLink link, otherLink;
+				if (FindLinkFromPosition(point, link) && other.FindLinkFromPosition(otherPoint, otherLink))
+				{
+					portals.Emplace(link, otherLink);
+				}
+			}
+		}
+	}
+
+	if (portals.Num() == 0)
+	{
+		return;
+	}
+
+	// async tiled queries read the portals of every tile under its octree lock, one tile is locked at a time here
+	{
+		FRWScopeLock lock(mOctreeLock, SLT_Write);
+
+		for (const auto& portal : portals)
+		{
+			mPortals.AddUnique(portal.Key, TDPTileLink(&other, portal.Value));
+		}
+
+		mConnectedTiles.AddUnique(&other);
+		mTotalPortals = mPortals.Num();
+	}
+
+	{
+		FRWScopeLock lock(other.mOctreeLock, SLT_Write);
+
+		for (const auto& portal : portals)
+		{
+			other.mPortals.AddUnique(portal.Value, TDPTileLink(this, portal.Key));
+		}
+
+		other.mConnectedTiles.AddUnique(this);
+		other.mTotalPortals = other.mPortals.Num();
+	}
+}
+
+void ATDPVolume::RemovePortals()
+{
+	for (ATDPVolume* tile : mConnectedTiles)
+	{
+		FRWScopeLock lock(tile->mOctreeLock, SLT_Write);
+
+		for (auto it = tile->mPortals.CreateIterator(); it; ++it)
+		{
+			if (it.Value().Volume == this)
+			{
+				it.RemoveCurrent();
+			}
+		}
+
+		tile->mConnectedTiles.Remove(this);
+		tile->mTotalPortals = tile->mPortals.Num();
+	}
+
+	FRWScopeLock lock(mOctreeLock, SLT_Write);
+	mConnectedTiles.Reset();
+	mPortals.Reset();
+	mTotalPortals = 0;
+}
+
+bool ATDPVolume::FindLinkFromPosition(const FVector& position, TDPNodeLink& link) const
+{
+	if (mOctree.Layers.Num() == 0 || !FBox(mOrigin - mExtents, mOrigin + mExtents).IsInside(position))
+	{
+		return false;
+	}
+
+	// same walk as GetLinkFromPosition without the logging, portals sample lots of blocked positions
+	for (int32 layer = mOctree.Layers.Num() - 1; layer >= 0; --layer)
+	{
+		FIntVector voxel;
+		GetVoxelMortonPosition(position, layer, voxel);
+		MortonCodeType code = libmorton::morton3D_64_encode(static_cast<uint_fast32_t>(voxel.X), static_cast<uint_fast32_t>(voxel.Y), static_cast<uint_fast32_t>(voxel.Z));
+
+		NodeIndexType index;
+		if (!mOctree.GetNodeIndexFromMortonCode(layer, code, index))
+		{
+			return false;
+		}
+
+		const auto node = mOctree.GetLayer(layer)[index];
+
+		if (!node.HasChildren())
+		{
+			link = TDPNodeLink(layer, index, 0);
+			return true;
+		}
+
+		if (layer == 0)
+		{
+			const float leafSize = mLayerVoxelHalfSizeCache[0] / 2;
+			FVector nodePosition;
+			GetNodePosition(0, code, nodePosition);
+			const FVector local = (position - nodePosition + FVector(mLayerVoxelHalfSizeCache[0])) / leafSize;
+
+			MortonCodeType subnode = libmorton::morton3D_64_encode(
+				static_cast<uint_fast32_t>(FMath::Clamp(FMath::FloorToInt(local.X), 0, 3)),
+				static_cast<uint_fast32_t>(FMath::Clamp(FMath::FloorToInt(local.Y), 0, 3)),
+				static_cast<uint_fast32_t>(FMath::Clamp(FMath::FloorToInt(local.Z), 0, 3)));
+
+			if (mOctree.GetLeafNode(mOctree.GetFirstChildLink(TDPNodeLink(0, index, 0)).NodeIndex).GetSubnode(subnode))
+			{
+				return false;
+			}
+
+			link = TDPNodeLink(0, index, static_cast<SubnodeIndexType>(subnode));
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ATDPVolume::DrawOctree() const
+{
+	FlushDrawnOctree();
+
+	for (int32 i = 0; i < mOctree.Layers.Num(); ++i)
+	{
+		for (int32 j = 0; j < mOctree.Layers[i].Num(); ++j)
+		{
+			DrawNodeVoxel(i, mOctree.Layers[i][j]);
+		}
+	}
+}
+
+void ATDPVolume::DrawLeafNodes() const
+{
+	FlushDrawnOctree();
+
+	if (mOctree.Layers.Num() > 0)
+	{
+		const auto& layer = mOctree.GetLayer(0);
+		for (int32 i = 0; i < layer.Num(); ++i)
+		{
+			DrawNodeVoxel(0, layer[i]);
+		}
+	}
+}
+
+void ATDPVolume::DrawBlockedMiniLeafNodes() const
+{
+	for (NodeIndexType i = 0; i < mOctree.Layers[0].Num(); ++i)
+	{
+		const auto child = mOctree.GetFirstChildLink(TDPNodeLink(0, i, 0));
+		if (!child.IsValid())
+		{
+			continue;
+		}
+
+		for (int32 j = 0; j < 64; ++j)
+		{
+			if (mOctree.GetLeafNode(child.NodeIndex).GetSubnode(j))
+			{
+				FVector position;
+				TDPNodeLink link{ 0, i, static_cast<SubnodeIndexType>(j) };
+				GetNodePositionFromLink(link, position);
+				DrawNodeVoxel(position, FVector(mLayerVoxelHalfSizeCache[0] / 4), FColor::Emerald);
+			}
+		}
+	}
+}
+
+void ATDPVolume::FlushDrawnOctree() const
+{
+	FlushDebugStrings(GetWorld());
+	FlushPersistentDebugLines(GetWorld());
+}
+
+FVector ATDPVolume::GetRandomPointInVolume() const
+{
+	float x = FMath::RandRange(mOrigin.X - (mExtents.X / 2), mOrigin.X + (mExtents.X / 2));
+	float y = FMath::RandRange(mOrigin.Y - (mExtents.Y / 2), mOrigin.Y + (mExtents.Y / 2));
+	float z = FMath::RandRange(mOrigin.Z - (mExtents.Z / 2), mOrigin.Z + (mExtents.Z / 2));
+
+	return FVector(x, y, z);
+}
+
+void ATDPVolume::RasterizeLowRes()
+{
+	mBlockedIndices.SetNum(mLayers + 1);
+
+	// walk down from the root and only look inside blocked nodes, a node can't be blocked if its parent is free
+	const int32 lowresLayer = 1;
+	TArray<MortonCodeType> codes;
+	TArray<TPair<LayerIndexType, MortonCodeType>> stack;
+	stack.Emplace(static_cast<LayerIndexType>(mLayers), 0);
+
+	while (stack.Num() > 0 && !mGenerationCancelled)
+	{
+		auto current = stack.Pop(false);
+
+		FVector position;
+		GetNodePosition(current.Key, current.Value, position);
+
+		if (IsVoxelBlocked(position, mLayerVoxelHalfSizeCache[current.Key]))
+		{
+			if (current.Key == lowresLayer)
+			{
+				codes.Add(current.Value);
+			}
+			// a volume without layers above 0 has its root below the low res layer, nothing to descend into
+			else if (current.Key > lowresLayer)
+			{
+				for (int32 child = 0; child < 8; ++child)
+				{
+					stack.Emplace(static_cast<LayerIndexType>(current.Key - 1), (current.Value << 3) + child);
+				}
+			}
+		}
+	}
+
+	// blocked indices in position i hold the blocked codes of layer i + 1
+	auto totalCodes = [this](int32 layer) -> MortonCodeType
+	{
+		return layer <= mLayers ? GetNodeAmountInLayer(layer) : 1;
+	};
+
+	mBlockedIndices[0].Build(codes, totalCodes(lowresLayer));
+
+	for (int32 i = 0; i < mLayers; ++i)
+	{
+		// your parent is eight times you, sorted codes give sorted parents so duplicates are next to each other
+		int32 total = 0;
+		for (int32 j = 0; j < codes.Num(); ++j)
+		{
+			MortonCodeType parent = codes[j] >> 3;
+			if (total == 0 || codes[total - 1] != parent)
+			{
+				codes[total++] = parent;
+			}
+		}
+
+		codes.SetNum(total, false);
+		mBlockedIndices[i + 1].BuildSorted(codes, totalCodes(i + 2));
+	}
+}
+
+void ATDPVolume::GetLayerCodes(LayerIndexType layer, TArray<MortonCodeType>& codes) const
+{
+	// only the children of blocked parents exist in a layer
+	const MortonCodeType nodes = GetNodeAmountInLayer(layer);
+
+	codes.Reset(mBlockedIndices[layer].Num() * 8);
+	mBlockedIndices[layer].ForEach([&codes, nodes](MortonCodeType parent)
+	{
+		// sorted parents give sorted children
+		for (MortonCodeType child = parent << 3; child < (parent << 3) + 8 && child < nodes; ++child)
+		{
+			codes.Add(child);
+		}
+	});
+}
+
+void ATDPVolume::RasterizeLayer(TDPTree& octree, LayerIndexType layer)
+{
+	if (layer == 0)
+	{
+		// allocate space for all leaf layer nodes
+		// we know this value from lowres rasterize
+		octree.Layers[layer].Reserve(mBlockedIndices[layer].Num() * 8);
+
+		TArray<MortonCodeType> codes;
+		GetLayerCodes(layer, codes);
+
+		// add the nodes first so they stay sorted by morton code
+		for (MortonCodeType code : codes)
+		{
+			octree.GetLayer(layer).Add(code);
+		}
+
+		// leaves are rasterized into a scratch array, only partially blocked ones are stored in the octree afterwards
+		TArray<TDPLeafNode> leaves;
+		leaves.SetNum(codes.Num());
+
+		bool forceSingleThread = !mParallelGeneration;
+#if WITH_EDITOR
+		// debug drawing is only allowed from the game thread
+		forceSingleThread |= DrawOnlyBlockedLeafVoxels || DrawLeafVoxels || DrawMiniLeafVoxels || DrawLeafMortonCodes || DrawCollisionVoxels;
+#endif
+
+		// every node only writes to its own leaf slot, so no locks are needed
+		auto& octreeLayer = octree.GetLayer(layer);
+		ParallelFor(octreeLayer.Num(), [this, &leaves, &octreeLayer, layer](int32 nodeIndex)
+		{
+			if (mGenerationCancelled)
+			{
+				return;
+			}
+
+			TDPNode node = octreeLayer[nodeIndex];
+
+			FVector nodePosition;
+			GetNodePosition(layer, node.GetMortonCode(), nodePosition);
+
+			if (IsVoxelBlocked(nodePosition, mLayerVoxelHalfSizeCache[layer], true))
+			{
+				FVector origin = nodePosition - FVector(mLayerVoxelHalfSizeCache[layer]);
+				RasterizeLeafNode(leaves[nodeIndex], origin, nodeIndex);
+#if WITH_EDITOR
+				// Debug
+				if (DrawOnlyBlockedLeafVoxels && IsInGameThread())
+				{
+					DrawNodeVoxel(nodePosition, FVector(mLayerVoxelHalfSizeCache[layer]), DebugHelper::LayerColors[layer]);
+				}
+#endif
+			}
+
+#if WITH_EDITOR
+			// Debug
+			if (DrawLeafVoxels && !DrawOnlyBlockedLeafVoxels && IsInGameThread())
+			{
+				DrawNodeVoxel(nodePosition, FVector(mLayerVoxelHalfSizeCache[layer]), DebugHelper::LayerColors[layer]);
+			}
+#endif
+
+			mGenerationStepProcessedNodes.Increment();
+		}, forceSingleThread);
+
+		for (int32 i = 0; i < leaves.Num(); ++i)
+		{
+			octree.SetLeafNode(i, leaves[i]);
+		}
+	}
+	else if (octree.GetLayer(layer - 1).Num() > 0)
+	{
+		octree.Layers[layer].Reserve(mBlockedIndices[layer].Num() * 8);
+
+		TArray<MortonCodeType> codes;
+		GetLayerCodes(layer, codes);
+
+		for (MortonCodeType code : codes)
+		{
+			if (mGenerationCancelled)
+			{
+				return;
+			}
+
+			// Add new node
+			int32 nodeIndex = octree.GetLayer(layer).Add(code);
+			TDPNode node = octree.GetLayer(layer)[nodeIndex];
+
+			FVector nodePosition;
+			GetNodePosition(layer, node.GetMortonCode(), nodePosition);
+
+			NodeIndexType firstChildIndex;
+			if (octree.GetNodeIndexFromMortonCode(layer - 1, node.GetMortonCode() << 3, firstChildIndex))
+			{
+				// set parent -> first child link
+				auto& firstChild = node.GetFirstChild();
+				firstChild.SetLayerIndex(layer - 1);
+				firstChild.SetNodeIndex(firstChildIndex);
+
+				// set children -> parent links (exactly 8 children)
+				auto& octreeLayer = octree.GetLayer(layer - 1);
+				for (int32 childOffset = 0; childOffset < 8; ++childOffset)
+				{
+					auto& parent = octreeLayer[firstChildIndex + childOffset].GetParent();
+					parent.SetLayerIndex(layer);
+					parent.SetNodeIndex(nodeIndex);
+				}
+
+#if WITH_EDITOR
+				// Debug
+				if (DrawParentChildLinks && IsInGameThread())
+				{
+					FVector startPosition, endPosition;
+					GetNodePosition(layer, node.GetMortonCode(), startPosition);
+					GetNodePosition(layer - 1, node.GetMortonCode() << 3, endPosition);
+					DrawDebugDirectionalArrow(GetWorld(), startPosition, endPosition, LinkSize, DebugHelper::LayerColors[layer], true);
+				}
+#endif
+			}
+			else
+			{
+				// if no children then invalidate link
+				auto& firstChild = node.GetFirstChild();
+				firstChild.Invalidate();
+			}
+
+#if WITH_EDITOR
+			// Debug
+			if (DrawVoxels && IsInGameThread())
+			{
+				DrawNodeVoxel(nodePosition, FVector(mLayerVoxelHalfSizeCache[layer]), DebugHelper::LayerColors[layer]);
+			}
+#endif
+
+			mGenerationStepProcessedNodes.Increment();
+		}
+	}
+}
+
+void ATDPVolume::RasterizeLeafNode(TDPLeafNode& leafNode, const FVector& origin, NodeIndexType leaf)
+{
+	const int32 totalOctants = 8;
+	const float leafSize = mLayerVoxelHalfSizeCache[0] / 2; // 64 leaves per leaf node (cached value is already half)
+
+	// node fully inside the geometry, no need to look at each leaf
+	if (IsVoxelContained(origin + FVector(mLayerVoxelHalfSizeCache[0]), mLayerVoxelHalfSizeCache[0]))
+	{
+		leafNode.GetSubnodes() = ~0ULL;
+
+#if WITH_EDITOR
+		// Debug
+		if (DrawMiniLeafVoxels && IsInGameThread())
+		{
+			DrawNodeVoxel(origin + FVector(mLayerVoxelHalfSizeCache[0]), FVector(mLayerVoxelHalfSizeCache[0]), FColor::Emerald);
+		}
+#endif
+
+		return;
+	}
+
+	// overlap queries can't tell a contained octant, a blocked node would pay 8 octant tests on top of its 64 leaves
+	const bool testOctants = mGeometryRasterizer.IsReady();
+
+	// leaves are morton ordered, each octant of the node holds 8 consecutive leaves
+	for (int32 octant = 0; octant < totalOctants; ++octant)
+	{
+		uint_fast32_t x, y, z;
+		bool contained = false;
+
+		if (testOctants)
+		{
+			libmorton::morton3D_64_decode(octant, x, y, z);
+			FVector octantPosition = origin + FVector(x * leafSize * 2, y * leafSize * 2, z * leafSize * 2) + FVector(leafSize);
+
+			// no leaf can be blocked inside a free octant, nodes that only touch geometry skip most of their leaves here
+			if (!IsVoxelBlocked(octantPosition, leafSize, true))
+			{
+				continue;
+			}
+
+			contained = IsVoxelContained(octantPosition, leafSize);
+		}
+
+		for (int32 i = octant * 8; i < (octant + 1) * 8; ++i)
+		{
+			libmorton::morton3D_64_decode(i, x, y, z);
+			FVector position = origin + FVector(x * leafSize, y * leafSize, z * leafSize) + FVector(leafSize / 2);
+
+			if (contained || IsVoxelBlocked(position, leafSize / 2, true))
+			{
+				leafNode.SetSubnode(i);
+
+#if WITH_EDITOR
+				// Debug
+				if (DrawMiniLeafVoxels && IsInGameThread())
+				{
+					DrawNodeVoxel(position, FVector(leafSize / 2), FColor::Emerald);
+				}
+
+				if (DrawLeafMortonCodes && IsInGameThread())
+				{
+					DrawDebugString(GetWorld(), position, FString::FromInt(leaf) + ":" + FString::FromInt(i), nullptr, FColor::Emerald);
+				}
+#endif
+			}
+		}
+	}
+}
+
+void ATDPVolume::SetNeighborLinks(TDPTree& octree, const LayerIndexType layer)
+{
+	auto& octreeLayer = octree.GetLayer(layer);
+
+	bool forceSingleThread = !mParallelGeneration;
+#if WITH_EDITOR
+	// debug drawing is only allowed from the game thread
+	forceSingleThread |= DrawValidNeighborLinks || DrawInvalidNeighborLinks;
+#endif
+
+	// every node only writes its own links, the rest of the octree is only read
+	ParallelFor(octreeLayer.Num(), [this, &octree, layer](int32 i)
+	{
+		if (mGenerationCancelled)
+		{
+			return;
+		}
+
+		SetNodeNeighborLinks(octree, layer, i);
+
+		mGenerationStepProcessedNodes.Increment();
+	}, forceSingleThread);
+}
+
+void ATDPVolume::SetNodeNeighborLinks(TDPTree& octree, const LayerIndexType layer, const NodeIndexType nodeIndex)
+{
+	auto node = octree.GetLayer(layer)[nodeIndex];
+	FVector nodePosition;
+	GetNodePosition(layer, node.GetMortonCode(), nodePosition);
+
+	// at most 6 neighbors, each face
+	for (int32 j = 0; j < 6; ++j)
+	{
+		auto& link = node.GetNeighbors()[j];
+
+		NodeIndexType currentNodeIndex = nodeIndex;
+		auto currentLayer = layer;
+		// find the closest neighbor, start by looking in the current node's layer
+		// go up the layers if no valid neighbor was found in that layer
+		while (!FindNeighborLink(octree, currentLayer, currentNodeIndex, j, link, nodePosition)
+			&& currentLayer < octree.Layers.Num() - 2)
+		{
+			auto& parentLink = octree.GetLayer(currentLayer)[currentNodeIndex].GetParent();
+			if (parentLink.IsValid())
+			{
+				currentNodeIndex = parentLink.NodeIndex;
+				currentLayer = parentLink.LayerIndex;
+			}
+			else
+			{
+				++currentLayer;
+				octree.GetNodeIndexFromMortonCode(currentLayer, node.GetMortonCode() >> 3, currentNodeIndex);
+			}
+		}
+	}
+}
+
+bool ATDPVolume::FindNeighborLink(const TDPTree& octree, const LayerIndexType layerIndex, const NodeIndexType nodeIndex, uint8 direction, TDPNodeLink& link, const FVector& nodePosition)
+{
+	const auto& layer = octree.GetLayer(layerIndex);
+	const auto node = layer[nodeIndex];
+	int32 maxCoordinate = static_cast<int32>(FMath::Pow(2, (mLayers - layerIndex)));
+
+	uint_fast32_t x, y, z;
+	libmorton::morton3D_64_decode(node.GetMortonCode(), x, y, z);
+
+	FIntVector signedPosition(static_cast<int32>(x), static_cast<int32>(y), static_cast<int32>(z));
+	signedPosition += NodeHelper::NeighborDirections[direction];
+
+	// invalidate link if neighbor coordinates are out of bounds
+	if (signedPosition.X < 0 || signedPosition.X >= maxCoordinate ||
+		signedPosition.Y < 0 || signedPosition.Y >= maxCoordinate ||
+		signedPosition.Z < 0 || signedPosition.Z >= maxCoordinate)
+	{
+		link.Invalidate();
+
+#if WITH_EDITOR
+		// Debug
+		if (DrawInvalidNeighborLinks && IsInGameThread())
+		{
+			FVector startPosition, endPosition;
+			GetNodePosition(layerIndex, node.GetMortonCode(), startPosition);
+			endPosition = startPosition + (FVector(NodeHelper::NeighborDirections[direction]) * mLayerVoxelHalfSizeCache[layerIndex] * 2);
+			DrawDebugDirectionalArrow(GetWorld(), startPosition, endPosition, LinkSize, FColor::Red, true);
+		}
+#endif
+
+		return true;
+	}
+
+	x = signedPosition.X;
+	y = signedPosition.Y;
+	z = signedPosition.Z;
+
+	MortonCodeType neighborCode = libmorton::morton3D_64_encode(x, y, z);
+
+	// layers are sorted by morton code so the neighbor can be found with a binary search
+	NodeIndexType neighborIndex;
+	if (!octree.GetNodeIndexFromMortonCode(layerIndex, neighborCode, neighborIndex))
+	{
+		return false;
+	}
+
+	const auto neighborNode = layer[neighborIndex];
+
+	if (layerIndex == 0 &&
+		neighborNode.HasChildren() &&
+		neighborNode.GetFirstChild().NodeIndex == TDPTree::FullyBlockedLeaf)
+	{
+		link.Invalidate();
+		return true;
+	}
+
+	link.SetLayerIndex(layerIndex);
+	link.SetNodeIndex(neighborIndex);
+
+#if WITH_EDITOR
+	// Debug
+	if (DrawValidNeighborLinks && IsInGameThread())
+	{
+		FVector endPosition;
+		GetNodePosition(layerIndex, neighborCode, endPosition);
+		DrawDebugDirectionalArrow(GetWorld(), nodePosition, endPosition, LinkSize, DebugHelper::LayerColors[layerIndex], true);
+	}
+#endif
+
+	return true;
 }
 
 void ATDPVolume::UpdateOctree()
 {
+	LLM_SCOPED_SINGLE_STAT_TAG(STAT_CinnamonLLM);
 	if (mOptimizedDynamicUpdate)
 	{
 		TSet<TDPNodeLink> dirtySet;
@@ -579,7 +1308,7 @@ void ATDPVolume::UpdateOctree()
 		for (auto& link : dirtyArray)
 		{
 			const auto node = GetNodeFromLink(link);
-			codes.Emplace(static_cast<LayerIndexType>(link.LayerIndex), node->GetMortonCode());
+			codes.Emplace(static_cast<LayerIndexType>(link.LayerIndex), node.GetMortonCode());
 		}
 
 		for (auto& pair : codes)
@@ -591,13 +1320,19 @@ void ATDPVolume::UpdateOctree()
 			}
 		}
 
+		// the node updates dropped the lookups, the loops below only search
+		if (mHashedLookup)
+		{
+			mOctree.BuildLookups();
+		}
+
 		// gather orphans
 		codes.Reset();
 		for (int32 i = mLayers - 2; i >= 0; --i)
 		{
 			for (int32 j = 0; j < mOctree.Layers[i].Num(); ++j)
 			{
-				auto& node = mOctree.Layers[i][j];
+				auto node = mOctree.Layers[i][j];
 
 				NodeIndexType index;
 				if (!GetNodeIndexFromMortonCode(i + 1, node.GetMortonCode() >> 3, index))
@@ -615,12 +1350,7 @@ void ATDPVolume::UpdateOctree()
 			if (GetNodeIndexFromMortonCode(pair.Key, pair.Value, index))
 			{
 				int32 first = index - (index % 8);
-				mOctree.Layers[pair.Key].RemoveAt(first, 8);				
-
-				if (pair.Key == 0)
-				{
-					mOctree.LeafNodes.RemoveAt(first, 8);
-				}
+				mOctree.RemoveLayerNodes(pair.Key, first, 8);
 			}
 		}
 
@@ -661,12 +1391,17 @@ void ATDPVolume::UpdateOctree()
 			}
 		}*/
 
+		if (mHashedLookup)
+		{
+			mOctree.BuildLookups();
+		}
+
 		// fix parent-child links
 		for (int32 i = mLayers - 2; i >= 0; --i)
 		{
 			for (int32 j = 0; j < mOctree.Layers[i].Num(); ++j)
 			{
-				auto& node = mOctree.Layers[i][j];
+				auto node = mOctree.Layers[i][j];
 
 				NodeIndexType index;
 				bool result = GetNodeIndexFromMortonCode(i + 1, node.GetMortonCode() >> 3, index);
@@ -680,15 +1415,6 @@ void ATDPVolume::UpdateOctree()
 			}
 		}
 
-		// fix leaf parent-child links
-		for (int32 i = 0; i < mOctree.Layers[0].Num(); ++i)
-		{
-			auto& child = mOctree.Layers[0][i].GetFirstChild();
-			child.SetLayerIndex(0);
-			child.SetNodeIndex(i);
-			child.SetSubnodeIndex(0);
-		}
-
 		if (DrawMiniLeafVoxels)
 		{
 			DrawBlockedMiniLeafNodes();
@@ -697,9 +1423,16 @@ void ATDPVolume::UpdateOctree()
 		// fix neighbor links
 		for (int32 i = mLayers - 2; i >= 0; --i)
 		{
-			SetNeighborLinks(i);
+			SetNeighborLinks(mOctree, i);
+		}
+
+		if (mCachedPositions)
+		{
+			mOctree.BuildPositions(mOrigin - mExtents, mLayerVoxelHalfSizeCache);
 		}
 
+		RebuildGraph();
+
 		for (auto obstacle : mPendingDynamicObstacles)
 		{
 			check(IsValid(obstacle));
@@ -715,10 +1448,10 @@ void ATDPVolume::UpdateOctree()
 void ATDPVolume::UpdateNode(const TDPNodeLink link)
 {
 	const auto node = GetNodeFromLink(link);
-	check(node != nullptr);
+	check(node.IsValid());
 
 	FVector nodePosition;
-	GetNodePosition(link.LayerIndex, node->GetMortonCode(), nodePosition);
+	GetNodePosition(link.LayerIndex, node.GetMortonCode(), nodePosition);
 
 	if (IsVoxelBlocked(nodePosition, mLayerVoxelHalfSizeCache[link.LayerIndex], true))
 	{
@@ -735,7 +1468,7 @@ void ATDPVolume::UpdateNode(const TDPNodeLink link)
 			{
 				auto currentLink = stack.Pop();
 				auto currentNode = GetNodeFromLink(currentLink);
-				GetNodePosition(currentLink.LayerIndex, currentNode->GetMortonCode(), nodePosition);
+				GetNodePosition(currentLink.LayerIndex, currentNode.GetMortonCode(), nodePosition);
 
 				if (IsVoxelBlocked(nodePosition, mLayerVoxelHalfSizeCache[currentLink.LayerIndex], true))
 				{
@@ -745,11 +1478,11 @@ void ATDPVolume::UpdateNode(const TDPNodeLink link)
 					}
 					else
 					{
-						if (currentNode->HasChildren())
+						if (currentNode.HasChildren())
 						{
 							for (int32 i = 0; i < 8; ++i)
 							{
-								auto childLink = currentNode->GetFirstChild();
+								auto childLink = currentNode.GetFirstChild();
 								childLink.NodeIndex += i;
 								stack.Emplace(childLink);
 							}
@@ -758,44 +1491,45 @@ void ATDPVolume::UpdateNode(const TDPNodeLink link)
 						{
 							LayerIndexType childLayer = currentLink.LayerIndex - 1;
 
-							NodeIndexType index = FindInsertIndex(childLayer, currentNode->GetMortonCode() << 3);
+							NodeIndexType index = FindInsertIndex(childLayer, currentNode.GetMortonCode() << 3);
 							mOctree.Layers[childLayer].InsertDefaulted(index, 8);
 
-							currentNode->SetFirstChild(TDPNodeLink(childLayer, index, 0));
+							currentNode.SetFirstChild(TDPNodeLink(childLayer, index, 0));
 
 							for (int32 i = 0; i < 8; ++i)
 							{
-								auto& child = mOctree.Layers[childLayer][index + i];
+								auto child = mOctree.Layers[childLayer][index + i];
 								child.SetParent(currentLink);
-								child.SetMortonCode((currentNode->GetMortonCode() << 3) + i);
+								child.SetMortonCode((currentNode.GetMortonCode() << 3) + i);
 								stack.Emplace(childLayer, index + i, 0);
 							}
-
-							if (currentLink.LayerIndex == 1)
-							{
-								mOctree.LeafNodes.InsertDefaulted(index, 8);
-							}
 						}
 					}
 				}
 			}
 		}
 	}
-	else if (node->GetParent().IsValid())
+	else if (node.GetParent().IsValid())
 	{
+		// a free leaf layer node does not keep a leaf
+		if (link.LayerIndex == 0)
+		{
+			mOctree.SetLeafNode(link.NodeIndex, TDPLeafNode());
+		}
+
 		// we might need to remove this node and its siblings if all are free now
 		TArray<TPair<LayerIndexType, MortonCodeType>> childCodes;
 
 		NodeIndexType index;
-		if (GetNodeIndexFromMortonCode(link.LayerIndex + 1, node->GetMortonCode() >> 3, index))
+		if (GetNodeIndexFromMortonCode(link.LayerIndex + 1, node.GetMortonCode() >> 3, index))
 		{
 			auto parentLink = TDPNodeLink(link.LayerIndex + 1, index, 0);
 			auto parentNode = GetNodeFromLink(parentLink);
-			GetNodePosition(parentLink.LayerIndex, parentNode->GetMortonCode(), nodePosition);
+			GetNodePosition(parentLink.LayerIndex, parentNode.GetMortonCode(), nodePosition);
 
 			while (!IsVoxelBlocked(nodePosition, mLayerVoxelHalfSizeCache[parentLink.LayerIndex], true))
 			{
-				auto childLink = parentNode->GetFirstChild();
+				auto childLink = parentNode.GetFirstChild();
 
 				if (!childLink.IsValid())
 				{
@@ -804,15 +1538,15 @@ void ATDPVolume::UpdateNode(const TDPNodeLink link)
 
 				auto childNode = GetNodeFromLink(childLink);
 
-				if (childNode == nullptr)
+				if (!childNode.IsValid())
 				{
 					break;
 				}
 
-				childCodes.Emplace(static_cast<LayerIndexType>(childLink.LayerIndex), childNode->GetMortonCode());
-				parentNode->GetFirstChild().Invalidate();
+				childCodes.Emplace(static_cast<LayerIndexType>(childLink.LayerIndex), childNode.GetMortonCode());
+				parentNode.GetFirstChild().Invalidate();
 
-				bool result = GetNodeIndexFromMortonCode(parentLink.LayerIndex + 1, parentNode->GetMortonCode() >> 3, index);
+				bool result = GetNodeIndexFromMortonCode(parentLink.LayerIndex + 1, parentNode.GetMortonCode() >> 3, index);
 
 				if (!result)
 				{
@@ -827,7 +1561,7 @@ void ATDPVolume::UpdateNode(const TDPNodeLink link)
 				}
 
 				parentNode = GetNodeFromLink(parentLink);
-				GetNodePosition(parentLink.LayerIndex, parentNode->GetMortonCode(), nodePosition);
+				GetNodePosition(parentLink.LayerIndex, parentNode.GetMortonCode(), nodePosition);
 			}
 
 			for (auto& pair : childCodes)
@@ -836,22 +1570,14 @@ void ATDPVolume::UpdateNode(const TDPNodeLink link)
 				bool result = GetNodeIndexFromMortonCode(pair.Key, pair.Value, index);
 				check(result);
 
-				mOctree.Layers[pair.Key].RemoveAt(index, 8);
-				if (pair.Key == 0)
-				{
-					mOctree.LeafNodes.RemoveAt(index, 8);
-				}
+				mOctree.RemoveLayerNodes(pair.Key, index, 8);
 			}
 		}
 		else
 		{
 			int32 first = link.NodeIndex - (link.NodeIndex % 8);
 
-			mOctree.Layers[link.LayerIndex].RemoveAt(first, 8);
-			if (link.LayerIndex == 0)
-			{
-				mOctree.LeafNodes.RemoveAt(first, 8);
-			}
+			mOctree.RemoveLayerNodes(link.LayerIndex, first, 8);
 		}
 	}
 }
@@ -879,7 +1605,442 @@ void ATDPVolume::UpdateLeafNode(const FVector& origin, NodeIndexType leaf)
 		}
 	}
 
-	mOctree.LeafNodes[leaf] = newLeaf;
+	mOctree.SetLeafNode(leaf, newLeaf);
+}
+
+bool ATDPVolume::RegenerateRegion(const FBox& region)
+{
+	LLM_SCOPED_SINGLE_STAT_TAG(STAT_CinnamonLLM);
+	// a background generation replaces the whole octree anyway
+	if (IsGenerating() || mTotalLayers == 0 || mOctree.Layers.Num() != mTotalLayers)
+	{
+		return false;
+	}
+
+	if (!region.Intersect(FBox(mOrigin - mExtents, mOrigin + mExtents)))
+	{
+		return false;
+	}
+
+#if WITH_EDITOR
+	auto startTime = std::chrono::high_resolution_clock::now();
+#endif
+
+	// the region touches at most two voxels per axis in the first layer with voxels as big as the region
+	const float regionSize = region.GetSize().GetMax();
+	LayerIndexType regionLayer = 0;
+	while (regionLayer < mLayers && mLayerVoxelHalfSizeCache[regionLayer] * 2 < regionSize)
+	{
+		++regionLayer;
+	}
+
+	const int32 maxCoordinate = 1 << (mLayers - regionLayer);
+	FIntVector min, max;
+	GetVoxelMortonPosition(region.Min, regionLayer, min);
+	GetVoxelMortonPosition(region.Max, regionLayer, max);
+
+	// the subtrees to rebuild hang from the lowest existing node over each touched voxel
+	TArray<TPair<LayerIndexType, MortonCodeType>> touched;
+	bool missingRoot = false;
+	for (int32 z = FMath::Max(min.Z, 0); z <= FMath::Min(max.Z, maxCoordinate - 1); ++z)
+	{
+		for (int32 y = FMath::Max(min.Y, 0); y <= FMath::Min(max.Y, maxCoordinate - 1); ++y)
+		{
+			for (int32 x = FMath::Max(min.X, 0); x <= FMath::Min(max.X, maxCoordinate - 1); ++x)
+			{
+				LayerIndexType layer = regionLayer;
+				MortonCodeType code = libmorton::morton3D_64_encode(x, y, z);
+
+				NodeIndexType index;
+				while (layer < mLayers && !mOctree.GetNodeIndexFromMortonCode(layer, code, index))
+				{
+					++layer;
+					code >>= 3;
+				}
+
+				// nothing was blocked under this voxel, not even in the top layer
+				if (!mOctree.GetNodeIndexFromMortonCode(layer, code, index))
+				{
+					missingRoot = true;
+				}
+
+				touched.AddUnique(TPair<LayerIndexType, MortonCodeType>(layer, code));
+			}
+		}
+	}
+
+	// splicing only rebuilds below existing nodes, a root that was never blocked needs the whole octree
+	if (missingRoot)
+	{
+#if WITH_EDITOR
+		UE_LOG(CinnamonLog, Log, TEXT("RegenerateRegion: region has no existing root node, generating the whole octree."));
+#endif
+		Generate();
+		return mTotalLayers > 0;
+	}
+
+	// drop the subtrees that are already inside a bigger one
+	TArray<TPair<LayerIndexType, MortonCodeType>> roots;
+	FBox rootBounds(ForceInit);
+	for (const auto& root : touched)
+	{
+		const bool covered = touched.ContainsByPredicate([&root](const TPair<LayerIndexType, MortonCodeType>& other)
+		{
+			return other.Key > root.Key && (root.Value >> (3 * (other.Key - root.Key))) == other.Value;
+		});
+
+		if (!covered)
+		{
+			roots.Add(root);
+
+			FVector position;
+			GetNodePosition(root.Key, root.Value, position);
+			rootBounds += FBox(position - FVector(mLayerVoxelHalfSizeCache[root.Key]), position + FVector(mLayerVoxelHalfSizeCache[root.Key]));
+		}
+	}
+
+	GatherGeometry(rootBounds);
+
+	// rasterize the subtrees again, top down, children only exist below blocked nodes
+	TArray<TArray<MortonCodeType>> newCodes;
+	TArray<TArray<TPair<MortonCodeType, MortonCodeType>>> removedRanges;
+	newCodes.SetNum(mTotalLayers);
+	removedRanges.SetNum(mTotalLayers);
+
+	for (const auto& root : roots)
+	{
+		TArray<MortonCodeType> parents;
+		TArray<MortonCodeType> children;
+		parents.Add(root.Value);
+
+		for (int32 layer = root.Key - 1; layer >= 0; --layer)
+		{
+			const int32 depth = 3 * (root.Key - layer);
+			removedRanges[layer].Emplace(root.Value << depth, (root.Value + 1) << depth);
+
+			children.Reset();
+			for (MortonCodeType parent : parents)
+			{
+				FVector position;
+				GetNodePosition(layer + 1, parent, position);
+
+				if (IsVoxelBlocked(position, mLayerVoxelHalfSizeCache[layer + 1]))
+				{
+					for (int32 child = 0; child < 8; ++child)
+					{
+						children.Add((parent << 3) + child);
+					}
+				}
+			}
+
+			newCodes[layer].Append(children);
+			Swap(parents, children);
+		}
+	}
+
+	for (int32 layer = 0; layer < mTotalLayers; ++layer)
+	{
+		newCodes[layer].Sort();
+		removedRanges[layer].Sort([](const TPair<MortonCodeType, MortonCodeType>& a, const TPair<MortonCodeType, MortonCodeType>& b)
+		{
+			return a.Key < b.Key;
+		});
+
+		// removed nodes are not counted, but a layer this close to the limit needs a full generation anyway
+		if (mOctree.GetLayer(layer).Num() + static_cast<int64>(newCodes[layer].Num()) > TDPNodeLink::MaxNodeIndex + 1LL)
+		{
+#if WITH_EDITOR
+			UE_LOG(CinnamonLog, Error, TEXT("RegenerateRegion: layer %d would exceed the %d nodes node links can address."), layer, TDPNodeLink::MaxNodeIndex + 1);
+#endif
+			mGeometryRasterizer.Reset();
+			return false;
+		}
+	}
+
+	// leaf layer nodes get a leaf if they are blocked, same as a full generation
+	TArray<TDPLeafNode> newLeaves;
+	newLeaves.SetNum(newCodes[0].Num());
+
+	bool forceSingleThread = !mParallelGeneration;
+#if WITH_EDITOR
+	// debug drawing is only allowed from the game thread
+	forceSingleThread |= DrawMiniLeafVoxels || DrawLeafMortonCodes || DrawCollisionVoxels;
+#endif
+
+	ParallelFor(newCodes[0].Num(), [this, &newCodes, &newLeaves](int32 i)
+	{
+		FVector position;
+		GetNodePosition(0, newCodes[0][i], position);
+
+		if (IsVoxelBlocked(position, mLayerVoxelHalfSizeCache[0], true))
+		{
+			RasterizeLeafNode(newLeaves[i], position - FVector(mLayerVoxelHalfSizeCache[0]), i);
+		}
+	}, forceSingleThread);
+
+	// async path queries hold the read lock while searching, it's released before the portals lock the tiles
+	mOctreeLock.WriteLock();
+
+	// splicing moves links around, a compact octree gets its links back for the duration
+	mOctree.Expand();
+
+	// splice the new nodes in place of the old subtrees, keeping every layer sorted by morton code
+	TArray<TArray<int32>> remap;
+	TArray<TArray<NodeIndexType>> inserted;
+	remap.SetNum(mTotalLayers);
+	inserted.SetNum(mTotalLayers);
+
+	for (int32 layer = 0; layer < mTotalLayers; ++layer)
+	{
+		const auto& ranges = removedRanges[layer];
+		if (ranges.Num() == 0)
+		{
+			continue;
+		}
+
+		auto& octreeLayer = mOctree.GetLayer(layer);
+		const auto& codes = newCodes[layer];
+
+		TDPLayer nodes;
+		nodes.Reserve(octreeLayer.Num() + codes.Num());
+		remap[layer].Init(INDEX_NONE, octreeLayer.Num());
+
+		int32 oldIndex = 0;
+		int32 newIndex = 0;
+		int32 range = 0;
+
+		while (oldIndex < octreeLayer.Num() || newIndex < codes.Num())
+		{
+			// new codes and kept codes never match, the new ones only live inside removed ranges
+			if (newIndex < codes.Num() && (oldIndex == octreeLayer.Num() || codes[newIndex] < octreeLayer[oldIndex].GetMortonCode()))
+			{
+				inserted[layer].Add(nodes.Num());
+				nodes.Add(codes[newIndex]);
+				++newIndex;
+				continue;
+			}
+
+			const MortonCodeType code = octreeLayer[oldIndex].GetMortonCode();
+			while (range < ranges.Num() && ranges[range].Value <= code)
+			{
+				++range;
+			}
+
+			if (range == ranges.Num() || code < ranges[range].Key)
+			{
+				remap[layer][oldIndex] = nodes.Num();
+				nodes.Add(octreeLayer, oldIndex);
+			}
+			else if (layer == 0)
+			{
+				// give the leaf of the removed node back
+				mOctree.SetLeafNode(oldIndex, TDPLeafNode());
+			}
+
+			++oldIndex;
+		}
+
+		octreeLayer = MoveTemp(nodes);
+	}
+
+	// the spliced layers lost their lookups, relinking below searches a lot
+	if (mHashedLookup)
+	{
+		mOctree.BuildLookups();
+	}
+
+	// move the links of the kept nodes to the new indices, links into removed nodes are fixed below
+	auto remapLink = [&remap](TDPNodeLink& link)
+	{
+		if (link.IsValid() && remap[link.LayerIndex].Num() > 0)
+		{
+			const int32 index = remap[link.LayerIndex][link.NodeIndex];
+			if (index == INDEX_NONE)
+			{
+				link.Invalidate();
+			}
+			else
+			{
+				link.SetNodeIndex(index);
+			}
+		}
+	};
+
+	const bool remapped = remap.ContainsByPredicate([](const TArray<int32>& layerRemap) { return layerRemap.Num() > 0; });
+	for (int32 layer = 0; layer < mTotalLayers && remapped; ++layer)
+	{
+		auto& octreeLayer = mOctree.GetLayer(layer);
+		for (NodeIndexType index = 0; index < octreeLayer.Num(); ++index)
+		{
+			remapLink(octreeLayer.GetParent(index));
+
+			// leaf links do not point into a layer
+			if (layer > 0)
+			{
+				remapLink(octreeLayer.GetFirstChild(index));
+			}
+
+			for (int32 i = 0; i < 6; ++i)
+			{
+				remapLink(octreeLayer.GetNeighbors(index)[i]);
+			}
+		}
+	}
+
+	// parent and child links of the new nodes
+	for (int32 layer = 0; layer < mTotalLayers; ++layer)
+	{
+		for (int32 i = 0; i < inserted[layer].Num(); ++i)
+		{
+			const NodeIndexType nodeIndex = inserted[layer][i];
+			auto node = mOctree.GetLayer(layer)[nodeIndex];
+
+			NodeIndexType index;
+			if (mOctree.GetNodeIndexFromMortonCode(layer + 1, node.GetMortonCode() >> 3, index))
+			{
+				node.SetParent(TDPNodeLink(layer + 1, index, 0));
+			}
+
+			if (layer == 0)
+			{
+				mOctree.SetLeafNode(nodeIndex, newLeaves[i]);
+			}
+			else if (mOctree.GetNodeIndexFromMortonCode(layer - 1, node.GetMortonCode() << 3, index))
+			{
+				node.SetFirstChild(TDPNodeLink(layer - 1, index, 0));
+			}
+		}
+	}
+
+	// the roots keep their place, only their children changed
+	TArray<TArray<NodeIndexType>> relink;
+	relink.SetNum(mTotalLayers);
+
+	for (const auto& root : roots)
+	{
+		NodeIndexType rootIndex;
+		bool result = mOctree.GetNodeIndexFromMortonCode(root.Key, root.Value, rootIndex);
+		check(result);
+
+		auto rootNode = mOctree.GetLayer(root.Key)[rootIndex];
+		FVector position;
+		GetNodePosition(root.Key, root.Value, position);
+
+		if (root.Key == 0)
+		{
+			TDPLeafNode leaf;
+
+			if (IsVoxelBlocked(position, mLayerVoxelHalfSizeCache[0], true))
+			{
+				RasterizeLeafNode(leaf, position - FVector(mLayerVoxelHalfSizeCache[0]), rootIndex);
+			}
+
+			mOctree.SetLeafNode(rootIndex, leaf);
+		}
+		else
+		{
+			NodeIndexType index;
+			if (mOctree.GetNodeIndexFromMortonCode(root.Key - 1, root.Value << 3, index))
+			{
+				rootNode.SetFirstChild(TDPNodeLink(root.Key - 1, index, 0));
+			}
+			else
+			{
+				rootNode.GetFirstChild().Invalidate();
+			}
+		}
+
+		relink[root.Key].Add(rootIndex);
+
+		// only the nodes on the other side of each face of the subtree can see a different neighbor
+		uint_fast32_t x, y, z;
+		libmorton::morton3D_64_decode(root.Value, x, y, z);
+		const int32 rootMaxCoordinate = 1 << (mLayers - root.Key);
+
+		for (int32 direction = 0; direction < 6; ++direction)
+		{
+			const FIntVector neighbor = FIntVector(static_cast<int32>(x), static_cast<int32>(y), static_cast<int32>(z)) + NodeHelper::NeighborDirections[direction];
+
+			if (neighbor.X < 0 || neighbor.X >= rootMaxCoordinate ||
+				neighbor.Y < 0 || neighbor.Y >= rootMaxCoordinate ||
+				neighbor.Z < 0 || neighbor.Z >= rootMaxCoordinate)
+			{
+				continue;
+			}
+
+			const MortonCodeType neighborCode = libmorton::morton3D_64_encode(neighbor.X, neighbor.Y, neighbor.Z);
+
+			for (int32 layer = root.Key; layer >= 0; --layer)
+			{
+				const int32 depth = root.Key - layer;
+				const NodeIndexType first = mOctree.FindInsertIndex(layer, neighborCode << (3 * depth));
+				const NodeIndexType last = mOctree.FindInsertIndex(layer, (neighborCode + 1) << (3 * depth));
+
+				// the face shared with the subtree, in this layer's coordinates
+				const FIntVector& offset = NodeHelper::NeighborDirections[direction];
+				const int32 face = offset.X + offset.Y + offset.Z > 0 ? 0 : (1 << depth) - 1;
+
+				for (NodeIndexType i = first; i < last; ++i)
+				{
+					uint_fast32_t nx, ny, nz;
+					libmorton::morton3D_64_decode(mOctree.GetLayer(layer)[i].GetMortonCode(), nx, ny, nz);
+
+					const FIntVector local = FIntVector(static_cast<int32>(nx), static_cast<int32>(ny), static_cast<int32>(nz)) - neighbor * (1 << depth);
+					if ((offset.X != 0 && local.X == face) || (offset.Y != 0 && local.Y == face) || (offset.Z != 0 && local.Z == face))
+					{
+						relink[layer].Add(i);
+					}
+				}
+			}
+		}
+	}
+
+	for (int32 layer = mTotalLayers - 2; layer >= 0; --layer)
+	{
+		relink[layer].Append(inserted[layer]);
+
+		for (NodeIndexType index : relink[layer])
+		{
+			SetNodeNeighborLinks(mOctree, layer, index);
+		}
+	}
+
+	if (mCachedPositions)
+	{
+		mOctree.BuildPositions(mOrigin - mExtents, mLayerVoxelHalfSizeCache);
+	}
+
+	mGeometryRasterizer.Reset();
+
+	if (mCompactOctree)
+	{
+		mOctree.Compact();
+	}
+
+	RebuildGraph();
+	mOctreeLock.WriteUnlock();
+
+	mTotalLayerNodes = mOctree.GetTotalLayerNodes();
+	mTotalLeafNodes = mOctree.GetTotalLeafNodes();
+	mTotalBytes = mOctree.MemoryUsage();
+
+	if (mPortals.Num() > 0)
+	{
+		RebuildPortals();
+	}
+
+#if WITH_EDITOR
+	float totalTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - startTime).count() / 1000.0f;
+	UE_LOG(CinnamonLog, Log, TEXT("Region Regeneration Time (s): %f"), totalTime);
+
+	if (DrawVoxels)
+	{
+		FlushDrawnOctree();
+		DrawOctree();
+	}
+#endif
+
+	return true;
 }
 
 bool ATDPVolume::IsNodeBlocked(LayerIndexType layer, MortonCodeType code) const
@@ -894,10 +2055,12 @@ bool ATDPVolume::IsVoxelBlocked(const FVector& position, const float halfSize, b
 	collisionParams.bTraceComplex = mComplexCollision;
 
 	float clearance = useClearance ? mCollisionClearance : 0.0f;
-	bool result = GetWorld()->OverlapBlockingTestByChannel(position, FQuat::Identity, mCollisionChannel, FCollisionShape::MakeBox(FVector(halfSize + clearance)), collisionParams);
+	bool result = mGeometryRasterizer.IsReady() ? 
+		mGeometryRasterizer.IsBoxBlocked(position, halfSize + clearance) : 
+		GetWorld()->OverlapBlockingTestByChannel(position, FQuat::Identity, mCollisionChannel, FCollisionShape::MakeBox(FVector(halfSize + clearance)), collisionParams);
 
 #if WITH_EDITOR
-	if (DrawCollisionVoxels && result)
+	if (DrawCollisionVoxels && result && IsInGameThread())
 	{
 		DrawDebugBox(GetWorld(), position, FVector(halfSize + clearance), FQuat::Identity, FColor::Black, true);
 	}
@@ -919,7 +2082,7 @@ bool ATDPVolume::IsVoxelBlocked(const FVector& position, const float halfSize, c
 	bool result = GetWorld()->OverlapBlockingTestByChannel(position, FQuat::Identity, mCollisionChannel, FCollisionShape::MakeBox(FVector(halfSize + clearance)), collisionParams);
 
 #if WITH_EDITOR
-	if (DrawCollisionVoxels && result)
+	if (DrawCollisionVoxels && result && IsInGameThread())
 	{
 		DrawDebugBox(GetWorld(), position, FVector(halfSize + clearance), FQuat::Identity, FColor::Black, true);
 	}
@@ -928,6 +2091,12 @@ bool ATDPVolume::IsVoxelBlocked(const FVector& position, const float halfSize, c
 	return result;
 }
 
+bool ATDPVolume::IsVoxelContained(const FVector& position, const float halfSize) const
+{
+	// overlap queries can't tell if a box is inside the geometry, only the geometry snapshot can
+	return mGeometryRasterizer.IsReady() && mGeometryRasterizer.IsBoxContained(position, halfSize);
+}
+
 const TDPTree& ATDPVolume::GetOctree() const
 {
 	return mOctree;
@@ -943,33 +2112,12 @@ void ATDPVolume::GetNodePosition(LayerIndexType layer, MortonCodeType code, FVec
 
 NodeIndexType ATDPVolume::FindInsertIndex(LayerIndexType layer, MortonCodeType code) const
 {
-	const auto& octreeLayer = mOctree.GetLayer(layer);
-
-	int32 first = 0;
-	int32 last = octreeLayer.Num() - 1;
-	int32 middle = (first + last) / 2;
-
-	// nodes are built in acsending order by morton code so we can do binary search here
-	while (first <= last)
-	{
-		if (octreeLayer[middle].GetMortonCode() < code)
-		{
-			first = middle + 1;
-		}
-		else
-		{
-			last = middle - 1;
-		}
-
-		middle = (first + last) / 2;
-	}
-
-	return first;
+	return mOctree.FindInsertIndex(layer, code);
 }
 
-int32 ATDPVolume::GetNodeAmountInLayer(LayerIndexType layer) const
+MortonCodeType ATDPVolume::GetNodeAmountInLayer(LayerIndexType layer) const
 {
-	return FMath::Pow(8, (mLayers - layer));
+	return static_cast<MortonCodeType>(1) << (3 * (mLayers - layer));
 }
 
 float ATDPVolume::GetVoxelSizeInLayer(LayerIndexType layer) const
@@ -979,23 +2127,12 @@ float ATDPVolume::GetVoxelSizeInLayer(LayerIndexType layer) const
 
 bool ATDPVolume::GetNodePositionFromLink(TDPNodeLink link, FVector& position) const
 {
-	const auto& node = mOctree.GetLayer(link.LayerIndex)[link.NodeIndex];
-	GetNodePosition(link.LayerIndex, node.GetMortonCode(), position);
+	position = GetLinkPosition(link);
 
 	// if layer 0 and valid children, check 64 bit leaf for any set bits
-	if (link.LayerIndex == 0 && node.GetFirstChild().IsValid())
+	if (link.LayerIndex == 0 && mOctree.HasChildren(link))
 	{
-		/*FVector origin = position - FVector(mLayerVoxelHalfSizeCache[0]);
-		float leafSize = mLayerVoxelHalfSizeCache[0] / 2;
-		uint_fast32_t x, y, z;
-		libmorton::morton3D_64_decode(link.SubnodeIndex, x, y, z);
-		position = origin + FVector(x * leafSize, y * leafSize, z * leafSize) + FVector(leafSize / 2);*/
-		float voxelSize = mLayerVoxelHalfSizeCache[0] * 2;
-		uint_fast32_t x, y, z;
-		libmorton::morton3D_64_decode(link.SubnodeIndex, x, y, z);
-		position += FVector(x * voxelSize / 4, y * voxelSize / 4, z * voxelSize / 4) - FVector(voxelSize * 0.375f);
-
-		const auto& leafNode = mOctree.LeafNodes[node.GetFirstChild().NodeIndex];
+		const auto& leafNode = mOctree.GetLeafNode(mOctree.GetFirstChildLink(link).NodeIndex);
 
 		return !leafNode.GetSubnode(link.SubnodeIndex);
 	}
@@ -1003,6 +2140,31 @@ bool ATDPVolume::GetNodePositionFromLink(TDPNodeLink link, FVector& position) co
 	return true;
 }
 
+FVector ATDPVolume::GetLinkPosition(const TDPNodeLink& link) const
+{
+	const auto& layer = mOctree.GetLayer(link.LayerIndex);
+
+	FVector position;
+	if (layer.HasPositions())
+	{
+		position = layer.GetPosition(link.NodeIndex);
+	}
+	else
+	{
+		GetNodePosition(link.LayerIndex, layer.GetMortonCode(link.NodeIndex), position);
+	}
+
+	// subnodes are a quarter of the leaf node, offset from its center
+	if (link.LayerIndex == 0 && layer.HasChildren(link.NodeIndex))
+	{
+		const float subnodeSize = mLayerVoxelHalfSizeCache[0] / 2;
+		const uint8* coordinates = NodeHelper::SubnodeCoordinates[link.SubnodeIndex];
+		position += FVector(coordinates[0], coordinates[1], coordinates[2]) * subnodeSize - FVector(subnodeSize * 1.5f);
+	}
+
+	return position;
+}
+
 bool ATDPVolume::GetLinkFromPosition(const FVector& position, TDPNodeLink& link) const
 {
 	if (!IsPointInside(position))
@@ -1031,9 +2193,10 @@ bool ATDPVolume::GetLinkFromPosition(const FVector& position, TDPNodeLink& link)
 		NodeIndexType index;
 		if (GetNodeIndexFromMortonCode(currentLayer, code, index))
 		{
-			const auto& node = layer[index];
+			const auto node = layer[index];
+			const TDPNodeLink firstChild = mOctree.GetFirstChildLink(TDPNodeLink(currentLayer, index, 0));
 			// if node found and it has no children then this is our most precise node for the given position
-			if (!node.GetFirstChild().IsValid())
+			if (!firstChild.IsValid())
 			{
 				link.SetLayerIndex(currentLayer);
 				link.SetNodeIndex(index);
@@ -1045,7 +2208,7 @@ bool ATDPVolume::GetLinkFromPosition(const FVector& position, TDPNodeLink& link)
 			// if we are in layer 0 then we have to find the subnode inside the leaf node that contains the given position
 			if (currentLayer == 0)
 			{
-				const auto& leaf = mOctree.LeafNodes[node.GetFirstChild().NodeIndex];
+				const auto& leaf = mOctree.GetLeafNode(firstChild.NodeIndex);
 				float voxelHalfSize = mLayerVoxelHalfSizeCache[currentLayer];
 				float leafSize = voxelHalfSize / 2;
 
@@ -1089,170 +2252,436 @@ bool ATDPVolume::GetLinkFromPosition(const FVector& position, TDPNodeLink& link)
 
 				//MortonCodeType leafIndex = libmorton::morton3D_64_encode(mortonPosition.X, mortonPosition.Y, mortonPosition.Z);
 
-				if (leaf.GetSubnode(leafIndex))
+				if (leaf.GetSubnode(leafIndex))
+				{
+#if WITH_EDITOR
+					UE_LOG(CinnamonLog, Warning, TEXT("GetLinkFromPosition: node at position %s is blocked."), *position.ToString());
+					DrawNodeVoxel(leafPosition, FVector(mLayerVoxelHalfSizeCache[0] / 4), FColor::Emerald);
+					DrawNodeVoxel(nodePosition, FVector(mLayerVoxelHalfSizeCache[0]), DebugHelper::LayerColors[0]);
+#endif
+					return false;
+				}
+
+				link.SetSubnodeIndex(static_cast<SubnodeIndexType>(leafIndex));
+
+				return true;
+			}
+
+			// if no leaf node then we keep going down the octree to the next layer and 
+			currentLayer = firstChild.LayerIndex;
+			//currentNode = node.GetFirstChild().NodeIndex;
+		} 
+		else if (currentLayer == 0)
+		{
+			break;
+		}
+
+//		for (NodeIndexType i = currentNode; i < layer.Num(); ++i)
+//		{
+//			const auto& node = layer[i];
+//			if (node.GetMortonCode() == code)
+//			{
+//				// if node found and it has no children then this is our most precise node for the given position
+//				if (!node.GetFirstChild().IsValid())
+//				{
+//					link.SetLayerIndex(currentLayer);
+//					link.SetNodeIndex(i);
+//					link.SetSubnodeIndex(0);
+//
+//					return true;
+//				}
+//
+//				// if we are in layer 0 then we have to find the subnode inside the leaf node that contains the given position
+//				if (currentLayer == 0)
+//				{
+//					const auto& leaf = mOctree.LeafNodes[node.GetFirstChild().NodeIndex];
+//					float voxelHalfSize = mLayerVoxelHalfSizeCache[currentLayer];
+//					float leafSize = voxelHalfSize / 2;
+//
+//					FVector nodePosition;
+//					GetNodePosition(currentLayer, node.GetMortonCode(), nodePosition);
+//					FVector nodeOrigin = nodePosition - FVector(voxelHalfSize);
+//					FVector nodeLocalPosition = position - nodeOrigin;
+//
+//					int32 leafIndex;
+//					FVector leafPosition;
+//					bool found = false;
+//					for (leafIndex = 0; leafIndex < 64; ++leafIndex)
+//					{
+//						uint_fast32_t x, y, z;
+//						libmorton::morton3D_64_decode(leafIndex, x, y, z);
+//						leafPosition = nodeOrigin + FVector(x * leafSize, y * leafSize, z * leafSize) + FVector(leafSize / 2);
+//						if ((position.X >= leafPosition.X - (leafSize / 2)) && (position.X <= leafPosition.X + (leafSize / 2)) &&
+//							(position.Y >= leafPosition.Y - (leafSize / 2)) && (position.Y <= leafPosition.Y + (leafSize / 2)) &&
+//							(position.Z >= leafPosition.Z - (leafSize / 2)) && (position.Z <= leafPosition.Z + (leafSize / 2)))
+//						{
+//							found = true;
+//							break;
+//						}
+//					}
+//
+//					if (!found)
+//					{
+//#if WITH_EDITOR
+//						UE_LOG(CinnamonLog, Warning, TEXT("GetLinkFromPosition: could not find node."));
+//#endif
+//						return false;
+//					}
+//
+//					/*FIntVector mortonPosition;
+//					mortonPosition.X = FMath::FloorToInt(nodeLocalPosition.X / (voxelHalfSize / 2));
+//					mortonPosition.Y = FMath::FloorToInt(nodeLocalPosition.Y / (voxelHalfSize / 2));
+//					mortonPosition.Z = FMath::FloorToInt(nodeLocalPosition.Z / (voxelHalfSize / 2));*/
+//
+//					link.SetLayerIndex(currentLayer);
+//					link.SetNodeIndex(i);
+//
+//					//MortonCodeType leafIndex = libmorton::morton3D_64_encode(mortonPosition.X, mortonPosition.Y, mortonPosition.Z);
+//
+//					if (leaf.GetSubnode(leafIndex))
+//					{
+//#if WITH_EDITOR
+//						UE_LOG(CinnamonLog, Warning, TEXT("GetLinkFromPosition: node at position %s is blocked."), *position.ToString());
+//						DrawNodeVoxel(leafPosition, FVector(mLayerVoxelHalfSizeCache[0] / 4), FColor::Emerald);
+//						DrawNodeVoxel(nodePosition, FVector(mLayerVoxelHalfSizeCache[0]), DebugHelper::LayerColors[0]);
+//#endif
+//						return false;
+//					}
+//
+//					link.SetSubnodeIndex(static_cast<SubnodeIndexType>(leafIndex));
+//
+//					return true;
+//				}
+//
+//				// if no leaf node then we keep going down the octree to the next layer and 
+//				currentLayer = node.GetFirstChild().LayerIndex;
+//				currentNode = node.GetFirstChild().NodeIndex;
+//
+//				break;
+//			}
+//		}
+	}
+
+#if WITH_EDITOR
+	UE_LOG(CinnamonLog, Warning, TEXT("GetLinkFromPosition: could not find a node for the given link."));
+#endif
+
+	return false;
+}
+
+void ATDPVolume::GetVoxelMortonPosition(const FVector& position, const LayerIndexType layer, FIntVector& mortonPosition) const
+{
+	FVector mortonOrigin = mOrigin - mExtents;
+	FVector localPosition = position - mortonOrigin;
+
+	float voxelSize = mLayerVoxelHalfSizeCache[layer] * 2;
+
+	mortonPosition.X = FMath::FloorToInt(localPosition.X / voxelSize);
+	mortonPosition.Y = FMath::FloorToInt(localPosition.Y / voxelSize);
+	mortonPosition.Z = FMath::FloorToInt(localPosition.Z / voxelSize);
+}
+
+int32 ATDPVolume::GetTotalLayers() const
+{
+	return mTotalLayers;
+}
+
+void ATDPVolume::SetLayers(int32 layers)
+{
+	mLayers = layers;
+}
+
+void ATDPVolume::SetRasterizer(ETDPRasterizer rasterizer)
+{
+	mRasterizer = rasterizer;
+}
+
+void ATDPVolume::SetParallelGeneration(bool parallel)
+{
+	mParallelGeneration = parallel;
+}
+
+void ATDPVolume::SetCompactOctree(bool compact)
+{
+	LLM_SCOPED_SINGLE_STAT_TAG(STAT_CinnamonLLM);
+	mCompactOctree = compact;
+
+	{
+		FRWScopeLock lock(mOctreeLock, SLT_Write);
+
+		if (compact)
+		{
+			mOctree.Compact();
+		}
+		else
+		{
+			mOctree.Expand();
+		}
+	}
+
+	mTotalBytes = mOctree.MemoryUsage();
+}
+
+void ATDPVolume::SetCachedPositions(bool cached)
+{
+	LLM_SCOPED_SINGLE_STAT_TAG(STAT_CinnamonLLM);
+	mCachedPositions = cached;
+
+	{
+		FRWScopeLock lock(mOctreeLock, SLT_Write);
+
+		if (cached)
+		{
+			mOctree.BuildPositions(mOrigin - mExtents, mLayerVoxelHalfSizeCache);
+		}
+		else
+		{
+			mOctree.ClearPositions();
+		}
+	}
+
+	mTotalBytes = mOctree.MemoryUsage();
+}
+
+void ATDPVolume::SetBakedGraph(bool baked)
+{
+	LLM_SCOPED_SINGLE_STAT_TAG(STAT_CinnamonLLM);
+	mBakedGraph = baked;
+
+	FRWScopeLock lock(mOctreeLock, SLT_Write);
+	RebuildGraph();
+}
+
+const TDPGraph& ATDPVolume::GetGraph() const
+{
+	return mGraph;
+}
+
+void ATDPVolume::SetHierarchyLayer(int32 layer)
+{
+	LLM_SCOPED_SINGLE_STAT_TAG(STAT_CinnamonLLM);
+	FRWScopeLock lock(mOctreeLock, SLT_Write);
+
+	// searches read the layer to map links to cells
+	mHierarchyLayer = FMath::Max(layer, 0);
+	RebuildGraph();
+}
+
+const TDPGraph& ATDPVolume::GetCoarseGraph() const
+{
+	return mCoarseGraph;
+}
+
+TDPNodeLink ATDPVolume::GetCoarseLink(const TDPNodeLink& link) const
+{
+	TDPNodeLink result = link;
+
+	while (result.IsValid() && result.LayerIndex < mHierarchyLayer)
+	{
+		result = mOctree.GetParentLink(result);
+	}
+
+	result.SetSubnodeIndex(0);
+	return result;
+}
+
+void ATDPVolume::RebuildGraph()
+{
+	mGraph.Reset();
+	mCoarseGraph.Reset();
+
+	// the octree is complete at this point, rows are baked through the same neighbor searches the pathfinders use
+	if (mTotalLayers == 0 || mOctree.Layers.Num() != mTotalLayers || mLayerVoxelHalfSizeCache.Num() != mTotalLayers)
+	{
+		return;
+	}
+
+	auto getPosition = [this](const TDPNodeLink& link)
+	{
+		return GetLinkPosition(link);
+	};
+
+	if (mBakedGraph)
+	{
+		mGraph.Build(mOctree,
+			[this](const TDPNodeLink& link, TArray<TDPNodeLink>& neighbors)
+			{
+				if (link.LayerIndex == 0 && mOctree.HasChildren(link))
+				{
+					GetLeafNeighborsFromLink(link, neighbors);
+				}
+				else
+				{
+					GetNodeNeighborsFromLink(link, neighbors);
+				}
+			},
+			getPosition);
+	}
+
+	// subnodes can't be cells, the lowest hierarchy layer is 1
+	if (mHierarchyLayer > 0 && mHierarchyLayer < mTotalLayers)
+	{
+		mCoarseGraph.Build(mOctree,
+			[this](const TDPNodeLink& link, TArray<TDPNodeLink>& neighbors)
+			{
+				GetCoarseNeighbors(link, neighbors);
+			},
+			getPosition, static_cast<LayerIndexType>(mHierarchyLayer));
+	}
+}
+
+void ATDPVolume::GetCoarseNeighbors(const TDPNodeLink& link, TArray<TDPNodeLink>& neighbors) const
+{
+	// subdivided nodes above the hierarchy layer aren't cells, their children are
+	if (link.LayerIndex > mHierarchyLayer && mOctree.HasChildren(link))
+	{
+		return;
+	}
+
+	// gather the free nodes and subnodes inside the cell, a cell without any is never reached
+	TArray<TDPNodeLink> freeLinks;
+	TArray<TDPNodeLink> remainingLinks;
+	remainingLinks.Add(link);
+
+	while (remainingLinks.Num() > 0)
+	{
+		const TDPNodeLink currentLink = remainingLinks.Pop(false);
+
+		if (!mOctree.HasChildren(currentLink))
+		{
+			freeLinks.Add(currentLink);
+			continue;
+		}
+
+		const TDPNodeLink childLink = mOctree.GetFirstChildLink(currentLink);
+
+		if (currentLink.LayerIndex > 0)
+		{
+			for (NodeIndexType i = 0; i < 8; ++i)
+			{
+				remainingLinks.Emplace(static_cast<LayerIndexType>(childLink.LayerIndex), static_cast<NodeIndexType>(childLink.NodeIndex) + i, 0);
+			}
+		}
+		else if (childLink.NodeIndex != TDPTree::FullyBlockedLeaf)
+		{
+			const auto& leaf = mOctree.GetLeafNode(childLink.NodeIndex);
+
+			for (SubnodeIndexType subnode = 0; subnode < 64; ++subnode)
+			{
+				if (!leaf.GetSubnode(subnode))
 				{
-#if WITH_EDITOR
-					UE_LOG(CinnamonLog, Warning, TEXT("GetLinkFromPosition: node at position %s is blocked."), *position.ToString());
-					DrawNodeVoxel(leafPosition, FVector(mLayerVoxelHalfSizeCache[0] / 4), FColor::Emerald);
-					DrawNodeVoxel(nodePosition, FVector(mLayerVoxelHalfSizeCache[0]), DebugHelper::LayerColors[0]);
-#endif
-					return false;
+					freeLinks.Emplace(0, static_cast<NodeIndexType>(currentLink.NodeIndex), subnode);
 				}
-
-				link.SetSubnodeIndex(static_cast<SubnodeIndexType>(leafIndex));
-
-				return true;
 			}
+		}
+	}
 
-			// if no leaf node then we keep going down the octree to the next layer and 
-			currentLayer = node.GetFirstChild().LayerIndex;
-			//currentNode = node.GetFirstChild().NodeIndex;
-		} 
-		else if (currentLayer == 0)
+	// two cells are connected when any of their free nodes are, the fine neighbors are mapped to their cells
+	TArray<TDPNodeLink> fineNeighbors;
+	for (const auto& freeLink : freeLinks)
+	{
+		fineNeighbors.Reset();
+
+		if (freeLink.LayerIndex == 0 && mOctree.HasChildren(freeLink))
 		{
-			break;
+			GetLeafNeighborsFromLink(freeLink, fineNeighbors);
+		}
+		else
+		{
+			GetNodeNeighborsFromLink(freeLink, fineNeighbors);
 		}
 
-//		for (NodeIndexType i = currentNode; i < layer.Num(); ++i)
-//		{
-//			const auto& node = layer[i];
-//			if (node.GetMortonCode() == code)
-//			{
-//				// if node found and it has no children then this is our most precise node for the given position
-//				if (!node.GetFirstChild().IsValid())
-//				{
-//					link.SetLayerIndex(currentLayer);
-//					link.SetNodeIndex(i);
-//					link.SetSubnodeIndex(0);
-//
-//					return true;
-//				}
-//
-//				// if we are in layer 0 then we have to find the subnode inside the leaf node that contains the given position
-//				if (currentLayer == 0)
-//				{
-//					const auto& leaf = mOctree.LeafNodes[node.GetFirstChild().NodeIndex];
-//					float voxelHalfSize = mLayerVoxelHalfSizeCache[currentLayer];
-//					float leafSize = voxelHalfSize / 2;
-//
-//					FVector nodePosition;
-//					GetNodePosition(currentLayer, node.GetMortonCode(), nodePosition);
-//					FVector nodeOrigin = nodePosition - FVector(voxelHalfSize);
-//					FVector nodeLocalPosition = position - nodeOrigin;
-//
-//					int32 leafIndex;
-//					FVector leafPosition;
-//					bool found = false;
-//					for (leafIndex = 0; leafIndex < 64; ++leafIndex)
-//					{
-//						uint_fast32_t x, y, z;
-//						libmorton::morton3D_64_decode(leafIndex, x, y, z);
-//						leafPosition = nodeOrigin + FVector(x * leafSize, y * leafSize, z * leafSize) + FVector(leafSize / 2);
-//						if ((position.X >= leafPosition.X - (leafSize / 2)) && (position.X <= leafPosition.X + (leafSize / 2)) &&
-//							(position.Y >= leafPosition.Y - (leafSize / 2)) && (position.Y <= leafPosition.Y + (leafSize / 2)) &&
-//							(position.Z >= leafPosition.Z - (leafSize / 2)) && (position.Z <= leafPosition.Z + (leafSize / 2)))
-//						{
-//							found = true;
-//							break;
-//						}
-//					}
-//
-//					if (!found)
-//					{
-//#if WITH_EDITOR
-//						UE_LOG(CinnamonLog, Warning, TEXT("GetLinkFromPosition: could not find node."));
-//#endif
-//						return false;
-//					}
-//
-//					/*FIntVector mortonPosition;
-//					mortonPosition.X = FMath::FloorToInt(nodeLocalPosition.X / (voxelHalfSize / 2));
-//					mortonPosition.Y = FMath::FloorToInt(nodeLocalPosition.Y / (voxelHalfSize / 2));
-//					mortonPosition.Z = FMath::FloorToInt(nodeLocalPosition.Z / (voxelHalfSize / 2));*/
-//
-//					link.SetLayerIndex(currentLayer);
-//					link.SetNodeIndex(i);
-//
-//					//MortonCodeType leafIndex = libmorton::morton3D_64_encode(mortonPosition.X, mortonPosition.Y, mortonPosition.Z);
-//
-//					if (leaf.GetSubnode(leafIndex))
-//					{
-//#if WITH_EDITOR
-//						UE_LOG(CinnamonLog, Warning, TEXT("GetLinkFromPosition: node at position %s is blocked."), *position.ToString());
-//						DrawNodeVoxel(leafPosition, FVector(mLayerVoxelHalfSizeCache[0] / 4), FColor::Emerald);
-//						DrawNodeVoxel(nodePosition, FVector(mLayerVoxelHalfSizeCache[0]), DebugHelper::LayerColors[0]);
-//#endif
-//						return false;
-//					}
-//
-//					link.SetSubnodeIndex(static_cast<SubnodeIndexType>(leafIndex));
-//
-//					return true;
-//				}
-//
-//				// if no leaf node then we keep going down the octree to the next layer and 
-//				currentLayer = node.GetFirstChild().LayerIndex;
-//				currentNode = node.GetFirstChild().NodeIndex;
-//
-//				break;
-//			}
-//		}
+		for (const auto& fineNeighbor : fineNeighbors)
+		{
+			const TDPNodeLink coarseLink = GetCoarseLink(fineNeighbor);
+
+			if (coarseLink != link)
+			{
+				neighbors.AddUnique(coarseLink);
+			}
+		}
 	}
+}
 
-#if WITH_EDITOR
-	UE_LOG(CinnamonLog, Warning, TEXT("GetLinkFromPosition: could not find a node for the given link."));
-#endif
+void ATDPVolume::SetHashedLookup(bool hashed)
+{
+	LLM_SCOPED_SINGLE_STAT_TAG(STAT_CinnamonLLM);
+	mHashedLookup = hashed;
 
-	return false;
+	{
+		FRWScopeLock lock(mOctreeLock, SLT_Write);
+
+		if (hashed)
+		{
+			mOctree.BuildLookups();
+		}
+		else
+		{
+			mOctree.ClearLookups();
+		}
+	}
+
+	mTotalBytes = mOctree.MemoryUsage();
 }
 
-void ATDPVolume::GetVoxelMortonPosition(const FVector& position, const LayerIndexType layer, FIntVector& mortonPosition) const
+void ATDPVolume::GetMemoryReport(TDPMemoryReport& report) const
 {
-	FVector mortonOrigin = mOrigin - mExtents;
-	FVector localPosition = position - mortonOrigin;
+	FRWScopeLock lock(mOctreeLock, SLT_ReadOnly);
 
-	float voxelSize = mLayerVoxelHalfSizeCache[layer] * 2;
+	mOctree.GetMemoryReport(report);
+	report.PortalBytes = mPortals.GetAllocatedSize() + mConnectedTiles.GetAllocatedSize();
+	report.HalfSizeCacheBytes = mLayerVoxelHalfSizeCache.GetAllocatedSize();
+	report.GraphBytes = mGraph.GetAllocatedSize() + mCoarseGraph.GetAllocatedSize();
+	report.GenerationPeakBytes = mGenerationPeakBytes;
+}
 
-	mortonPosition.X = FMath::FloorToInt(localPosition.X / voxelSize);
-	mortonPosition.Y = FMath::FloorToInt(localPosition.Y / voxelSize);
-	mortonPosition.Z = FMath::FloorToInt(localPosition.Z / voxelSize);
+FString ATDPVolume::GetMemoryReportString() const
+{
+	TDPMemoryReport report;
+	GetMemoryReport(report);
+
+	return report.ToString();
 }
 
-int32 ATDPVolume::GetTotalLayers() const
+void ATDPVolume::GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize)
 {
-	return mTotalLayers;
+	Super::GetResourceSizeEx(CumulativeResourceSize);
+
+	TDPMemoryReport report;
+	GetMemoryReport(report);
+	CumulativeResourceSize.AddDedicatedSystemMemoryBytes(report.GetAllocatedBytes());
 }
 
-TDPNode* ATDPVolume::GetNodeFromLink(const TDPNodeLink& link)
+TDPNode ATDPVolume::GetNodeFromLink(const TDPNodeLink& link)
 {
 	if (link.IsValid() && static_cast<int32>(link.NodeIndex) < mOctree.GetLayer(link.LayerIndex).Num())
 	{
-		return &mOctree.GetLayer(link.LayerIndex)[link.NodeIndex];
+		return mOctree.GetLayer(link.LayerIndex)[link.NodeIndex];
 	}
 
-	return nullptr;
+	return TDPNode();
 }
 
-const TDPNode* ATDPVolume::GetNodeFromLink(const TDPNodeLink& link) const
+TDPConstNode ATDPVolume::GetNodeFromLink(const TDPNodeLink& link) const
 {
 	if (link.IsValid() && static_cast<int32>(link.NodeIndex) < mOctree.GetLayer(link.LayerIndex).Num())
 	{
-		return &mOctree.GetLayer(link.LayerIndex)[link.NodeIndex];
+		return mOctree.GetLayer(link.LayerIndex)[link.NodeIndex];
 	}
 
-	return nullptr;
+	return TDPConstNode();
 }
 
 void ATDPVolume::GetNodeNeighborsFromLink(const TDPNodeLink& link, TArray<TDPNodeLink>& neighbors) const
 {
 	const auto node = GetNodeFromLink(link);
 
-	if (node)
+	if (node.IsValid())
 	{
 		// check the six neighbor links
 		for (int32 i = 0; i < 6; ++i)
 		{
-			const auto& neighborLink = node->GetNeighbors()[i];
+			const auto neighborLink = mOctree.GetNeighborLink(link, i);
 
 			// nothing to do if link is invalid
 			if (!neighborLink.IsValid())
@@ -1262,10 +2691,10 @@ void ATDPVolume::GetNodeNeighborsFromLink(const TDPNodeLink& link, TArray<TDPNod
 
 			const auto neighbor = GetNodeFromLink(neighborLink);
 
-			if (neighbor)
+			if (neighbor.IsValid())
 			{
 				// if neighbor has no children then just add it and continue
-				if (!neighbor->HasChildren())
+				if (!neighbor.HasChildren())
 				{
 					neighbors.Add(neighborLink);
 					continue;
@@ -1280,10 +2709,10 @@ void ATDPVolume::GetNodeNeighborsFromLink(const TDPNodeLink& link, TArray<TDPNod
 					auto currentLink = remainingLinks.Pop();
 					const auto currentNode = GetNodeFromLink(currentLink);
 
-					if (currentNode)
+					if (currentNode.IsValid())
 					{
 						// highest precision reached with this child
-						if (!currentNode->HasChildren())
+						if (!currentNode.HasChildren())
 						{
 							neighbors.Add(currentLink);
 							continue;
@@ -1294,14 +2723,14 @@ void ATDPVolume::GetNodeNeighborsFromLink(const TDPNodeLink& link, TArray<TDPNod
 						{
 							for (const auto& childIndex : NodeHelper::ChildOffsets[i])
 							{
-								auto childLink = currentNode->GetFirstChild();
+								auto childLink = mOctree.GetFirstChildLink(currentLink);
 								childLink.NodeIndex += childIndex;
 								const auto childNode = GetNodeFromLink(childLink);
 
-								if (childNode)
+								if (childNode.IsValid())
 								{
 									// more work to do if there are more children
-									if (childNode->HasChildren())
+									if (childNode.HasChildren())
 									{
 										remainingLinks.Emplace(childLink);
 									}
@@ -1318,9 +2747,9 @@ void ATDPVolume::GetNodeNeighborsFromLink(const TDPNodeLink& link, TArray<TDPNod
 						{
 							for (const auto& leafIndex : NodeHelper::LeafChildOffsets[i])
 							{
-								auto leafLink = currentNode->GetFirstChild();
-								const auto& leafNode = mOctree.LeafNodes[leafLink.NodeIndex];
-								leafLink.SetSubnodeIndex(leafIndex);
+								// subnode links address the layer 0 node, not its leaf
+								const auto& leafNode = mOctree.GetLeafNode(mOctree.GetFirstChildLink(currentLink).NodeIndex);
+								TDPNodeLink leafLink(0, currentLink.NodeIndex, leafIndex);
 
 								// only add them if they are not blocked
 								if (!leafNode.GetSubnode(leafIndex))
@@ -1341,9 +2770,9 @@ void ATDPVolume::GetLeafNeighborsFromLink(const TDPNodeLink& link, TArray<TDPNod
 	MortonCodeType leafIndex = link.SubnodeIndex;
 	const auto node = GetNodeFromLink(link);
 
-	if (node)
+	if (node.IsValid())
 	{
-		const auto& leaf = mOctree.LeafNodes[node->GetFirstChild().NodeIndex];
+		const auto& leaf = mOctree.GetLeafNode(mOctree.GetFirstChildLink(link).NodeIndex);
 
 		uint_fast32_t x = 0, y = 0, z = 0;
 		libmorton::morton3D_64_decode(leafIndex, x, y, z);
@@ -1371,18 +2800,20 @@ void ATDPVolume::GetLeafNeighborsFromLink(const TDPNodeLink& link, TArray<TDPNod
 			}
 			else
 			{
-				const auto& neighborLink = node->GetNeighbors()[i];
+				const auto neighborLink = mOctree.GetNeighborLink(link, i);
 				const auto neighborNode = GetNodeFromLink(neighborLink);
 
-				if (neighborNode)
+				if (neighborNode.IsValid())
 				{
-					if (!neighborNode->GetFirstChild().IsValid())
+					const auto neighborChild = mOctree.GetFirstChildLink(neighborLink);
+
+					if (!neighborChild.IsValid())
 					{
 						neighbors.Add(neighborLink);
 						continue;
 					}
 
-					const auto& leafNode = mOctree.LeafNodes[neighborNode->GetFirstChild().NodeIndex];
+					const auto& leafNode = mOctree.GetLeafNode(neighborChild.NodeIndex);
 
 					if (leafNode.IsFullyBlocked())
 					{
@@ -1419,7 +2850,7 @@ void ATDPVolume::GetLeafNeighborsFromLink(const TDPNodeLink& link, TArray<TDPNod
 
 						if (!leafNode.GetSubnode(subnodeIndex))
 						{
-							neighbors.Emplace(0, neighborNode->GetFirstChild().NodeIndex, subnodeIndex);
+							neighbors.Emplace(0, neighborLink.NodeIndex, subnodeIndex);
 						}
 					}
 				}
@@ -1428,6 +2859,145 @@ void ATDPVolume::GetLeafNeighborsFromLink(const TDPNodeLink& link, TArray<TDPNod
 	}
 }
 
+void ATDPVolume::GetPortalNeighborsFromLink(const TDPNodeLink& link, TArray<TDPTileLink>& neighbors) const
+{
+	mPortals.MultiFind(link, neighbors);
+}
+
+const TArray<ATDPVolume*>& ATDPVolume::GetConnectedTiles() const
+{
+	return mConnectedTiles;
+}
+
+void ATDPVolume::AddTileQuery() const
+{
+	mTileQueries.Increment();
+}
+
+void ATDPVolume::RemoveTileQuery() const
+{
+	mTileQueries.Decrement();
+}
+
+void ATDPVolume::WaitForTileQueries() const
+{
+	// queries gather their tiles on the game thread, once the portals are gone no new one can pick this tile up
+	while (mTileQueries.GetValue() > 0)
+	{
+		FPlatformProcess::Sleep(0.0f);
+	}
+}
+
+bool ATDPVolume::HasLineOfSight(const FVector& start, const FVector& end) const
+{
+	// the voxel sizes are only cached once there is an octree
+	if (mTotalLayers == 0)
+	{
+		return false;
+	}
+
+	FBox bounds;
+	const FVector delta = end - start;
+	const float length = delta.Size();
+
+	if (length < KINDA_SMALL_NUMBER)
+	{
+		return GetFreeBounds(start, bounds);
+	}
+
+	// step from node to node, each free node is crossed in one go
+	const FVector direction = delta / length;
+	const float epsilon = mLayerVoxelHalfSizeCache[0] * 0.01f;
+	float distance = 0.0f;
+
+	while (GetFreeBounds(start + direction * distance, bounds))
+	{
+		float exit = length;
+
+		for (int32 axis = 0; axis < 3; ++axis)
+		{
+			if (direction[axis] > KINDA_SMALL_NUMBER)
+			{
+				exit = FMath::Min(exit, (bounds.Max[axis] - start[axis]) / direction[axis]);
+			}
+			else if (direction[axis] < -KINDA_SMALL_NUMBER)
+			{
+				exit = FMath::Min(exit, (bounds.Min[axis] - start[axis]) / direction[axis]);
+			}
+		}
+
+		if (exit >= length)
+		{
+			return true;
+		}
+
+		distance = FMath::Max(exit, distance) + epsilon;
+	}
+
+	return false;
+}
+
+bool ATDPVolume::GetFreeBounds(const FVector& position, FBox& bounds) const
+{
+	const FVector mortonOrigin = mOrigin - mExtents;
+	const FVector localPosition = position - mortonOrigin;
+	const FVector size = mExtents * 2;
+
+	// cached bounds instead of the components, this runs on path finding threads
+	if (mTotalLayers == 0 || localPosition.GetMin() < 0.0f || localPosition.X >= size.X || localPosition.Y >= size.Y || localPosition.Z >= size.Z)
+	{
+		return false;
+	}
+
+	// subnode coordinates, every layer above is a shift of them
+	const float subnodeSize = mLayerVoxelHalfSizeCache[0] / 2;
+	const FIntVector subnode(FMath::FloorToInt(localPosition.X / subnodeSize), FMath::FloorToInt(localPosition.Y / subnodeSize), FMath::FloorToInt(localPosition.Z / subnodeSize));
+
+	auto nodeBounds = [&mortonOrigin](const FIntVector& voxel, float size)
+	{
+		const FVector min = mortonOrigin + FVector(voxel.X, voxel.Y, voxel.Z) * size;
+		return FBox(min, min + FVector(size));
+	};
+
+	for (int32 layer = mTotalLayers - 1; layer >= 0; --layer)
+	{
+		const int32 shift = layer + 2;
+		const FIntVector voxel(subnode.X >> shift, subnode.Y >> shift, subnode.Z >> shift);
+		const MortonCodeType code = libmorton::morton3D_64_encode(static_cast<uint_fast32_t>(voxel.X), static_cast<uint_fast32_t>(voxel.Y), static_cast<uint_fast32_t>(voxel.Z));
+
+		// nodes only exist inside blocked parents, a missing one leaves its whole parent free
+		NodeIndexType index;
+		if (!mOctree.GetNodeIndexFromMortonCode(layer, code, index))
+		{
+			bounds = nodeBounds(FIntVector(voxel.X >> 1, voxel.Y >> 1, voxel.Z >> 1), mLayerVoxelHalfSizeCache[layer] * 4);
+			return true;
+		}
+
+		const TDPNodeLink link(layer, index, 0);
+		if (!mOctree.HasChildren(link))
+		{
+			bounds = nodeBounds(voxel, mLayerVoxelHalfSizeCache[layer] * 2);
+			return true;
+		}
+
+		if (layer == 0)
+		{
+			const auto& leaf = mOctree.GetLeafNode(mOctree.GetFirstChildLink(link).NodeIndex);
+			const MortonCodeType subnodeIndex = libmorton::morton3D_64_encode(static_cast<uint_fast32_t>(subnode.X & 3), static_cast<uint_fast32_t>(subnode.Y & 3), static_cast<uint_fast32_t>(subnode.Z & 3));
+
+			if (leaf.GetSubnode(subnodeIndex))
+			{
+				return false;
+			}
+
+			bounds = nodeBounds(subnode, subnodeSize);
+			return true;
+		}
+	}
+
+	return false;
+}
+
 bool ATDPVolume::IsPointInside(const FVector& point) const
 {
 	return GetComponentsBoundingBox(true).IsInside(point);
@@ -1438,11 +3008,10 @@ void ATDPVolume::DrawVoxelFromLink(const TDPNodeLink& link, const FColor& color,
 	FVector position;
 	GetNodePositionFromLink(link, position);
 
-	const auto& node = mOctree.GetLayer(link.LayerIndex)[link.NodeIndex];
 	float size = mLayerVoxelHalfSizeCache[link.LayerIndex];
 
 	// if layer 0 and valid children
-	if (link.LayerIndex == 0 && node.GetFirstChild().IsValid())
+	if (link.LayerIndex == 0 && mOctree.HasChildren(link))
 	{
 		size /= 4;
 	}
@@ -1489,22 +3058,22 @@ TArray<TDPNodeLink> ATDPVolume::GetAffectedNodes(const FBox& box, const TSet<AAc
 		auto link = stack.Pop();
 		const auto node = GetNodeFromLink(link);
 
-		if (node == nullptr)
+		if (!node.IsValid())
 		{
 			continue;
 		}
 
 		FVector position;
-		GetNodePosition(link.LayerIndex, node->GetMortonCode(), position);
+		GetNodePosition(link.LayerIndex, node.GetMortonCode(), position);
 
 		FBox voxel = FBox::BuildAABB(position, FVector(mLayerVoxelHalfSizeCache[link.LayerIndex]));
 		if (voxel.Intersect(box) && IsVoxelBlocked(position, mLayerVoxelHalfSizeCache[link.LayerIndex], filter, true))
 		{
-			if (node->HasChildren() && link.LayerIndex > 0)
+			if (node.HasChildren() && link.LayerIndex > 0)
 			{
 				for (uint32 i = 0; i < 8; ++i)
 				{
-					auto childLink = node->GetFirstChild();
+					auto childLink = mOctree.GetFirstChildLink(link);
 					childLink.NodeIndex += i;
 					stack.Emplace(childLink);
 				}
@@ -1524,50 +3093,64 @@ TArray<TDPNodeLink> ATDPVolume::GetAffectedNodes(const FBox& box, const TSet<AAc
 
 void ATDPVolume::Serialize(FArchive& Ar)
 {
+	LLM_SCOPED_SINGLE_STAT_TAG(STAT_CinnamonLLM);
 	Super::Serialize(Ar);
 
 	if (mEnableSerialization)
 	{
-		Ar << mOctree;
+		// links are always saved, compact and mapped octrees are saved from an expanded copy
+		if (Ar.IsSaving() && (mOctree.IsCompact() || mOctree.IsMapped()))
+		{
+			TDPTree octree = mOctree;
+			octree.Expand();
+			octree.Serialize(Ar, mCompressSerialization);
+		}
+		else
+		{
+			mOctree.Serialize(Ar, mCompressSerialization);
+		}
+
 		Ar << mLayerVoxelHalfSizeCache;
 
-		mTotalLayers = mOctree.Layers.Num();
-		mTotalBytes = mOctree.MemoryUsage();
-	}
-}
+		if (Ar.IsLoading())
+		{
+			// older octrees stored a leaf for every leaf layer node
+			mOctree.RebuildLeafNodes();
+			mTotalLeafNodes = mOctree.GetTotalLeafNodes();
 
-bool ATDPVolume::GetNodeIndexFromMortonCode(const LayerIndexType layer, const MortonCodeType nodeCode, NodeIndexType& index) const
-{
-	const auto& octreeLayer = mOctree.GetLayer(layer);
+			if (mCompactOctree)
+			{
+				mOctree.Compact();
+			}
 
-	int32 first = 0;
-	int32 last = octreeLayer.Num() - 1;
-	int32 middle = (first + last) / 2;
+			if (mHashedLookup)
+			{
+				mOctree.BuildLookups();
+			}
 
-	// nodes are built in acsending order by morton code so we can do binary search here
-	while (first <= last)
-	{
-		if (octreeLayer[middle].GetMortonCode() < nodeCode)
-		{
-			first = middle + 1;
-		}
-		else if (octreeLayer[middle].GetMortonCode() == nodeCode)
-		{
-			index = middle;
-			return true;
+			if (mCachedPositions)
+			{
+				mOctree.BuildPositions(mOrigin - mExtents, mLayerVoxelHalfSizeCache);
+			}
 		}
-		else
+
+		mTotalLayers = mOctree.Layers.Num();
+
+		if (Ar.IsLoading())
 		{
-			last = middle - 1;
+			RebuildGraph();
 		}
 
-		middle = (first + last) / 2;
+		mTotalBytes = mOctree.MemoryUsage();
 	}
+}
 
-	return false;
+bool ATDPVolume::GetNodeIndexFromMortonCode(const LayerIndexType layer, const MortonCodeType nodeCode, NodeIndexType& index) const
+{
+	return mOctree.GetNodeIndexFromMortonCode(layer, nodeCode, index);
 }
 
-void ATDPVolume::DrawNodeVoxel(const LayerIndexType layer, const TDPNode& node) const
+void ATDPVolume::DrawNodeVoxel(const LayerIndexType layer, const TDPConstNode& node) const
 {
 	FVector position;
 	GetNodePosition(layer, node.GetMortonCode(), position);
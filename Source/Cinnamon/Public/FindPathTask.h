@@ -6,6 +6,7 @@
 #include "Runtime/Core/Public/Async/AsyncWork.h"
 #include "ThreadSafeBool.h"
 #include "TDPNodeLink.h"
+#include "TDPTileLink.h"
 #include "TDPNavigationPath.h"
 #include "PathHelper.h"
 
@@ -23,6 +24,10 @@ public:
 	FindPathTask(UWorld* world, const ATDPVolume& volume, const FTDPPathFinderSettings& settings, ETDPPathFinder pathFinder, ETDPHeuristic heuristic,
 		const TDPNodeLink& startLink, const TDPNodeLink& endLink, const FVector& startPosition, const FVector& endPosition, 
 		TDPNavigationPath& path, FThreadSafeBool& complete);
+	// search across tiles, they're gathered on the game thread and all of their octrees are read locked while searching
+	FindPathTask(UWorld* world, const TArray<const ATDPVolume*>& tiles, const FTDPPathFinderSettings& settings, ETDPHeuristic heuristic,
+		const TDPTileLink& startLink, const TDPTileLink& endLink, const FVector& startPosition, const FVector& endPosition,
+		TDPNavigationPath& path, FThreadSafeBool& complete);
 
 protected:
 	UWorld* mWorld;
@@ -36,8 +41,13 @@ protected:
 	FVector mEndPosition;
 	TDPNavigationPath& mPath;
 	FThreadSafeBool& mComplete;
+	TArray<const ATDPVolume*> mTiles;
+	TDPTileLink mStartTileLink;
+	TDPTileLink mEndTileLink;
 
 	void DoWork();
+	// lets the tiles go away once the search doesn't touch them anymore
+	void ReleaseTiles();
 	bool CanAbandon() const;
 	void Abandon();
 
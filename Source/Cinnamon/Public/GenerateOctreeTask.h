@@ -0,0 +1,34 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Runtime/Core/Public/Async/AsyncWork.h"
+
+class ATDPVolume;
+struct TDPTree;
+
+/**
+ * Rasterizes a volume into a separate octree on a worker thread, the volume swaps it in once the task is done
+ */
+class CINNAMON_API GenerateOctreeTask
+{
+	friend class FAutoDeleteAsyncTask<GenerateOctreeTask>;
+	friend class FAsyncTask<GenerateOctreeTask>;
+
+public:
+	GenerateOctreeTask(ATDPVolume& volume, TDPTree& octree);
+
+protected:
+	ATDPVolume* mVolume;
+	TDPTree& mOctree;
+
+	void DoWork();
+	bool CanAbandon() const;
+	void Abandon();
+
+	FORCEINLINE TStatId GetStatId() const
+	{
+		RETURN_QUICK_DECLARE_CYCLE_STAT(GenerateOctreeTask, STATGROUP_ThreadPoolAsyncTasks);
+	}
+};
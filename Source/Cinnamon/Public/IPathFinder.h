@@ -7,6 +7,8 @@
 #include "TDPVolume.h"
 #include "TDPNavigationPath.h"
 #include "TDPNodeLink.h"
+#include "TDPTileLink.h"
+#include "TDPSearchState.h"
 
 /**
  * 
@@ -20,6 +22,17 @@ public:
 	virtual void FindPath(const TDPNodeLink startLink, const TDPNodeLink endLink, const FVector& startPosition, const FVector& endVector, TDPNavigationPath& path) const = 0;
 
 	void BuildPath(const TMap<TDPNodeLink, TDPNodeLink>& trail, TDPNodeLink currentLink, const FVector& startPosition, const FVector& endPosition, TDPNavigationPath& path) const;
+	// follows the parent slots from the end slot back to the start
+	void BuildPath(const TDPSearchState& state, int32 slot, const FVector& startPosition, const FVector& endPosition, TDPNavigationPath& path) const;
+	// same for a search over several tiles, the tile of a slot indexes the volumes
+	void BuildPath(const TDPSearchState& state, int32 slot, TArrayView<const ATDPVolume* const> tiles, const FVector& startPosition, const FVector& endPosition, TDPNavigationPath& path) const;
+
+protected:
+	// links from the end to the start
+	void BuildPath(const TArray<TDPTileLink>& links, TDPNavigationPath& path) const;
+	// row of the baked graph, or the neighbors searched in the octree into the scratch array
+	TArrayView<const TDPNodeLink> GetNeighbors(const TDPNodeLink& link, TArray<TDPNodeLink>& scratch) const;
+	static TArrayView<const TDPNodeLink> GetNeighbors(const ATDPVolume& volume, const TDPNodeLink& link, TArray<TDPNodeLink>& scratch);
 
 protected:
 	PathHelper::Heuristic mHeuristic;
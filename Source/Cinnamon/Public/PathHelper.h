@@ -11,14 +11,17 @@
 UENUM(BlueprintType)
 enum class ETDPPathFinder : uint8
 {
-	AStar	UMETA(DisplayName="A*")
+	AStar				UMETA(DisplayName="A*"),
+	LazyThetaStar		UMETA(DisplayName="Lazy Theta*"),
+	HierarchicalAStar	UMETA(DisplayName="Hierarchical A*")
 };
 
 UENUM(BlueprintType)
 enum class ETDPHeuristic : uint8
 {
 	ManhattanDistance	UMETA(DisplayName = "Manhattan Distance"),
-	EuclideanDistance	UMETA(DisplayName = "Euclidean Distance")
+	EuclideanDistance	UMETA(DisplayName = "Euclidean Distance"),
+	OctileDistance		UMETA(DisplayName = "Octile Distance")
 };
 
 USTRUCT(BlueprintType)
@@ -54,6 +57,64 @@ public:
 
 	static const Heuristic ManhattanDistance;
 	static const Heuristic EuclideanDistance;
+	static const Heuristic OctileDistance;
 
 	static const TMap<ETDPHeuristic, Heuristic> Heuristics;
+
+	// heuristic policies, pathfinders are instantiated per policy so the distance inlines
+	struct FManhattanDistance
+	{
+		FORCEINLINE float operator()(const FVector& start, const FVector& end) const
+		{
+			return FMath::Abs(end.X - start.X) + FMath::Abs(end.Y - start.Y) + FMath::Abs(end.Z - start.Z);
+		}
+	};
+
+	struct FEuclideanDistance
+	{
+		FORCEINLINE float operator()(const FVector& start, const FVector& end) const
+		{
+			return (end - start).Size();
+		}
+	};
+
+	// diagonal moves through edges and corners cost sqrt 2 and sqrt 3
+	struct FOctileDistance
+	{
+		FORCEINLINE float operator()(const FVector& start, const FVector& end) const
+		{
+			const FVector delta = (end - start).GetAbs();
+			const float min = delta.GetMin();
+			const float max = delta.GetMax();
+			const float mid = delta.X + delta.Y + delta.Z - min - max;
+
+			const float sqrt2 = 1.41421356f;
+			const float sqrt3 = 1.73205081f;
+
+			return (sqrt3 - sqrt2) * min + (sqrt2 - 1.0f) * mid + max;
+		}
+	};
+
+	// cost policies, unit cost never reads positions
+	struct FUnitCost
+	{
+		static const bool UsesDistance = false;
+
+		FORCEINLINE float operator()(float unitCost, float distance) const
+		{
+			return unitCost;
+		}
+	};
+
+	struct FDistanceCost
+	{
+		static const bool UsesDistance = true;
+
+		FORCEINLINE float operator()(float unitCost, float distance) const
+		{
+			return distance;
+		}
+	};
+
+	static float GetDistance(ETDPHeuristic heuristic, const FVector& start, const FVector& end);
 };
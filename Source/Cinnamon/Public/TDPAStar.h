@@ -6,11 +6,13 @@
 #include "IPathFinder.h"
 
 /**
- * 
+ * A* over the octree, the search is instantiated per heuristic and cost policy and the policy is picked once per query
+ * built in heuristics inline, a heuristic function passed in is called through it
  */
 class CINNAMON_API TDPAStar : public IPathFinder
 {
 public:
+	TDPAStar(const ATDPVolume& volume, ETDPHeuristic heuristic, const FTDPPathFinderSettings& settings);
 	TDPAStar(const ATDPVolume& volume, const PathHelper::Heuristic& heuristic, const FTDPPathFinderSettings& settings);
 	TDPAStar(const TDPAStar&) = default;
 	virtual ~TDPAStar() = default;
@@ -18,5 +20,35 @@ public:
 	virtual void FindPath(const TDPNodeLink startLink, const TDPNodeLink endLink, const FVector& startPosition, const FVector& endVector, TDPNavigationPath& path) const override;
 
 	float GetCost(const TDPNodeLink& start, const TDPNodeLink& end) const;
+	// distance between the nodes already known, from a baked graph row
+	float GetCost(const TDPNodeLink& end, float distance) const;
 	float CalculateHeuristic(const TDPNodeLink& start, const TDPNodeLink& end) const;
+
+protected:
+	// only expands nodes whose coarse cell is in the corridor, the whole octree without one, false when no path was found
+	bool FindCorridorPath(const TDPNodeLink startLink, const TDPNodeLink endLink, const FVector& startPosition, const FVector& endPosition, const TSet<TDPNodeLink>* corridor, TDPNavigationPath& path) const;
+
+private:
+	// cost and heuristic factors of every layer, worked out once per query
+	struct FLayerFactors
+	{
+		float Cost[INVALID_LAYER_INDEX];
+		float Heuristic;
+	};
+
+	// neighbors, edge costs and heuristic of the octree for the search loop of TDPSearchState
+	template<typename HeuristicType, typename CostType>
+	struct FSearchSpace;
+
+	void GetLayerFactors(const TDPNodeLink& endLink, FLayerFactors& factors) const;
+
+	template<typename HeuristicType>
+	bool FindPath(const TDPNodeLink startLink, const TDPNodeLink endLink, const FVector& startPosition, const FVector& endPosition, const HeuristicType& heuristic, const TSet<TDPNodeLink>* corridor, TDPNavigationPath& path) const;
+
+	template<typename HeuristicType, typename CostType>
+	bool Search(const TDPNodeLink startLink, const TDPNodeLink endLink, const FVector& startPosition, const FVector& endPosition, const HeuristicType& heuristic, const CostType& cost, const TSet<TDPNodeLink>* corridor, TDPNavigationPath& path) const;
+
+private:
+	ETDPHeuristic mHeuristicType = ETDPHeuristic::ManhattanDistance;
+	bool mCustomHeuristic = true;
 };
@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TDPDefinitions.h"
+
+/**
+ * Blocked morton codes of a single layer, stored as a bitmap when the layer is dense and as a sorted array otherwise
+ */
+class CINNAMON_API TDPBlockedLayer
+{
+public:
+	// sorts and removes duplicates in place before building
+	void Build(TArray<MortonCodeType>& codes, MortonCodeType totalCodes);
+	// codes have to be sorted and unique
+	void BuildSorted(const TArray<MortonCodeType>& codes, MortonCodeType totalCodes);
+	void Reset();
+
+	bool Contains(MortonCodeType code) const;
+	int32 Num() const;
+	bool IsDense() const;
+	SIZE_T GetAllocatedSize() const;
+
+	// visits the codes in ascending order
+	template <typename FunctionType>
+	void ForEach(FunctionType function) const
+	{
+		if (mIsDense)
+		{
+			for (int32 word = 0; word < mBitmap.Num(); ++word)
+			{
+				uint64 bits = mBitmap[word];
+				while (bits)
+				{
+					const MortonCodeType bit = FMath::CountTrailingZeros64(bits);
+					function((static_cast<MortonCodeType>(word) << 6) + bit);
+					bits &= bits - 1;
+				}
+			}
+		}
+		else
+		{
+			for (MortonCodeType code : mCodes)
+			{
+				function(code);
+			}
+		}
+	}
+
+	static void RadixSort(TArray<MortonCodeType>& codes, MortonCodeType totalCodes);
+
+private:
+	TArray<MortonCodeType> mCodes;
+	TArray<uint64> mBitmap;
+	int32 mNum = 0;
+	bool mIsDense = false;
+};
@@ -10,6 +10,19 @@ using NodeIndexType = int32;
 using SubnodeIndexType = uint8;
 using MortonCodeType = uint_fast64_t;
 
+// 64 bit node links for volumes with more than 4M nodes in a layer, set from Cinnamon.Build.cs
+#ifndef CINNAMON_WIDE_NODE_LINKS
+#define CINNAMON_WIDE_NODE_LINKS 0
+#endif
+
+#if CINNAMON_WIDE_NODE_LINKS
+using NodeLinkType = uint64;
+#define NODE_LINK_NODE_BITS 54
+#else
+using NodeLinkType = uint32;
+#define NODE_LINK_NODE_BITS 22
+#endif
+
 #define INVALID_LAYER_INDEX 15
 
 class CINNAMON_API NodeHelper final
@@ -18,6 +31,8 @@ public:
 	static const FIntVector NeighborDirections[];
 	static const NodeIndexType ChildOffsets[6][4];
 	static const NodeIndexType LeafChildOffsets[6][16];
+	// decoded morton coordinates of the 64 subnodes in a leaf
+	static const uint8 SubnodeCoordinates[64][3];
 };
 
 class CINNAMON_API DebugHelper final
@@ -26,6 +41,28 @@ public:
 	static const FColor LayerColors[];
 };
 
+// version of the octree saved with a volume
+struct CINNAMON_API FTDPCustomVersion
+{
+	enum Type
+	{
+		// node by node layout
+		BeforeCustomVersionWasAdded = 0,
+		// raw layer arrays with delta encoded codes, optionally compressed
+		BulkOctree,
+		// node link size in the bulk header, octrees saved with the other link format are dropped instead of misread
+		BulkLinkSize,
+
+		VersionPlusOne,
+		LatestVersion = VersionPlusOne - 1
+	};
+
+	static const FGuid GUID;
+
+private:
+	FTDPCustomVersion() {}
+};
+
 UENUM(BlueprintType)
 namespace ETDPPathfindingRequestResult
 {
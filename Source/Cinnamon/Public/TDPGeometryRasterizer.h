@@ -0,0 +1,98 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineTypes.h"
+
+class UWorld;
+class UPrimitiveComponent;
+class UBodySetup;
+
+/**
+ * Snapshot of the blocking collision geometry inside a volume, answers box queries without going through the physics scene
+ */
+class CINNAMON_API TDPGeometryRasterizer
+{
+public:
+	void Gather(UWorld* world, const FBox& bounds, ECollisionChannel channel, bool complexCollision, const AActor* ignoredActor = nullptr);
+	void Reset();
+
+	bool IsReady() const;
+	bool IsBoxBlocked(const FVector& center, float halfSize) const;
+	bool IsBoxContained(const FVector& center, float halfSize) const;
+
+	int32 GetTotalTriangles() const;
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	enum class EElementType : uint8
+	{
+		Triangle,
+		Convex,
+		Sphere,
+		Capsule
+	};
+
+	struct FElement
+	{
+		EElementType Type;
+		int32 Index;
+		FBox Bounds;
+	};
+
+	struct FTriangle
+	{
+		FVector A, B, C;
+	};
+
+	struct FConvex
+	{
+		int32 FirstPlane;
+		int32 TotalPlanes;
+	};
+
+	struct FSphere
+	{
+		FVector Center;
+		float Radius;
+	};
+
+	struct FCapsule
+	{
+		FVector Start, End;
+		float Radius;
+	};
+
+	void AddComponent(UPrimitiveComponent& component, bool complexCollision);
+	bool AddTriangleMesh(const UBodySetup& bodySetup, const FTransform& transform);
+	void AddSimpleGeometry(const UBodySetup& bodySetup, const FTransform& transform);
+	void AddTriangle(const FVector& a, const FVector& b, const FVector& c);
+	void AddConvex(const TArray<FVector>& vertices, const TArray<int32>& indices);
+	void AddBox(const FTransform& elementTransform, const FTransform& transform, const FVector& extent);
+	void BuildGrid();
+
+	bool IsElementBlocked(const FElement& element, const FVector& center, const FVector& extent) const;
+	bool IsElementContaining(const FElement& element, const FVector& center, const FVector& extent) const;
+	void GetCellRange(const FBox& box, FIntVector& min, FIntVector& max) const;
+
+	static bool TriangleBoxOverlap(const FVector& center, const FVector& extent, const FTriangle& triangle);
+	static float PointBoxDistanceSquared(const FVector& point, const FVector& center, const FVector& extent);
+
+private:
+	TArray<FElement> mElements;
+	TArray<FTriangle> mTriangles;
+	TArray<FConvex> mConvexes;
+	TArray<FPlane> mPlanes;
+	TArray<FSphere> mSpheres;
+	TArray<FCapsule> mCapsules;
+
+	// uniform grid over the gathered bounds, element indices of each cell are stored contiguously
+	FBox mBounds{ ForceInit };
+	FVector mCellSize = FVector::ZeroVector;
+	int32 mResolution = 0;
+	TArray<int32> mCellOffsets;
+	TArray<int32> mCellElements;
+
+	bool mIsReady = false;
+};
@@ -0,0 +1,48 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TDPDefinitions.h"
+#include "TDPNodeLink.h"
+
+struct TDPTree;
+
+/**
+ * Read only adjacency baked from the octree, one row per node and one per free subnode of a partially blocked leaf
+ * rows are stored back to back, a row is the neighbor links of a node and the distance to each of them
+ * node indices move when the octree changes, the graph is rebuilt instead of patched
+ * a graph can start at a higher layer, nodes below it and subnodes get no rows, that's the coarse graph of hierarchical searches
+ */
+class CINNAMON_API TDPGraph
+{
+public:
+	typedef TFunctionRef<void(const TDPNodeLink& link, TArray<TDPNodeLink>& neighbors)> NeighborsFunction;
+	typedef TFunctionRef<FVector(const TDPNodeLink& link)> PositionFunction;
+
+	void Build(const TDPTree& octree, NeighborsFunction getNeighbors, PositionFunction getPosition, LayerIndexType firstLayer = 0);
+	void Reset();
+
+	bool IsBuilt() const;
+	int32 GetTotalRows() const;
+	int32 GetTotalEdges() const;
+
+	TArrayView<const TDPNodeLink> GetNeighbors(const TDPNodeLink& link) const;
+	TArrayView<const float> GetCosts(const TDPNodeLink& link) const;
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	int32 GetRow(const TDPNodeLink& link) const;
+
+private:
+	// first row of every layer, nodes of a layer have consecutive rows, INDEX_NONE below the first layer
+	TArray<int32> mLayerRows;
+	// first of the 64 subnode rows of a layer 0 node, INDEX_NONE when it has no partially blocked leaf
+	TArray<int32> mSubnodeRows;
+
+	// row i spans [mOffsets[i], mOffsets[i + 1])
+	TArray<int32> mOffsets;
+	TArray<TDPNodeLink> mNeighbors;
+	TArray<float> mCosts;
+};
@@ -0,0 +1,25 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TDPAStar.h"
+
+/**
+ * A* in two passes, a route through the coarse graph of the volume first and then the full search limited to the cells along it
+ * the corridor keeps one cell around the route so the fine path can cut corners, the full octree is searched when the corridor is a dead end
+ * plain A* when the volume has no hierarchy layer
+ */
+class CINNAMON_API TDPHierarchicalAStar : public TDPAStar
+{
+public:
+	TDPHierarchicalAStar(const ATDPVolume& volume, ETDPHeuristic heuristic, const FTDPPathFinderSettings& settings);
+	TDPHierarchicalAStar(const TDPHierarchicalAStar&) = default;
+	virtual ~TDPHierarchicalAStar() = default;
+
+	virtual void FindPath(const TDPNodeLink startLink, const TDPNodeLink endLink, const FVector& startPosition, const FVector& endVector, TDPNavigationPath& path) const override;
+
+private:
+	// false when the cells aren't connected, then neither are the nodes in them
+	bool FindCorridor(const TDPNodeLink& startCell, const TDPNodeLink& endCell, TSet<TDPNodeLink>& corridor, TDPPathStatistics& statistics) const;
+};
@@ -0,0 +1,136 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TDPDefinitions.h"
+#include "TDPNodeLink.h"
+#include "TDPNode.h"
+
+/**
+ * Nodes of one octree layer sorted by morton code, stored as parallel arrays
+ * morton lookups only read the codes and traversal only reads the links
+ * a compact layer drops the links and only keeps which nodes have children, TDPTree derives the links from the codes
+ * the leaf layer keeps its first child links, they point into the sparse leaf storage instead of a layer
+ * a mapped layer reads everything in place from a navdata file and can't be changed until it's expanded
+ */
+class CINNAMON_API TDPLayer
+{
+public:
+	int32 Num() const;
+	void Reserve(int32 number);
+	void SetNum(int32 number);
+	void Reset();
+
+	NodeIndexType Add(MortonCodeType code);
+	NodeIndexType Add(const TDPLayer& other, NodeIndexType index);
+	void InsertDefaulted(NodeIndexType index, int32 count);
+	void RemoveAt(NodeIndexType index, int32 count);
+
+	TDPNode operator[](NodeIndexType index);
+	TDPConstNode operator[](NodeIndexType index) const;
+
+	TArrayView<const MortonCodeType> GetMortonCodes() const;
+	TArrayView<const TDPNodeLink> GetParentLinks() const;
+	TArrayView<const TDPNodeLink> GetFirstChildLinks() const;
+	TArrayView<const TDPNodeLink> GetNeighborLinks() const;
+
+	MortonCodeType& GetMortonCode(NodeIndexType index);
+	const MortonCodeType& GetMortonCode(NodeIndexType index) const;
+
+	TDPNodeLink& GetParent(NodeIndexType index);
+	const TDPNodeLink& GetParent(NodeIndexType index) const;
+
+	TDPNodeLink& GetFirstChild(NodeIndexType index);
+	const TDPNodeLink& GetFirstChild(NodeIndexType index) const;
+
+	TDPNodeLink* GetNeighbors(NodeIndexType index);
+	const TDPNodeLink* GetNeighbors(NodeIndexType index) const;
+
+	bool HasChildren(NodeIndexType index) const;
+
+	bool IsCompact() const;
+	void Compact(bool keepFirstChildren);
+	void Expand(TArray<TDPNodeLink>&& parents, TArray<TDPNodeLink>&& firstChildren, TArray<TDPNodeLink>&& neighbors);
+
+	// open addressing hash from morton code to node index, any change to the nodes drops it until it's built again
+	bool HasLookup() const;
+	void BuildLookup();
+	void ClearLookup();
+	bool FindNodeIndex(MortonCodeType code, NodeIndexType& index) const;
+
+	// node centers in world space so searches don't decode codes, dropped together with the lookup
+	bool HasPositions() const;
+	void BuildPositions(const FVector& origin, float voxelSize);
+	void ClearPositions();
+	const FVector& GetPosition(NodeIndexType index) const;
+
+	bool IsMapped() const;
+	void Map(TArrayView<const MortonCodeType> codes, TArrayView<const TDPNodeLink> parents, TArrayView<const TDPNodeLink> firstChildren, TArrayView<const TDPNodeLink> neighbors);
+
+	// raw arrays instead of node by node, returns false when loaded data doesn't add up
+	bool SerializeBulk(FArchive& Ar);
+
+	// used counts the elements, allocated includes the slack and leaves out mapped data
+	uint64 MemoryUsage() const;
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	TArray<MortonCodeType> mMortonCodes;
+	TArray<TDPNodeLink> mParents;
+	TArray<TDPNodeLink> mFirstChildren;
+	// 6 links per node, one for each face
+	TArray<TDPNodeLink> mNeighbors;
+
+	// children always come in groups of 8, one bit per node is enough to rebuild the child links
+	TBitArray<> mChildMask;
+	bool mCompact = false;
+
+	// code and index side by side so a probe stays in one cache line
+	struct FLookupSlot
+	{
+		MortonCodeType Code;
+		NodeIndexType Index;
+	};
+
+	TArray<FLookupSlot> mLookup;
+	uint32 mLookupShift = 0;
+
+	TArray<FVector> mPositions;
+
+	// views into a mapped navdata file, the owning TDPTree keeps the mapping alive
+	TArrayView<const MortonCodeType> mMappedMortonCodes;
+	TArrayView<const TDPNodeLink> mMappedParents;
+	TArrayView<const TDPNodeLink> mMappedFirstChildren;
+	TArrayView<const TDPNodeLink> mMappedNeighbors;
+	bool mMapped = false;
+};
+
+FORCEINLINE FArchive& operator<<(FArchive& Ar, TDPLayer& layer)
+{
+	// same layout as the node array the layer replaced, only used to load octrees saved before FTDPCustomVersion::BulkOctree
+	// compact and mapped layers can't be written to, expand the octree first
+	check(!layer.IsCompact() && !layer.IsMapped());
+
+	int32 num = layer.Num();
+	Ar << num;
+
+	if (Ar.IsLoading())
+	{
+		layer.SetNum(num);
+	}
+
+	for (int32 i = 0; i < num; ++i)
+	{
+		Ar << layer.GetMortonCode(i);
+		Ar << layer.GetParent(i);
+		Ar << layer.GetFirstChild(i);
+
+		for (int32 j = 0; j < 6; ++j)
+		{
+			Ar << layer.GetNeighbors(i)[j];
+		}
+	}
+
+	return Ar;
+}
@@ -0,0 +1,27 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "IPathFinder.h"
+
+/**
+ * Lazy Theta* over the octree, any angle paths that skip the node centers in between when the segment is free
+ * line of sight is only checked when a node is expanded, the expanding node becomes the parent when it fails
+ */
+class CINNAMON_API TDPLazyThetaStar : public IPathFinder
+{
+public:
+	TDPLazyThetaStar(const ATDPVolume& volume, ETDPHeuristic heuristic, const FTDPPathFinderSettings& settings);
+	TDPLazyThetaStar(const TDPLazyThetaStar&) = default;
+	virtual ~TDPLazyThetaStar() = default;
+
+	virtual void FindPath(const TDPNodeLink startLink, const TDPNodeLink endLink, const FVector& startPosition, const FVector& endVector, TDPNavigationPath& path) const override;
+
+private:
+	// the slot its parent is visible from, the parent of the start is the start itself
+	void SetVertex(TDPSearchState& state, int32 slot) const;
+
+private:
+	ETDPHeuristic mHeuristicType;
+};
@@ -0,0 +1,42 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Memory used by a volume, used bytes count the elements and allocated bytes include the array slack
+ * mapped data is counted as used but not allocated, it lives in the file mapping
+ */
+struct CINNAMON_API TDPMemoryReport
+{
+	struct FLayer
+	{
+		int32 Nodes = 0;
+		uint64 UsedBytes = 0;
+		uint64 AllocatedBytes = 0;
+	};
+
+	TArray<FLayer> Layers;
+
+	int32 LeafNodes = 0;
+	int32 FreeLeafNodes = 0;
+	uint64 LeafUsedBytes = 0;
+	uint64 LeafAllocatedBytes = 0;
+
+	// layer 0 nodes by occupancy, only partially blocked ones own a leaf
+	int32 EmptyLeaves = 0;
+	int32 PartialLeaves = 0;
+	int32 FullLeaves = 0;
+
+	uint64 PortalBytes = 0;
+	uint64 HalfSizeCacheBytes = 0;
+	uint64 GraphBytes = 0;
+
+	// highest transient usage of the last generation, blocked indices, geometry snapshot and the octree being built
+	uint64 GenerationPeakBytes = 0;
+
+	uint64 GetUsedBytes() const;
+	uint64 GetAllocatedBytes() const;
+	FString ToString() const;
+};
@@ -0,0 +1,101 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TDPDefinitions.h"
+#include "TDPNodeLink.h"
+#include "TDPLeafNode.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+struct TDPTree;
+
+/**
+ * Flat navdata file, one aligned section per array so the octree can be read in place from a mapped file
+ * header, layer table, then codes, parents, first children and neighbors of every layer, the leaves and the layer half sizes
+ */
+class CINNAMON_API TDPNavData
+{
+public:
+	static const uint32 Magic;
+	static const uint32 Version;
+
+	static bool Write(const FString& filename, const TDPTree& octree, const TArray<float>& layerHalfSizes, const FVector& origin, const FVector& extents);
+	static TSharedPtr<TDPNavData> Map(const FString& filename);
+
+	~TDPNavData();
+
+	int32 GetTotalLayers() const;
+	const FVector& GetOrigin() const;
+	const FVector& GetExtents() const;
+	TArrayView<const MortonCodeType> GetMortonCodes(LayerIndexType layer) const;
+	TArrayView<const TDPNodeLink> GetParents(LayerIndexType layer) const;
+	TArrayView<const TDPNodeLink> GetFirstChildren(LayerIndexType layer) const;
+	TArrayView<const TDPNodeLink> GetNeighbors(LayerIndexType layer) const;
+	TArrayView<const TDPLeafNode> GetLeafNodes() const;
+	TArrayView<const float> GetLayerHalfSizes() const;
+
+	int64 GetSize() const;
+
+private:
+	struct FSection
+	{
+		uint64 Offset;
+		uint64 Num;
+	};
+
+	struct FLayer
+	{
+		FSection MortonCodes;
+		FSection Parents;
+		FSection FirstChildren;
+		FSection Neighbors;
+	};
+
+	struct FHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		// files written with the other link width can't be read in place
+		uint32 LinkSize;
+		uint32 TotalLayers;
+		// bounds of the volume it was baked for, a moved or resized volume can't use the file
+		FVector Origin;
+		FVector Extents;
+		uint64 FileSize;
+		FSection LeafNodes;
+		FSection LayerHalfSizes;
+	};
+
+	// sections start on a cache line
+	static const uint64 Alignment = 64;
+
+	TDPNavData() = default;
+
+	bool Validate() const;
+	const FLayer& GetLayer(LayerIndexType layer) const;
+
+	template<typename T>
+	TArrayView<const T> GetSection(const FSection& section) const
+	{
+		return TArrayView<const T>(reinterpret_cast<const T*>(mData + section.Offset), static_cast<int32>(section.Num));
+	}
+
+	template<typename T>
+	bool IsSectionValid(const FSection& section) const
+	{
+		return section.Offset % Alignment == 0 && section.Offset <= static_cast<uint64>(mSize) && section.Num <= MAX_int32 &&
+			section.Num * sizeof(T) <= static_cast<uint64>(mSize) - section.Offset;
+	}
+
+private:
+	const uint8* mData = nullptr;
+	int64 mSize = 0;
+
+	IMappedFileHandle* mFileHandle = nullptr;
+	IMappedFileRegion* mFileRegion = nullptr;
+
+	// platforms without mapped files read the whole file instead
+	TArray<uint8> mFileData;
+};
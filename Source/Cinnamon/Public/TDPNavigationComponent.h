@@ -53,6 +53,12 @@ protected:
 	bool IsNavigationPossible() const;
 	bool HasValidNavigationVolume() const;
 	bool FindNavigationVolume();
+	const ATDPVolume* FindVolumeAt(const FVector& position) const;
+	void UpdateNavigationVolume();
+	void CreatePathFinder();
+	bool GetTileLinks(const FVector& startPosition, const FVector& targetPosition, TDPTileLink& startLink, TDPTileLink& targetLink) const;
+	bool FindPathAcrossTiles(const FVector& startPosition, const FVector& targetPosition);
+	bool FindPathAcrossTilesAsync(const FVector& startPosition, const FVector& targetPosition, FThreadSafeBool& complete);
 
 protected:
 	TSharedPtr<TDPNavigationPath> mNavigationPath = nullptr;
@@ -17,6 +17,14 @@ struct CINNAMON_API TDPPathPoint
 	TDPPathPoint(const FVector& position = FVector(), LayerIndexType layer = INVALID_LAYER_INDEX, bool leafChild = false);
 };
 
+struct CINNAMON_API TDPPathStatistics
+{
+	int32 Iterations = 0;
+	int32 VisitedNodes = 0;
+	int32 FrontierNodes = 0;
+	float Cost = 0.0f;
+};
+
 /**
  * 
  */
@@ -35,8 +43,11 @@ public:
 	void SetIsReady(bool ready);
 	TArray<TDPPathPoint>& GetPath();
 	const TArray<TDPPathPoint>& GetPath() const;
+	TDPPathStatistics& GetStatistics();
+	const TDPPathStatistics& GetStatistics() const;
 
 private:
 	bool mIsReady = false;
 	TArray<TDPPathPoint> mPath;
+	TDPPathStatistics mStatistics;
 };
@@ -5,17 +5,23 @@
 #include "CoreMinimal.h"
 #include "TDPDefinitions.h"
 #include "TDPNodeLink.h"
-#include <array>
+
+class TDPLayer;
 
 /**
- * 
+ * Handle to a node of a TDPLayer, the node data lives in the layer's arrays
+ * only valid while the layer is not resized, compact layers only answer codes and HasChildren
  */
 class CINNAMON_API TDPNode
 {
 public:
 	TDPNode();
+	TDPNode(TDPLayer& layer, NodeIndexType index);
 	~TDPNode() = default;
 
+	bool IsValid() const;
+	NodeIndexType GetIndex() const;
+
 	MortonCodeType& GetMortonCode();
 	const MortonCodeType& GetMortonCode() const;
 	void SetMortonCode(MortonCodeType code);
@@ -34,22 +40,31 @@ public:
 	bool HasChildren() const;
 
 private:
-	MortonCodeType mMortonCode;
-	TDPNodeLink mParent;
-	TDPNodeLink mFirstChild;
-	TDPNodeLink mNeighbors[6];
+	TDPLayer* mLayer;
+	NodeIndexType mIndex;
 };
 
-FORCEINLINE FArchive& operator<<(FArchive& Ar, TDPNode& node)
+/**
+ * Read-only handle to a node of a const TDPLayer, also valid for mapped layers
+ */
+class CINNAMON_API TDPConstNode
 {
-	Ar << node.GetMortonCode();
-	Ar << node.GetParent();
-	Ar << node.GetFirstChild();
+public:
+	TDPConstNode();
+	TDPConstNode(const TDPLayer& layer, NodeIndexType index);
+	~TDPConstNode() = default;
+
+	bool IsValid() const;
+	NodeIndexType GetIndex() const;
+
+	const MortonCodeType& GetMortonCode() const;
+	const TDPNodeLink& GetParent() const;
+	const TDPNodeLink& GetFirstChild() const;
+	const TDPNodeLink* GetNeighbors() const;
 
-	for (int i = 0; i < 6; i++)
-	{
-		Ar << node.GetNeighbors()[i];
-	}
+	bool HasChildren() const;
 
-	return Ar;
-}
+private:
+	const TDPLayer* mLayer;
+	NodeIndexType mIndex;
+};
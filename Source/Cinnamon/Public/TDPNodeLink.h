@@ -10,11 +10,13 @@
  */
 struct CINNAMON_API TDPNodeLink
 {
-	uint32 LayerIndex : 4;
-	uint32 NodeIndex : 22;
-	uint32 SubnodeIndex : 6;
+	NodeLinkType LayerIndex : 4;
+	NodeLinkType NodeIndex : NODE_LINK_NODE_BITS;
+	NodeLinkType SubnodeIndex : 6;
 
 	static const TDPNodeLink InvalidLink;
+	// highest node index a link can hold, layers can't have more nodes than this
+	static const NodeIndexType MaxNodeIndex;
 
 	explicit TDPNodeLink(LayerIndexType layer = INVALID_LAYER_INDEX, NodeIndexType node = 0, SubnodeIndexType subnode = 0);
 	bool operator==(const TDPNodeLink& other) const;
@@ -30,13 +32,16 @@ struct CINNAMON_API TDPNodeLink
 	FString ToString() const;
 };
 
+static_assert(sizeof(TDPNodeLink) == sizeof(NodeLinkType), "node link bitfield must fill its storage type");
+
 FORCEINLINE uint32 GetTypeHash(const TDPNodeLink& link)
 {
-	return *reinterpret_cast<const uint32*>(&link);
+	return GetTypeHash(*reinterpret_cast<const NodeLinkType*>(&link));
 }
 
 FORCEINLINE FArchive& operator<<(FArchive& Ar, TDPNodeLink& link)
 {
+	// the link width is part of the format, octrees saved with the other width have to be generated again
 	Ar.Serialize(&link, sizeof(TDPNodeLink));
 
 	return Ar;
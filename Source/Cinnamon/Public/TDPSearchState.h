@@ -0,0 +1,178 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TDPDefinitions.h"
+#include "TDPNodeLink.h"
+#include "TDPNavigationPath.h"
+
+struct TDPTree;
+
+/**
+ * Per query search data in flat arrays indexed by node, reused between queries without clearing
+ * every slot is stamped with the query that last wrote it, slots with an older stamp read as unvisited
+ * layer nodes have one slot each, subnodes get a block of 64 slots the first time a query reaches their leaf
+ * the open list is a binary heap of f and slot, every open slot knows its heap position so its key can be decreased in place
+ * a query can span several octrees (tiles), every tile gets its own slot range and nodes are a tile and a link in it
+ */
+class CINNAMON_API TDPSearchState
+{
+public:
+	static const int32 InvalidSlot = INDEX_NONE;
+
+	struct FNode
+	{
+		TDPNodeLink Link;
+		int32 Parent;
+		// closed node that last relaxed this one, any angle searches fall back to it when the parent isn't visible
+		int32 Expander;
+		float G;
+		float F;
+		// position in the open heap, INDEX_NONE when the node isn't open
+		int32 HeapIndex;
+		uint32 Generation;
+		uint16 Tile;
+		bool Closed;
+	};
+
+	// one per thread, queries on the same thread reuse its arrays
+	static TDPSearchState& Get();
+
+	// starts a new query, only grows the arrays when the octrees have more nodes than any earlier query
+	void Reset(const TDPTree& octree);
+	void Reset(TArrayView<const TDPTree* const> octrees);
+
+	// slot of a link, visited for the first time in this query when added is set, tile 0 for single octree queries
+	int32 FindOrAdd(const TDPNodeLink& link, bool& added);
+	int32 FindOrAdd(uint16 tile, const TDPNodeLink& link, bool& added);
+	int32 Find(const TDPNodeLink& link) const;
+	int32 Find(uint16 tile, const TDPNodeLink& link) const;
+
+	FNode& operator[](int32 slot);
+	const FNode& operator[](int32 slot) const;
+
+	// decrease key moves an open slot up after its f was lowered, pop closes nothing, the caller does
+	void PushOpen(int32 slot);
+	void DecreaseOpen(int32 slot);
+	int32 PopOpen();
+	bool IsOpenEmpty() const;
+	int32 GetTotalOpen() const;
+
+	// scratch for neighbors searched in the octree when the volume has no baked graph
+	TArray<TDPNodeLink>& GetNeighbors();
+
+	SIZE_T GetAllocatedSize() const;
+
+	// A* from the start to the end, the start is closed right away, returns the slot of the end or InvalidSlot
+	// the space hands out the heuristic of a node and calls visit(tile, link, cost) for every neighbor with the edge cost
+	template<typename SpaceType>
+	int32 Search(const SpaceType& space, uint16 startTile, const TDPNodeLink& startLink, uint16 endTile, const TDPNodeLink& endLink, TDPPathStatistics& statistics);
+
+private:
+	// f is kept next to the slot so comparisons don't touch the nodes
+	struct FOpenEntry
+	{
+		float F;
+		int32 Slot;
+	};
+
+	bool IsSubnode(uint16 tile, const TDPNodeLink& link) const;
+	void SiftUp(int32 index);
+	void SiftDown(int32 index);
+	void SetOpen(int32 index, const FOpenEntry& entry);
+
+private:
+	TArray<const TDPTree*> mOctrees;
+	uint32 mGeneration = 0;
+
+	// first layer slot and first layer 0 node of every tile
+	TArray<int32> mTileLayers;
+	TArray<int32> mTileLeaves;
+
+	TArray<int32> mLayerSlots;
+	TArray<FNode> mNodes;
+
+	// first slot of the subnode block of a layer 0 node, valid while its stamp matches the query
+	TArray<int32> mSubnodeBlocks;
+	TArray<uint32> mSubnodeBlockGenerations;
+	TArray<FNode> mSubnodes;
+	int32 mUsedSubnodes = 0;
+
+	TArray<FOpenEntry> mOpen;
+	TArray<TDPNodeLink> mNeighbors;
+};
+
+template<typename SpaceType>
+int32 TDPSearchState::Search(const SpaceType& space, uint16 startTile, const TDPNodeLink& startLink, uint16 endTile, const TDPNodeLink& endLink, TDPPathStatistics& statistics)
+{
+	bool added;
+	int32 current = FindOrAdd(startTile, startLink, added);
+	(*this)[current].F = space.GetHeuristic(startTile, startLink);
+	(*this)[current].Closed = true;
+
+	int32 iterations = 0;
+	int32 visitedNodes = 1;
+
+	while ((*this)[current].Tile != endTile || (*this)[current].Link != endLink)
+	{
+		// copies, a new subnode block can move the nodes
+		const uint16 currentTile = (*this)[current].Tile;
+		const TDPNodeLink currentLink = (*this)[current].Link;
+		const float currentCost = (*this)[current].G;
+
+		space.ForEachNeighbor(currentTile, currentLink, [this, &space, current, currentCost](uint16 tile, const TDPNodeLink& neighbor, float cost)
+		{
+			bool neighborAdded;
+			const int32 slot = FindOrAdd(tile, neighbor, neighborAdded);
+			FNode& node = (*this)[slot];
+
+			if (node.Closed)
+			{
+				return;
+			}
+
+			const float pathCost = currentCost + cost;
+
+			if (neighborAdded)
+			{
+				node.G = pathCost;
+				node.F = pathCost + space.GetHeuristic(tile, neighbor);
+				node.Parent = current;
+				PushOpen(slot);
+			}
+			else if (pathCost < node.G)
+			{
+				// the heuristic doesn't change, only the cost so far
+				node.F = pathCost + (node.F - node.G);
+				node.G = pathCost;
+				node.Parent = current;
+				DecreaseOpen(slot);
+			}
+		});
+
+		++iterations;
+
+		const int32 next = PopOpen();
+		if (next == InvalidSlot)
+		{
+			break;
+		}
+
+		current = next;
+		(*this)[current].Closed = true;
+		++visitedNodes;
+	}
+
+	statistics.Iterations = iterations;
+	statistics.VisitedNodes = visitedNodes;
+	statistics.FrontierNodes = GetTotalOpen();
+
+	if ((*this)[current].Tile != endTile || (*this)[current].Link != endLink)
+	{
+		return InvalidSlot;
+	}
+
+	statistics.Cost = (*this)[current].G;
+	return current;
+}
@@ -0,0 +1,28 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TDPNodeLink.h"
+
+class ATDPVolume;
+
+/**
+ * Node link qualified by the volume (tile) that owns it, used to search across tiles
+ */
+struct CINNAMON_API TDPTileLink
+{
+	const ATDPVolume* Volume;
+	TDPNodeLink Link;
+
+	explicit TDPTileLink(const ATDPVolume* volume = nullptr, TDPNodeLink link = TDPNodeLink::InvalidLink);
+	bool operator==(const TDPTileLink& other) const;
+	bool operator!=(const TDPTileLink& other) const;
+
+	bool IsValid() const;
+};
+
+FORCEINLINE uint32 GetTypeHash(const TDPTileLink& link)
+{
+	return HashCombine(GetTypeHash(link.Volume), GetTypeHash(link.Link));
+}
@@ -0,0 +1,48 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "IPathFinder.h"
+#include "TDPTileLink.h"
+
+/**
+ * A* over a set of adjacent volumes, crosses from one tile to the next through their portals
+ * runs the search loop of TDPSearchState with one slot range per tile, the volume it's made for is where single tile queries start
+ */
+class CINNAMON_API TDPTiledAStar : public IPathFinder
+{
+public:
+	TDPTiledAStar(const ATDPVolume& volume, ETDPHeuristic heuristic, const FTDPPathFinderSettings& settings);
+	TDPTiledAStar(const TDPTiledAStar&) = default;
+	virtual ~TDPTiledAStar() = default;
+
+	virtual void FindPath(const TDPNodeLink startLink, const TDPNodeLink endLink, const FVector& startPosition, const FVector& endVector, TDPNavigationPath& path) const override;
+	bool FindPath(const TDPTileLink& startLink, const TDPTileLink& endLink, const FVector& startPosition, const FVector& endPosition, TDPNavigationPath& path) const;
+	// the tiles are gathered up front, async queries gather them on the game thread and lock their octrees while searching
+	bool FindPath(TArrayView<const ATDPVolume* const> tiles, const TDPTileLink& startLink, const TDPTileLink& endLink, const FVector& startPosition, const FVector& endPosition, TDPNavigationPath& path) const;
+
+	// the volume and every tile reachable from it through portals
+	static void GatherTiles(const ATDPVolume& volume, TArray<const ATDPVolume*>& tiles);
+
+private:
+	// layer compensation of every layer of a tile, tiles can have different layer counts
+	struct FTileFactors
+	{
+		float Cost[INVALID_LAYER_INDEX];
+	};
+
+	template<typename HeuristicType, typename CostType>
+	struct FSearchSpace;
+
+	template<typename HeuristicType, typename CostType>
+	bool Search(TArrayView<const ATDPVolume* const> tiles, uint16 startTile, const TDPNodeLink& startLink, uint16 endTile, const TDPNodeLink& endLink,
+		const FVector& startPosition, const FVector& endPosition, TDPNavigationPath& path) const;
+
+	template<typename HeuristicType>
+	bool FindPath(TArrayView<const ATDPVolume* const> tiles, uint16 startTile, const TDPNodeLink& startLink, uint16 endTile, const TDPNodeLink& endLink,
+		const FVector& startPosition, const FVector& endPosition, TDPNavigationPath& path) const;
+
+private:
+	ETDPHeuristic mHeuristicType;
+};
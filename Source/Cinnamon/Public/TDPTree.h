@@ -3,30 +3,80 @@
 #pragma once
 
 #include "CoreMinimal.h"
-#include "TDPNode.h"
+#include "TDPLayer.h"
 #include "TDPLeafNode.h"
 
+class TDPNavData;
+struct TDPMemoryReport;
+
 /**
  * 
  */
 struct CINNAMON_API TDPTree
 {
-	TArray<TArray<TDPNode>> Layers;
+	// leaf nodes only exist for partially blocked layer 0 nodes, fully blocked ones all link to the same leaf
+	static const NodeIndexType FullyBlockedLeaf;
+
+	TArray<TDPLayer> Layers;
 	TArray<TDPLeafNode> LeafNodes;
+	TArray<NodeIndexType> FreeLeafNodes;
 
 	int32 GetTotalLayerNodes() const;
+	int32 GetTotalLeafNodes() const;
+	const TDPLeafNode& GetLeafNode(NodeIndexType leaf) const;
+	TArrayView<const TDPLeafNode> GetLeafNodes() const;
+
+	const TDPLayer& GetLayer(LayerIndexType layer) const;
+	TDPLayer& GetLayer(LayerIndexType layer);
+
+	bool GetNodeIndexFromMortonCode(LayerIndexType layer, MortonCodeType nodeCode, NodeIndexType& index) const;
+	bool SearchNodeIndex(LayerIndexType layer, MortonCodeType nodeCode, NodeIndexType& index) const;
+	NodeIndexType FindInsertIndex(LayerIndexType layer, MortonCodeType code) const;
+
+	// links of a node, stored or derived from the morton codes when the octree is compact
+	bool HasChildren(const TDPNodeLink& link) const;
+	TDPNodeLink GetParentLink(const TDPNodeLink& link) const;
+	TDPNodeLink GetFirstChildLink(const TDPNodeLink& link) const;
+	TDPNodeLink GetNeighborLink(const TDPNodeLink& link, int32 direction) const;
+
+	bool IsCompact() const;
+	void Compact();
+	void Expand();
+
+	// reads the octree in place from a navdata file, expanding copies it out before any change
+	bool IsMapped() const;
+	void Map(const TSharedPtr<TDPNavData>& navData);
 
-	const TArray<TDPNode>& GetLayer(LayerIndexType layer) const;
-	TArray<TDPNode>& GetLayer(LayerIndexType layer);
+	// hashed morton lookups, layers fall back to the binary search while theirs is missing
+	void BuildLookups();
+	void ClearLookups();
 
-	int32 MemoryUsage() const;
+	// cached node centers, the origin is the min corner of the volume
+	void BuildPositions(const FVector& origin, const TArray<float>& layerHalfSizes);
+	void ClearPositions();
+
+	// keep the first child links of layer 0 and the leaf storage in sync
+	void SetLeafNode(NodeIndexType node, const TDPLeafNode& leaf);
+	void RemoveLayerNodes(LayerIndexType layer, NodeIndexType index, int32 count);
+	void RebuildLeafNodes();
+
+	// versioned with FTDPCustomVersion, data of an unknown format is skipped and leaves the octree empty
+	void Serialize(FArchive& Ar, bool compress);
+
+	uint64 MemoryUsage() const;
+	SIZE_T GetAllocatedSize() const;
+	// per layer sizes and leaf occupancy, the volume adds what it owns on top
+	void GetMemoryReport(TDPMemoryReport& report) const;
 	void Clear();
-};
 
-FORCEINLINE FArchive& operator<<(FArchive& Ar, TDPTree& octree)
-{
-	Ar << octree.Layers;
-	Ar << octree.LeafNodes;
+private:
+	TDPNodeLink FindNeighborLink(LayerIndexType layer, MortonCodeType code, int32 direction) const;
+	TDPNodeLink AddLeafNode(const TDPLeafNode& leaf);
+	void RemoveLeafNode(const TDPNodeLink& link);
+	bool SerializeBulk(FArchive& Ar);
+
+private:
+	TSharedPtr<TDPNavData> mNavData;
+	TArrayView<const TDPLeafNode> mMappedLeafNodes;
+};
 
-	return Ar;
-}
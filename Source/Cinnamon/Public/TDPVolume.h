@@ -4,11 +4,28 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Volume.h"
+#include "Async/AsyncWork.h"
+#include "Misc/ScopeRWLock.h"
+#include "ThreadSafeBool.h"
+#include "ThreadSafeCounter.h"
 #include "TDPDefinitions.h"
 #include "TDPTree.h"
+#include "TDPGeometryRasterizer.h"
+#include "TDPBlockedLayer.h"
+#include "TDPTileLink.h"
+#include "TDPMemoryReport.h"
+#include "TDPGraph.h"
 #include "TDPVolume.generated.h"
 
 class UTDPDynamicObstacleComponent;
+class GenerateOctreeTask;
+
+UENUM(BlueprintType)
+enum class ETDPRasterizer : uint8
+{
+	Physics		UMETA(DisplayName = "Physics Overlaps"),
+	Geometry	UMETA(DisplayName = "Collision Geometry")
+};
 
 /**
  * 
@@ -18,9 +35,13 @@ class CINNAMON_API ATDPVolume : public AVolume
 {
 	GENERATED_BODY()
 
+	friend class GenerateOctreeTask;
+
 public:
 	ATDPVolume(const FObjectInitializer& ObjectInitializer);
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void BeginDestroy() override;
 
 	//~ Begin AActor Interface
 	virtual void PostRegisterAllComponents() override;
@@ -45,9 +66,36 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "3D Pathfinding")
 	void Generate();
 
+	UFUNCTION(BlueprintCallable, Category = "3D Pathfinding")
+	void GenerateAsync();
+
+	UFUNCTION(BlueprintCallable, Category = "3D Pathfinding")
+	void CancelGeneration();
+
+	UFUNCTION(BlueprintCallable, Category = "3D Pathfinding")
+	bool IsGenerating() const;
+
+	UFUNCTION(BlueprintCallable, Category = "3D Pathfinding")
+	bool GetGenerationProgress(int32& layer, float& percent) const;
+
+	UFUNCTION(BlueprintCallable, Category = "3D Pathfinding")
+	bool RegenerateRegion(const FBox& region);
+
 	UFUNCTION(BlueprintCallable, Category = "3D Pathfinding")
 	void Clear();
 
+	UFUNCTION(BlueprintCallable, Category = "3D Pathfinding")
+	void RebuildPortals();
+
+	UFUNCTION(BlueprintCallable, Category = "3D Pathfinding")
+	bool SaveNavData();
+
+	UFUNCTION(BlueprintCallable, Category = "3D Pathfinding")
+	bool LoadNavData();
+
+	UFUNCTION(BlueprintCallable, Category = "3D Pathfinding")
+	FString GetMemoryReportString() const;
+
 	UFUNCTION(BlueprintCallable, Category = "3D Pathfinding Debug")
 	void DrawOctree() const;
 
@@ -108,16 +156,41 @@ public:
 
 public:
 	const TDPTree& GetOctree() const;
+	FRWLock& GetOctreeLock() const;
 	float GetVoxelSizeInLayer(LayerIndexType layer) const;
 	bool GetNodePositionFromLink(TDPNodeLink link, FVector& position) const;
+	// center of a node or subnode without checking if it's blocked, for search hot paths
+	FVector GetLinkPosition(const TDPNodeLink& link) const;
 	bool GetLinkFromPosition(const FVector& position, TDPNodeLink& link) const;
+	bool FindLinkFromPosition(const FVector& position, TDPNodeLink& link) const;
 	void GetVoxelMortonPosition(const FVector& position, const LayerIndexType layer, FIntVector& mortonPosition) const;
 	int32 GetTotalLayers() const;
-	TDPNode* GetNodeFromLink(const TDPNodeLink& link);
-	const TDPNode* GetNodeFromLink(const TDPNodeLink& link) const;
+	void SetLayers(int32 layers);
+	void SetRasterizer(ETDPRasterizer rasterizer);
+	void SetParallelGeneration(bool parallel);
+	void SetCompactOctree(bool compact);
+	void SetHashedLookup(bool hashed);
+	void SetCachedPositions(bool cached);
+	void SetBakedGraph(bool baked);
+	// empty unless baked, pathfinders fall back to the neighbor searches below
+	const TDPGraph& GetGraph() const;
+	void SetHierarchyLayer(int32 layer);
+	// adjacency between the cells of the hierarchy layer, empty when hierarchical search is off
+	const TDPGraph& GetCoarseGraph() const;
+	// cell of the hierarchy layer a node or subnode lies in, nodes above the layer are their own cell
+	TDPNodeLink GetCoarseLink(const TDPNodeLink& link) const;
+	TDPNode GetNodeFromLink(const TDPNodeLink& link);
+	TDPConstNode GetNodeFromLink(const TDPNodeLink& link) const;
 	void GetNodeNeighborsFromLink(const TDPNodeLink& link, TArray<TDPNodeLink>& neighbors) const;
 	void GetLeafNeighborsFromLink(const TDPNodeLink& link, TArray<TDPNodeLink>& neighbors) const;
+	void GetPortalNeighborsFromLink(const TDPNodeLink& link, TArray<TDPTileLink>& neighbors) const;
+	const TArray<ATDPVolume*>& GetConnectedTiles() const;
+	// async tiled queries register with every tile they search, a tile waits for them before it goes away
+	void AddTileQuery() const;
+	void RemoveTileQuery() const;
 	bool IsPointInside(const FVector& point) const;
+	// walks the segment through free nodes and subnodes of the octree, no physics queries
+	bool HasLineOfSight(const FVector& start, const FVector& end) const;
 	void DrawVoxelFromLink(const TDPNodeLink& link, const FColor& color = FColor::Black, const FString& label = FString()) const;
 
 	void RequestOctreeUpdate(UTDPDynamicObstacleComponent& obstacle);
@@ -125,11 +198,22 @@ public:
 	TArray<TDPNodeLink> GetAffectedNodes(const FBox& box, const TSet<AActor*>& filter = TSet<AActor*>()) const;
 
 	virtual void Serialize(FArchive& Ar) override;
+	virtual void GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize) override;
+
+	void GetMemoryReport(TDPMemoryReport& report) const;
 
 private:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "3D Pathfinding", meta = (AllowPrivateAccess = true, DisplayName = "Enable Serialization"))
 	bool mEnableSerialization = false;
 
+	// smaller levels for a bit of extra save and load time
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "3D Pathfinding", meta = (AllowPrivateAccess = true, DisplayName = "Compress Serialization"))
+	bool mCompressSerialization = true;
+
+	// relative to the project content directory, the octree is mapped from this file on begin play when it's set
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "3D Pathfinding", meta = (AllowPrivateAccess = true, DisplayName = "Nav Data File"))
+	FString mNavDataFile;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "3D Pathfinding", meta = (AllowPrivateAccess = true, DisplayName = "Layers"))
 	int32 mLayers = 5;
 
@@ -142,6 +226,38 @@ private:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "3D Pathfinding", meta = (AllowPrivateAccess = true, DisplayName = "Complex Collision"))
 	bool mComplexCollision = false;
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "3D Pathfinding", meta = (AllowPrivateAccess = true, DisplayName = "Rasterizer"))
+	ETDPRasterizer mRasterizer = ETDPRasterizer::Physics;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "3D Pathfinding", meta = (AllowPrivateAccess = true, DisplayName = "Parallel Generation"))
+	bool mParallelGeneration = false;
+
+	// morton code to node lookups through a hash per layer instead of a binary search, costs about 16 bytes per node
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "3D Pathfinding", meta = (AllowPrivateAccess = true, DisplayName = "Hashed Node Lookup"))
+	bool mHashedLookup = false;
+
+	// node centers stored per layer so costs and heuristics skip morton decoding, costs 12 bytes per node
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "3D Pathfinding", meta = (AllowPrivateAccess = true, DisplayName = "Cached Node Positions"))
+	bool mCachedPositions = false;
+
+	// neighbors and edge costs of every node baked into flat arrays, searches read a row instead of walking the octree
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "3D Pathfinding", meta = (AllowPrivateAccess = true, DisplayName = "Baked Adjacency Graph"))
+	bool mBakedGraph = false;
+
+	// nodes of this layer and free nodes above it form a coarse graph for hierarchical searches, 0 turns it off
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "3D Pathfinding", meta = (AllowPrivateAccess = true, DisplayName = "Hierarchy Layer", ClampMin = 0))
+	int32 mHierarchyLayer = 0;
+
+	// only morton codes and child bits are kept, links are derived while searching
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "3D Pathfinding", meta = (AllowPrivateAccess = true, DisplayName = "Compact Octree"))
+	bool mCompactOctree = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "3D Pathfinding", meta = (AllowPrivateAccess = true, DisplayName = "Tiled Navigation"))
+	bool mTiledNavigation = false;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "3D Pathfinding", meta = (AllowPrivateAccess = true, DisplayName = "Total Portals"))
+	int32 mTotalPortals = 0;
+
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "3D Pathfinding", meta = (AllowPrivateAccess = true, DisplayName = "Total Layers"))
 	int32 mTotalLayers = 0;
 
@@ -152,7 +268,11 @@ private:
 	int32 mTotalLeafNodes = 0;
 
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "3D Pathfinding", meta = (AllowPrivateAccess = true, DisplayName = "Total Bytes"))
-	int32 mTotalBytes = 0;
+	int64 mTotalBytes = 0;
+
+	// transient memory of the last generation, blocked indices, geometry and the octree being built
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "3D Pathfinding", meta = (AllowPrivateAccess = true, DisplayName = "Generation Peak Bytes"))
+	int64 mGenerationPeakBytes = 0;
 
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "3D Pathfinding", meta = (AllowPrivateAccess = true, DisplayName = "Origin"))
 	FVector mOrigin;
@@ -167,7 +287,10 @@ private:
 	bool mOptimizedDynamicUpdate = false;
 
 	TDPTree mOctree;
-	TArray<TSet<MortonCodeType>> mBlockedIndices;
+	TDPGraph mGraph;
+	TDPGraph mCoarseGraph;
+	TArray<TDPBlockedLayer> mBlockedIndices;
+	TDPGeometryRasterizer mGeometryRasterizer;
 
 	bool mOctreeDirty = false;
 
@@ -176,26 +299,59 @@ private:
 
 	TSet<TDPNodeLink> mInvalidNodes;
 
+	// links into adjacent tiles, every portal has its reverse stored in the other tile
+	TMultiMap<TDPNodeLink, TDPTileLink> mPortals;
+	TArray<ATDPVolume*> mConnectedTiles;
+
+	// background generation, the pending octree is swapped in on the game thread once it's done
+	TDPTree mPendingOctree;
+	TSharedPtr<FAsyncTask<GenerateOctreeTask>> mGenerationTask;
+	FThreadSafeBool mGenerationCancelled = false;
+	FThreadSafeCounter mGenerationStep;
+	FThreadSafeCounter mGenerationLayer;
+	FThreadSafeCounter mGenerationStepNodes;
+	FThreadSafeCounter mGenerationStepProcessedNodes;
+	double mGenerationStartTime = 0.0;
+	mutable FRWLock mOctreeLock;
+	mutable FThreadSafeCounter mTileQueries;
+
 private:
+	FString GetNavDataPath() const;
+	void GatherGeometry(const FBox& bounds);
+	bool RasterizeOctree(TDPTree& octree);
+	void FinishGeneration();
+	// caller holds the write lock
+	void InitializeLayout();
+	void SetGenerationStep(int32 step, int32 layer, int32 nodes);
+	void RebuildGraph();
+	void GetCoarseNeighbors(const TDPNodeLink& link, TArray<TDPNodeLink>& neighbors) const;
 	void RasterizeLowRes();
-	void RasterizeLayer(LayerIndexType layer);
-	void RasterizeLeafNode(const FVector& origin, NodeIndexType leaf);
-	void SetNeighborLinks(const LayerIndexType layer);
-	bool FindNeighborLink(const LayerIndexType layerIndex, const NodeIndexType nodeIndex, uint8 direction, TDPNodeLink& link, const FVector& nodePosition);
+	void GetLayerCodes(LayerIndexType layer, TArray<MortonCodeType>& codes) const;
+	void RasterizeLayer(TDPTree& octree, LayerIndexType layer);
+	void RasterizeLeafNode(TDPLeafNode& leafNode, const FVector& origin, NodeIndexType leaf);
+	void SetNeighborLinks(TDPTree& octree, const LayerIndexType layer);
+	void SetNodeNeighborLinks(TDPTree& octree, const LayerIndexType layer, const NodeIndexType nodeIndex);
+	bool FindNeighborLink(const TDPTree& octree, const LayerIndexType layerIndex, const NodeIndexType nodeIndex, uint8 direction, TDPNodeLink& link, const FVector& nodePosition);
 	void UpdateOctree();
+	void BuildPortals(ATDPVolume& other);
+	void RemovePortals();
+	void WaitForTileQueries() const;
 	void UpdateNode(const TDPNodeLink link);
 	void UpdateLeafNode(const FVector& origin, NodeIndexType leaf);
 
 	bool IsNodeBlocked(LayerIndexType layer, MortonCodeType code) const;
+	// bounds of the free node or subnode at a position, false when it's blocked or outside the volume
+	bool GetFreeBounds(const FVector& position, FBox& bounds) const;
 	bool IsVoxelBlocked(const FVector& position, const float halfSize, bool useClearance = false) const;
 	bool IsVoxelBlocked(const FVector& position, const float halfSize, const TSet<AActor*>& filter, bool useClearance = false) const;
+	bool IsVoxelContained(const FVector& position, const float halfSize) const;
 
-	int32 GetNodeAmountInLayer(LayerIndexType layer) const;
+	MortonCodeType GetNodeAmountInLayer(LayerIndexType layer) const;
 	bool GetNodeIndexFromMortonCode(const LayerIndexType layer, const MortonCodeType nodeCode, NodeIndexType& index) const;
 	void GetNodePosition(LayerIndexType layer, MortonCodeType code, FVector& position) const;
 	NodeIndexType FindInsertIndex(LayerIndexType layer, MortonCodeType code) const;
 
-	void DrawNodeVoxel(const LayerIndexType layer, const TDPNode& node) const;
+	void DrawNodeVoxel(const LayerIndexType layer, const TDPConstNode& node) const;
 	void DrawNodeVoxel(const FVector& position, const FVector& extent, const FColor& color) const;
 
 	TArray<float> mLayerVoxelHalfSizeCache;
@@ -0,0 +1,462 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TDPBenchmarkCommandlet.h"
+#include "CinnamonEditor.h"
+#include "TDPVolume.h"
+#include "TDPAStar.h"
+#include "TDPNavigationPath.h"
+#include "PathHelper.h"
+#include "Engine/World.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/CollisionProfile.h"
+#include "Components/StaticMeshComponent.h"
+#include "ActorFactories/ActorFactory.h"
+#include "Builders/CubeBuilder.h"
+#include "EngineUtils.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonWriter.h"
+#include "Serialization/JsonSerializer.h"
+
+namespace
+{
+	struct FQueryResult
+	{
+		FVector Start;
+		FVector End;
+		TDPNodeLink StartLink;
+		TDPNodeLink EndLink;
+		bool Found = false;
+		double Milliseconds = 0.0;
+		double CompactMilliseconds = 0.0;
+		bool CompactFound = false;
+		TDPPathStatistics Statistics;
+		int32 PathLength = 0;
+	};
+
+	struct FRunResult
+	{
+		int32 Layers = 0;
+		double GenerationSeconds = 0.0;
+		int32 LayerNodes = 0;
+		int32 LeafNodes = 0;
+		uint64 MemoryBytes = 0;
+		uint64 CompactMemoryBytes = 0;
+		double UpdateMilliseconds = 0.0;
+		int32 Updates = 0;
+		double SearchLookupNanoseconds = 0.0;
+		double HashLookupNanoseconds = 0.0;
+		TArray<FQueryResult> Queries;
+
+		// A* expansions over the time spent searching, comparable between pathfinder changes on the same map and seed
+		double GetExpansionsPerSecond() const
+		{
+			double iterations = 0.0, milliseconds = 0.0;
+
+			for (const auto& query : Queries)
+			{
+				iterations += query.Statistics.Iterations;
+				milliseconds += query.Milliseconds;
+			}
+
+			return milliseconds > 0.0 ? iterations / (milliseconds / 1000.0) : 0.0;
+		}
+	};
+
+	const int32 MaxPointAttempts = 64;
+	const int32 LookupSamples = 1 << 20;
+
+	// average nanoseconds per morton lookup, about half of the codes are misses
+	double TimeLookups(const TDPTree& octree, const TArray<TPair<LayerIndexType, MortonCodeType>>& codes, bool hashed)
+	{
+		int32 found = 0;
+		const double startTime = FPlatformTime::Seconds();
+
+		for (const auto& code : codes)
+		{
+			NodeIndexType index;
+			const bool result = hashed ? octree.GetNodeIndexFromMortonCode(code.Key, code.Value, index) : octree.SearchNodeIndex(code.Key, code.Value, index);
+			found += result ? 1 : 0;
+		}
+
+		const double seconds = FPlatformTime::Seconds() - startTime;
+
+		// keeps the loop from being optimized away
+		UE_LOG(CinnamonEditorLog, Verbose, TEXT("TDPBenchmark: %d of %d codes found"), found, codes.Num());
+
+		return seconds * 1e9 / FMath::Max(codes.Num(), 1);
+	}
+}
+
+UTDPBenchmarkCommandlet::UTDPBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UTDPBenchmarkCommandlet::Main(const FString& Params)
+{
+	FString map, layersParam = TEXT("4,5,6"), output;
+	int32 queries = 100, seed = 1337, obstacles = 200, updates = 20;
+	float extent = 5000.0f;
+
+	FParse::Value(*Params, TEXT("Map="), map);
+	FParse::Value(*Params, TEXT("Layers="), layersParam);
+	FParse::Value(*Params, TEXT("Queries="), queries);
+	FParse::Value(*Params, TEXT("Seed="), seed);
+	FParse::Value(*Params, TEXT("Obstacles="), obstacles);
+	FParse::Value(*Params, TEXT("Extent="), extent);
+	FParse::Value(*Params, TEXT("Updates="), updates);
+
+	if (!FParse::Value(*Params, TEXT("Output="), output))
+	{
+		output = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Benchmarks"), TEXT("TDPBenchmark.json"));
+	}
+
+	TArray<FString> layerValues;
+	layersParam.ParseIntoArray(layerValues, TEXT(","));
+
+	UWorld* world = map.IsEmpty() ? CreateObstacleField(obstacles, extent, seed) : LoadMap(map);
+	ATDPVolume* volume = world ? FindVolume(*world) : nullptr;
+
+	if (volume == nullptr)
+	{
+		UE_LOG(CinnamonEditorLog, Error, TEXT("TDPBenchmark: no navigation volume to benchmark"));
+		return 1;
+	}
+
+	volume->SetRasterizer(FParse::Param(*Params, TEXT("Geometry")) ? ETDPRasterizer::Geometry : ETDPRasterizer::Physics);
+	volume->SetParallelGeneration(FParse::Param(*Params, TEXT("Parallel")));
+	volume->SetCompactOctree(false);
+
+	// runs the same queries again on the compact layout
+	const bool compareCompact = FParse::Param(*Params, TEXT("Compact"));
+
+	const FBox bounds = volume->GetComponentsBoundingBox(true);
+	TArray<AActor*> movableObstacles;
+	for (TActorIterator<AStaticMeshActor> it(world); it; ++it)
+	{
+		if (it->GetStaticMeshComponent()->Mobility == EComponentMobility::Movable && bounds.Intersect(it->GetComponentsBoundingBox()))
+		{
+			movableObstacles.Add(*it);
+		}
+	}
+
+	TArray<FTransform> obstacleTransforms;
+	for (AActor* obstacle : movableObstacles)
+	{
+		obstacleTransforms.Add(obstacle->GetActorTransform());
+	}
+
+	FTDPPathFinderSettings settings;
+	TArray<FRunResult> runs;
+
+	for (const FString& value : layerValues)
+	{
+		FRunResult& run = runs.AddDefaulted_GetRef();
+		run.Layers = FCString::Atoi(*value);
+
+		volume->SetLayers(run.Layers);
+
+		// every run starts from the same obstacle layout
+		for (int32 i = 0; i < movableObstacles.Num(); ++i)
+		{
+			movableObstacles[i]->SetActorTransform(obstacleTransforms[i]);
+		}
+
+		double startTime = FPlatformTime::Seconds();
+		volume->Generate();
+		run.GenerationSeconds = FPlatformTime::Seconds() - startTime;
+
+		const auto& octree = volume->GetOctree();
+		run.LayerNodes = octree.GetTotalLayerNodes();
+		run.LeafNodes = octree.GetTotalLeafNodes();
+		run.MemoryBytes = octree.MemoryUsage();
+
+		// binary search against the hashed lookup over the same codes
+		{
+			FRandomStream lookupRandom(seed);
+			TArray<TPair<LayerIndexType, MortonCodeType>> codes;
+			codes.Reserve(LookupSamples);
+
+			for (int32 i = 0; i < LookupSamples && run.LayerNodes > 0; ++i)
+			{
+				const LayerIndexType layer = static_cast<LayerIndexType>(lookupRandom.RandHelper(octree.Layers.Num()));
+				const auto& octreeLayer = octree.GetLayer(layer);
+
+				if (octreeLayer.Num() == 0)
+				{
+					continue;
+				}
+
+				const MortonCodeType code = octreeLayer.GetMortonCode(lookupRandom.RandHelper(octreeLayer.Num()));
+				codes.Emplace(layer, i % 2 == 0 ? code : code ^ 0x5555555ULL);
+			}
+
+			TDPTree lookupOctree = octree;
+			lookupOctree.BuildLookups();
+			run.SearchLookupNanoseconds = TimeLookups(lookupOctree, codes, false);
+			run.HashLookupNanoseconds = TimeLookups(lookupOctree, codes, true);
+		}
+
+		// the same stream for every layer count, so each run answers the same queries
+		FRandomStream random(seed);
+
+		// move obstacles around and rebuild the boxes they left and entered
+		for (int32 i = 0; i < updates && movableObstacles.Num() > 0; ++i)
+		{
+			AActor* obstacle = movableObstacles[random.RandHelper(movableObstacles.Num())];
+			FBox dirty = obstacle->GetComponentsBoundingBox();
+			obstacle->SetActorLocation(obstacle->GetActorLocation() + random.GetUnitVector() * dirty.GetExtent().GetMax());
+			dirty += obstacle->GetComponentsBoundingBox();
+
+			startTime = FPlatformTime::Seconds();
+			if (volume->RegenerateRegion(dirty))
+			{
+				run.UpdateMilliseconds += (FPlatformTime::Seconds() - startTime) * 1000.0;
+				++run.Updates;
+			}
+		}
+
+		TDPAStar pathFinder(*volume, ETDPHeuristic::EuclideanDistance, settings);
+		TDPNavigationPath path;
+
+		for (int32 i = 0; i < queries; ++i)
+		{
+			FQueryResult& query = run.Queries.AddDefaulted_GetRef();
+
+			// only free positions have a link
+			bool startFound = false, endFound = false;
+			for (int32 attempt = 0; attempt < MaxPointAttempts && !(startFound && endFound); ++attempt)
+			{
+				if (!startFound)
+				{
+					query.Start = random.RandPointInBox(bounds);
+					startFound = volume->FindLinkFromPosition(query.Start, query.StartLink);
+				}
+
+				if (!endFound)
+				{
+					query.End = random.RandPointInBox(bounds);
+					endFound = volume->FindLinkFromPosition(query.End, query.EndLink);
+				}
+			}
+
+			if (!startFound || !endFound)
+			{
+				query.StartLink.Invalidate();
+				continue;
+			}
+
+			path.Reset();
+			startTime = FPlatformTime::Seconds();
+			pathFinder.FindPath(query.StartLink, query.EndLink, query.Start, query.End, path);
+			query.Milliseconds = (FPlatformTime::Seconds() - startTime) * 1000.0;
+			query.Found = path.GetPath().Num() > 0;
+			query.Statistics = path.GetStatistics();
+			query.PathLength = path.GetPath().Num();
+		}
+
+		if (compareCompact)
+		{
+			volume->SetCompactOctree(true);
+			run.CompactMemoryBytes = octree.MemoryUsage();
+
+			for (auto& query : run.Queries)
+			{
+				if (!query.StartLink.IsValid())
+				{
+					continue;
+				}
+
+				path.Reset();
+				startTime = FPlatformTime::Seconds();
+				pathFinder.FindPath(query.StartLink, query.EndLink, query.Start, query.End, path);
+				query.CompactMilliseconds = (FPlatformTime::Seconds() - startTime) * 1000.0;
+				query.CompactFound = path.GetPath().Num() > 0;
+			}
+
+			volume->SetCompactOctree(false);
+		}
+
+		UE_LOG(CinnamonEditorLog, Display, TEXT("TDPBenchmark: layers %d, generation %f s, %d layer nodes, %d leaf nodes, %llu bytes, lookup %f ns searched / %f ns hashed, %f expansions/s"),
+			run.Layers, run.GenerationSeconds, run.LayerNodes, run.LeafNodes, run.MemoryBytes, run.SearchLookupNanoseconds, run.HashLookupNanoseconds, run.GetExpansionsPerSecond());
+	}
+
+	FString result;
+
+	if (output.EndsWith(TEXT(".csv")))
+	{
+		result = TEXT("layers,generation_s,layer_nodes,leaf_nodes,memory_bytes,compact_memory_bytes,updates,update_avg_ms,queries,found,query_avg_ms,query_max_ms,compact_query_avg_ms,avg_iterations,avg_visited,avg_path_length,lookup_search_ns,lookup_hash_ns,expansions_per_s\n");
+
+		for (const auto& run : runs)
+		{
+			int32 found = 0, compactFound = 0;
+			double total = 0.0, max = 0.0, compactTotal = 0.0, iterations = 0.0, visited = 0.0, length = 0.0;
+
+			for (const auto& query : run.Queries)
+			{
+				max = FMath::Max(max, query.Milliseconds);
+
+				if (query.CompactFound)
+				{
+					++compactFound;
+					compactTotal += query.CompactMilliseconds;
+				}
+
+				// failed queries have no path to average over
+				if (!query.Found)
+				{
+					continue;
+				}
+
+				++found;
+				total += query.Milliseconds;
+				iterations += query.Statistics.Iterations;
+				visited += query.Statistics.VisitedNodes;
+				length += query.PathLength;
+			}
+
+			const double count = FMath::Max(found, 1);
+			result += FString::Printf(TEXT("%d,%f,%d,%d,%llu,%llu,%d,%f,%d,%d,%f,%f,%f,%f,%f,%f,%f,%f,%f\n"),
+				run.Layers, run.GenerationSeconds, run.LayerNodes, run.LeafNodes, run.MemoryBytes, run.CompactMemoryBytes,
+				run.Updates, run.Updates > 0 ? run.UpdateMilliseconds / run.Updates : 0.0,
+				run.Queries.Num(), found, total / count, max, compactTotal / FMath::Max(compactFound, 1), iterations / count, visited / count, length / count,
+				run.SearchLookupNanoseconds, run.HashLookupNanoseconds, run.GetExpansionsPerSecond());
+		}
+	}
+	else
+	{
+		TSharedRef<FJsonObject> root = MakeShared<FJsonObject>();
+		root->SetStringField(TEXT("map"), map.IsEmpty() ? TEXT("synthetic") : map);
+		root->SetNumberField(TEXT("seed"), seed);
+		root->SetNumberField(TEXT("obstacles"), map.IsEmpty() ? obstacles : 0);
+
+		TArray<TSharedPtr<FJsonValue>> runValues;
+		for (const auto& run : runs)
+		{
+			TSharedRef<FJsonObject> runObject = MakeShared<FJsonObject>();
+			runObject->SetNumberField(TEXT("layers"), run.Layers);
+			runObject->SetNumberField(TEXT("generation_s"), run.GenerationSeconds);
+			runObject->SetNumberField(TEXT("layer_nodes"), run.LayerNodes);
+			runObject->SetNumberField(TEXT("leaf_nodes"), run.LeafNodes);
+			runObject->SetNumberField(TEXT("memory_bytes"), run.MemoryBytes);
+			runObject->SetNumberField(TEXT("compact_memory_bytes"), run.CompactMemoryBytes);
+			runObject->SetNumberField(TEXT("updates"), run.Updates);
+			runObject->SetNumberField(TEXT("update_total_ms"), run.UpdateMilliseconds);
+			runObject->SetNumberField(TEXT("lookup_search_ns"), run.SearchLookupNanoseconds);
+			runObject->SetNumberField(TEXT("lookup_hash_ns"), run.HashLookupNanoseconds);
+			runObject->SetNumberField(TEXT("expansions_per_s"), run.GetExpansionsPerSecond());
+
+			TArray<TSharedPtr<FJsonValue>> queryValues;
+			for (const auto& query : run.Queries)
+			{
+				TSharedRef<FJsonObject> queryObject = MakeShared<FJsonObject>();
+				queryObject->SetStringField(TEXT("start"), query.Start.ToString());
+				queryObject->SetStringField(TEXT("end"), query.End.ToString());
+				queryObject->SetBoolField(TEXT("found"), query.Found);
+				queryObject->SetNumberField(TEXT("ms"), query.Milliseconds);
+				queryObject->SetBoolField(TEXT("compact_found"), query.CompactFound);
+				queryObject->SetNumberField(TEXT("compact_ms"), query.CompactMilliseconds);
+				queryObject->SetNumberField(TEXT("iterations"), query.Statistics.Iterations);
+				queryObject->SetNumberField(TEXT("visited"), query.Statistics.VisitedNodes);
+				queryObject->SetNumberField(TEXT("frontier"), query.Statistics.FrontierNodes);
+				queryObject->SetNumberField(TEXT("cost"), query.Statistics.Cost);
+				queryObject->SetNumberField(TEXT("path_length"), query.PathLength);
+				queryValues.Add(MakeShared<FJsonValueObject>(queryObject));
+			}
+
+			runObject->SetArrayField(TEXT("queries"), queryValues);
+			runValues.Add(MakeShared<FJsonValueObject>(runObject));
+		}
+
+		root->SetArrayField(TEXT("runs"), runValues);
+
+		TSharedRef<TJsonWriter<>> writer = TJsonWriterFactory<>::Create(&result);
+		FJsonSerializer::Serialize(root, writer);
+	}
+
+	if (!FFileHelper::SaveStringToFile(result, *output))
+	{
+		UE_LOG(CinnamonEditorLog, Error, TEXT("TDPBenchmark: could not write %s"), *output);
+		return 1;
+	}
+
+	UE_LOG(CinnamonEditorLog, Display, TEXT("TDPBenchmark: results written to %s"), *output);
+
+	return 0;
+}
+
+UWorld* UTDPBenchmarkCommandlet::LoadMap(const FString& map) const
+{
+	UPackage* package = LoadPackage(nullptr, *map, LOAD_None);
+	UWorld* world = package ? UWorld::FindWorldInPackage(package) : nullptr;
+
+	if (world == nullptr)
+	{
+		UE_LOG(CinnamonEditorLog, Error, TEXT("TDPBenchmark: could not load map %s"), *map);
+		return nullptr;
+	}
+
+	world->WorldType = EWorldType::Editor;
+	world->AddToRoot();
+
+	if (!world->bIsWorldInitialized)
+	{
+		world->InitWorld(UWorld::InitializationValues().AllowAudioPlayback(false).CreatePhysicsScene(true).RequiresHitProxies(false).CreateNavigation(false).CreateAISystem(false));
+	}
+
+	world->UpdateWorldComponents(true, false);
+
+	return world;
+}
+
+UWorld* UTDPBenchmarkCommandlet::CreateObstacleField(int32 obstacles, float extent, int32 seed) const
+{
+	UWorld* world = UWorld::CreateWorld(EWorldType::Editor, false);
+	GEngine->CreateNewWorldContext(EWorldType::Editor).SetCurrentWorld(world);
+	world->AddToRoot();
+
+	UStaticMesh* cube = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+	if (cube == nullptr)
+	{
+		UE_LOG(CinnamonEditorLog, Error, TEXT("TDPBenchmark: could not load the engine cube mesh"));
+		return nullptr;
+	}
+
+	// boxes of random size and rotation, movable so the update benchmark can push them around
+	FRandomStream random(seed);
+	for (int32 i = 0; i < obstacles; ++i)
+	{
+		const FVector location = random.RandPointInBox(FBox(FVector(-extent), FVector(extent)));
+		const FRotator rotation(random.FRandRange(0.0f, 360.0f), random.FRandRange(0.0f, 360.0f), random.FRandRange(0.0f, 360.0f));
+
+		AStaticMeshActor* actor = world->SpawnActor<AStaticMeshActor>(location, rotation);
+		UStaticMeshComponent* component = actor->GetStaticMeshComponent();
+		component->SetMobility(EComponentMobility::Movable);
+		component->SetStaticMesh(cube);
+		component->SetCollisionProfileName(UCollisionProfile::BlockAll_ProfileName);
+		actor->SetActorScale3D(FVector(random.FRandRange(0.5f, 1.0f), random.FRandRange(0.5f, 1.0f), random.FRandRange(0.5f, 1.0f)) * extent / 20.0f / 100.0f);
+	}
+
+	ATDPVolume* volume = world->SpawnActor<ATDPVolume>(FVector::ZeroVector, FRotator::ZeroRotator);
+	UCubeBuilder* builder = NewObject<UCubeBuilder>();
+	builder->X = builder->Y = builder->Z = extent * 2;
+	UActorFactory::CreateBrushForVolumeActor(volume, builder);
+
+	world->UpdateWorldComponents(true, false);
+
+	return world;
+}
+
+ATDPVolume* UTDPBenchmarkCommandlet::FindVolume(UWorld& world) const
+{
+	TActorIterator<ATDPVolume> it(&world);
+
+	return it ? *it : nullptr;
+}
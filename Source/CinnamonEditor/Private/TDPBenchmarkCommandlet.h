@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "TDPBenchmarkCommandlet.generated.h"
+
+class ATDPVolume;
+class UWorld;
+
+/**
+ * Generates the octree at several layer counts and runs a seeded set of path queries, writes the results to json or csv
+ *
+ * UE4Editor-Cmd <Project> -run=TDPBenchmark [-Map=/Game/Maps/Level] [-Layers=4,5,6] [-Queries=100] [-Seed=1337]
+ *     [-Obstacles=200] [-Extent=5000] [-Updates=20] [-Geometry] [-Parallel] [-Compact] [-Output=Saved/Benchmarks/TDPBenchmark.json]
+ */
+UCLASS()
+class UTDPBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UTDPBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	UWorld* LoadMap(const FString& map) const;
+	UWorld* CreateObstacleField(int32 obstacles, float extent, int32 seed) const;
+	ATDPVolume* FindVolume(UWorld& world) const;
+};
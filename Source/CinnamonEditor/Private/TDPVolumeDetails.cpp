@@ -183,6 +183,31 @@ void TDPVolumeDetails::CustomizeDetails(IDetailLayoutBuilder& DetailBuilder)
 		.Text(NSLOCTEXT("SVO", "Clear Drawn SVO", "Clear Drawn SVO"))
 		]
 		];
+
+	// save navdata button
+	DetailBuilder.EditCategory("3D Pathfinding")
+		.AddCustomRow(NSLOCTEXT("SVO", "Save Nav Data", "Save Nav Data"))
+		.NameContent()
+		[
+			SNew(STextBlock)
+			.Font(IDetailLayoutBuilder::GetDetailFont())
+		.Text(NSLOCTEXT("SVO", "Save Nav Data", "Save Nav Data"))
+		]
+	.ValueContent()
+		.MaxDesiredWidth(125.f)
+		.MinDesiredWidth(125.f)
+		[
+			SNew(SButton)
+			.ContentPadding(2)
+		.VAlign(VAlign_Center)
+		.HAlign(HAlign_Center)
+		.OnClicked(this, &TDPVolumeDetails::OnSaveNavDataClicked)
+		[
+			SNew(STextBlock)
+			.Font(IDetailLayoutBuilder::GetDetailFont())
+		.Text(NSLOCTEXT("SVO", "Save Nav Data", "Save Nav Data"))
+		]
+		];
 }
 
 FReply TDPVolumeDetails::OnGenerateSVOClicked()
@@ -245,4 +270,14 @@ FReply TDPVolumeDetails::OnFlushDrawnSVOClicked()
 	return FReply::Handled();
 }
 
+FReply TDPVolumeDetails::OnSaveNavDataClicked()
+{
+	if (mVolume.IsValid())
+	{
+		mVolume->SaveNavData();
+	}
+
+	return FReply::Handled();
+}
+
 #undef LOCTEXT_NAMESPACE
@@ -26,6 +26,7 @@ public:
 	FReply OnDrawLeafNodesClicked();
 	FReply OnDrawMiniLeafNodesClicked();
 	FReply OnFlushDrawnSVOClicked();
+	FReply OnSaveNavDataClicked();
 
 private:
 	TWeakObjectPtr<ATDPVolume> mVolume;